@@ -7,7 +7,7 @@ docker run --rm --detach --name na-mariadb -p 127.0.0.1:3306:3306 --env MARIADB_
 
 docker run --rm --name nextappd-init -p 127.0.0.1:10321:10321 --link na-mariadb jgaafromnorth/nextappd --root-db-passwd ${NA_ROOT_DBPASSWD} --db-passwd ${NA_DBPASSWD} -C debug --db-host na-mariadb --bootstrap
 
-docker run --rm --detach --name nextappd -p 127.0.0.1:10321:10321 --link na-mariadb jgaafromnorth/nextappd --db-passwd ${NA_DBPASSWD} -C debug --db-host na-mariadb -g 0.0.0.0:10321
+docker run --rm --detach --name nextappd -p 127.0.0.1:10321:10321 --link na-mariadb jgaafromnorth/nextappd --db-passwd ${NA_DBPASSWD} -C debug --db-host na-mariadb -g 0.0.0.0:10321 --grpc-user-from-metadata
 
 echo "Passwords: database/root NA_ROOT_DBPASSWD=${NA_ROOT_DBPASSWD}  nextapp database user NEXTAPP_DBPASSWD=${NEXTAPP_DBPASSWD}"
 
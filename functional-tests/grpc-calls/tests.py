@@ -2,9 +2,10 @@ import json
 import pytest
 # import time
 import os
-# import uuid
+import uuid
 
 import grpc
+from grpc_health.v1 import health_pb2, health_pb2_grpc
 import nextapp_pb2
 import nextapp_pb2_grpc
 
@@ -12,7 +13,11 @@ import nextapp_pb2_grpc
 def gd():
     channel = grpc.insecure_channel(os.getenv('NA_GRPC', '127.0.0.1:10321'))
     stub = nextapp_pb2_grpc.NextappStub(channel)
-    return {'stub': stub}
+    return {'stub': stub, 'health': health_pb2_grpc.HealthStub(channel)}
+
+def test_health_serving(gd):
+    reply = gd['health'].Check(health_pb2.HealthCheckRequest())
+    assert reply.status == health_pb2.HealthCheckResponse.SERVING
 
 def test_add_root_node(gd):
     node = nextapp_pb2.Node(kind=nextapp_pb2.Node.Kind.FOLDER, name='first')
@@ -85,8 +90,128 @@ def test_add_tenant_with_user(gd):
 
     # Todo. Fetch the user to validate
 
+def test_add_tenant_with_many_users(gd):
+    template = nextapp_pb2.Tenant(kind=nextapp_pb2.Tenant.Kind.Regular, name='birds')
+    req = nextapp_pb2.CreateTenantReq(tenant=template)
+    req.users.extend([nextapp_pb2.User(name='bird-{}'.format(i), email='bird-{}@example.com'.format(i)) for i in range(1200)])
+
+    status = gd['stub'].CreateTenant(req)
+    assert status.error == nextapp_pb2.Error.OK
+    tenant = status.tenant.uuid
+
+    req = nextapp_pb2.CreateUsersReq(tenant=tenant)
+    req.users.extend([nextapp_pb2.User(name='parrot-{}'.format(i), email='parrot-{}@example.com'.format(i)) for i in range(10)])
+    status = gd['stub'].CreateUsers(req)
+    assert status.error == nextapp_pb2.Error.OK
+
+def test_add_users_is_atomic(gd):
+    # The duplicate email makes the last batch fail, so none of the users are created
+    req = nextapp_pb2.CreateUsersReq()
+    req.users.extend([nextapp_pb2.User(name='fish-{}'.format(i), email='fish-{}@example.com'.format(i)) for i in range(600)])
+    req.users.extend([nextapp_pb2.User(name='fish-dup', email='fish-0@example.com')])
+    with pytest.raises(grpc.RpcError):
+        gd['stub'].CreateUsers(req)
+
+    req = nextapp_pb2.CreateUsersReq()
+    req.users.extend([nextapp_pb2.User(name='fish-0', email='fish-0@example.com')])
+    status = gd['stub'].CreateUsers(req)
+    assert status.error == nextapp_pb2.Error.OK
+
 def test_get_nodes(gd):
     req = nextapp_pb2.GetNodesReq()
     nodes = gd['stub'].GetNodes(req)
 
+def test_get_children(gd):
+    # Only the top-level nodes, with the number of children they have
+    top = gd['stub'].GetChildren(nextapp_pb2.GetChildrenReq(depth=1))
+    third = [c for c in top.root.children if c.node.name == 'third']
+    assert len(third) == 1
+    assert third[0].childCount == 20
+    assert len(third[0].children) == 0
+
+    # Two levels below 'third'. The leafs are not loaded, but have a count.
+    req = nextapp_pb2.GetChildrenReq(parent=third[0].node.uuid, depth=2)
+    tree = gd['stub'].GetChildren(req)
+    assert len(tree.root.children) == 20
+    for child in tree.root.children:
+        assert child.childCount == 8
+        assert len(child.children) == 8
+        for leaf in child.children:
+            assert leaf.childCount == 0
+            assert len(leaf.children) == 0
+
+
+
+def test_get_time_spent(gd):
+    req = nextapp_pb2.TimeSpentReq(date=nextapp_pb2.Date(year=2024, month=1, mday=29))
+    summary = gd['stub'].GetTimeSpent(req)
+    assert len(summary.periods) == 5
+    assert summary.periods[nextapp_pb2.TS_WEEK].start.mday == 26
+    assert summary.periods[nextapp_pb2.TS_MONTH].start.mday == 1
+    assert summary.periods[nextapp_pb2.TS_QUARTER].start.month == 0
+    for period in summary.periods:
+        assert period.used >= 0
+
+def test_day_stats(gd):
+    colors = gd['stub'].GetDayColorDefinitions(nextapp_pb2.Empty())
+    green = [c for c in colors.dayColors if c.score > 0]
+    assert len(green) > 0
+
+    for mday in range(10, 13):
+        req = nextapp_pb2.SetColorReq(date=nextapp_pb2.Date(year=2023, month=4, mday=mday), color=green[0].id)
+        status = gd['stub'].SetColorOnDay(req)
+        assert status.error == nextapp_pb2.Error.OK
+
+    # No other test colors days in 2023
+    stats = gd['stub'].GetDayStats(nextapp_pb2.DayStatsReq(year=2023))
+    assert stats.year == 2023
+    assert stats.days >= 3
+    assert stats.longestStreak == 3
+
+    # Break the streak in the middle
+    req = nextapp_pb2.SetColorReq(date=nextapp_pb2.Date(year=2023, month=4, mday=11), color='')
+    status = gd['stub'].SetColorOnDay(req)
+    assert status.error == nextapp_pb2.Error.OK
+
+    after = gd['stub'].GetDayStats(nextapp_pb2.DayStatsReq(year=2023))
+    assert after.days == stats.days - 1
+    assert after.longestStreak == 1
+
+    # And join it again
+    req = nextapp_pb2.SetColorReq(date=nextapp_pb2.Date(year=2023, month=4, mday=11), color=green[0].id)
+    status = gd['stub'].SetColorOnDay(req)
+    assert status.error == nextapp_pb2.Error.OK
+
+    joined = gd['stub'].GetDayStats(nextapp_pb2.DayStatsReq(year=2023))
+    assert joined.days == stats.days
+    assert joined.longestStreak == 3
+
+def test_export_tenant(gd):
+    records = list(gd['stub'].ExportTenant(nextapp_pb2.ExportTenantReq()))
+    assert len(records) > 0
+    assert records[0].WhichOneof('what') == 'tenant'
+    kinds = [r.WhichOneof('what') for r in records]
+    assert 'user' in kinds
+    assert 'node' in kinds
+
+def test_import_existing_tenant_fails(gd):
+    records = gd['stub'].ExportTenant(nextapp_pb2.ExportTenantReq())
+    status = gd['stub'].ImportTenant(iter(records))
+    assert status.error != nextapp_pb2.Error.OK
+
+def test_export_import_requires_admin(gd):
+    # Needs a server started with --grpc-user-from-metadata
+    user = str(uuid.uuid4())
+    template = nextapp_pb2.Tenant(kind=nextapp_pb2.Tenant.Kind.Regular, name='mice')
+    req = nextapp_pb2.CreateTenantReq(tenant=template)
+    req.users.extend([nextapp_pb2.User(uuid=user, kind=nextapp_pb2.User.Kind.Regular, name='mickey', email='mickey@example.com')])
+    status = gd['stub'].CreateTenant(req)
+    assert status.error == nextapp_pb2.Error.OK
+
+    metadata = [('nextapp-user', user)]
+    with pytest.raises(grpc.RpcError) as err:
+        list(gd['stub'].ExportTenant(nextapp_pb2.ExportTenantReq(), metadata=metadata))
+    assert err.value.code() == grpc.StatusCode.PERMISSION_DENIED
 
+    status = gd['stub'].ImportTenant(iter([]), metadata=metadata)
+    assert status.error == nextapp_pb2.Error.PERMISSION_DENIED
@@ -0,0 +1,42 @@
+#!/bin/bash
+
+## Runs nextapp-loadgen against a local nextappd, with the database in a
+## disposable mariadb container.
+##
+## Build with -DNEXTAPP_WITH_LOADGEN=ON first. Options are passed to nextapp-loadgen:
+##   BUILD_DIR=build ./loadgen-local.sh --devices 20 --rate 5 --duration 120
+
+BUILD_DIR=${BUILD_DIR:-build}
+NEXTAPPD=${BUILD_DIR}/bin/nextappd
+LOADGEN=${BUILD_DIR}/bin/nextapp-loadgen
+
+for bin in ${NEXTAPPD} ${LOADGEN} ; do
+    if [ ! -x ${bin} ] ; then
+        echo "Missing ${bin}. Set BUILD_DIR to your build directory."
+        exit 1
+    fi
+done
+
+export NA_ROOT_DBPASSWD=`dd if=/dev/random bs=48 count=1 | base64`
+export NEXTAPP_DBPASSWD=`dd if=/dev/random bs=48 count=1 | base64`
+
+. ./mariadb-container.sh
+
+echo "Waiting for mariadb..."
+until docker exec na-mariadb mariadb-admin ping -u root -p"${NA_ROOT_DBPASSWD}" --silent ; do
+    sleep 1
+done
+
+${NEXTAPPD} --root-db-passwd "${NA_ROOT_DBPASSWD}" --db-passwd "${NEXTAPP_DBPASSWD}" --bootstrap || exit 1
+
+${NEXTAPPD} --db-passwd "${NEXTAPP_DBPASSWD}" -L nextappd-loadgen.log -C "" &
+NEXTAPPD_PID=$!
+
+${LOADGEN} "$@"
+RESULT=$?
+
+kill ${NEXTAPPD_PID}
+wait ${NEXTAPPD_PID}
+docker stop na-mariadb
+
+exit ${RESULT}
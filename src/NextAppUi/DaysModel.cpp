@@ -74,6 +74,11 @@ void DaysModel::start()
             this,
             &DaysModel::fetchedMonth);
 
+    connect(std::addressof(ServerComm::instance()),
+            &ServerComm::receivedDayStats,
+            this,
+            &DaysModel::fetchedDayStats);
+
     connect(std::addressof(ServerComm::instance()),
             &ServerComm::onUpdate,
             this,
@@ -101,6 +106,19 @@ void DaysModel::fetchDay(int year, int month, int day)
     ServerComm::instance().fetchDay(year, month, day);
 }
 
+void DaysModel::fetchYearStats(int year)
+{
+    stats_year_ = year;
+    if (!started_) {
+        actions_queue_.emplace([this, year] {
+            fetchYearStats(year);
+        });
+        return;
+    }
+
+    ServerComm::instance().getDayStats(year);
+}
+
 void DaysModel::fetchColors()
 {
     if (!started_) {
@@ -196,8 +214,40 @@ void DaysModel::fetchedMonth(const nextapp::pb::Month &month)
     emit updatedMonth(month.year(), month.month());
 }
 
+void DaysModel::fetchedDayStats(const nextapp::pb::DayStats &stats)
+{
+    if (stats.year() != stats_year_) {
+        return;
+    }
+
+    QVariantList months;
+    for(const auto& m : stats.months()) {
+        QVariantMap month;
+        month["month"] = m.month();
+        month["days"] = m.days();
+        month["averageScore"] = m.averageScore();
+        months.append(month);
+    }
+
+    year_stats_.clear();
+    year_stats_["year"] = stats.year();
+    year_stats_["days"] = stats.days();
+    year_stats_["averageScore"] = stats.averageScore();
+    year_stats_["longestStreak"] = stats.longestStreak();
+    year_stats_["currentStreak"] = stats.currentStreak();
+    year_stats_["months"] = months;
+    emit yearStatsChanged();
+}
+
 void DaysModel::onUpdate(const std::shared_ptr<nextapp::pb::Update> &update)
 {
+    // The statistics are cheap to fetch, so we just ask the server again if they are affected.
+    auto refresh_stats = [this](const nextapp::pb::Date& when) {
+        if (stats_year_ && when.year() == stats_year_) {
+            ServerComm::instance().getDayStats(stats_year_);
+        }
+    };
+
     auto set = [this](const nextapp::pb::Date& when, const QString& color) {
         PackedMonth key = {};
         key.date.month_ = when.month();
@@ -220,9 +270,11 @@ void DaysModel::onUpdate(const std::shared_ptr<nextapp::pb::Update> &update)
 
     if (update->hasDay()) {
         set(update->day().day().date(), update->day().day().color());
+        refresh_stats(update->day().day().date());
     }
     if (update->hasDayColor()) {
         set(update->dayColor().date(), update->dayColor().color());
+        refresh_stats(update->dayColor().date());
     }
 }
 
@@ -6,6 +6,7 @@
 #include <QMap>
 #include <QHash>
 #include <QUuid>
+#include <QVariantMap>
 #include <QAbstractItemModel>
 
 #include "MonthModel.h"
@@ -173,6 +174,7 @@ class DaysModel : public QObject
     QML_ELEMENT
     QML_SINGLETON
     Q_PROPERTY(bool valid READ valid NOTIFY validChanged)
+    Q_PROPERTY(QVariantMap yearStats READ yearStats NOTIFY yearStatsChanged)
 public:
     struct DayInfo {
         DayInfo() = default;
@@ -208,6 +210,13 @@ public:
 
     std::optional<nextapp::pb::DayColor> getDayColor(const QUuid& uuid) const;
 
+    // Statistics for the year are calculated by the server, and delivered via `yearStats`
+    Q_INVOKABLE void fetchYearStats(int year);
+
+    QVariantMap yearStats() const {
+        return year_stats_;
+    }
+
     void start();
 
     void fetchMonth(int year, int month);
@@ -229,11 +238,13 @@ signals:
     void updatedMonth(int year, int month);
     void updatedDay(int year, int month, int day);
     void dayColorsChanged(const nextapp::pb::DayColorDefinitions& defs);
+    void yearStatsChanged();
 
 public slots:
 
     void fetchedColors(const nextapp::pb::DayColorDefinitions& defs);
     void fetchedMonth(const nextapp::pb::Month& defs);
+    void fetchedDayStats(const nextapp::pb::DayStats& stats);
 
     // Used to update the state if it is changed
     void onUpdate(const std::shared_ptr<nextapp::pb::Update>& update);
@@ -249,6 +260,8 @@ private:
     std::queue<std::function<void()>> actions_queue_;
     months_t months_;
     nextapp::pb::DayColorDefinitions color_definitions_;
+    QVariantMap year_stats_;
+    int stats_year_ = 0;
     bool started_ = false;
     static DaysModel *instance_;
 };
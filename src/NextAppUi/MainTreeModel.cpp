@@ -24,7 +24,7 @@ ostream& operator << (ostream& o, const QModelIndex& v) {
             }
 
             for(const auto *p : std::ranges::reverse_view(path)) {
-                o << '/' << p->node().name();
+                o << '/' << p->name();
             }
 
             o << '}';
@@ -38,6 +38,12 @@ ostream& operator << (ostream& o, const QModelIndex& v) {
 
 namespace {
 
+// Levels loaded at startup. The rest are loaded when the user expands a node.
+constexpr int initial_depth = 2;
+
+// Levels loaded when a node is expanded
+constexpr int fetch_depth = 1;
+
 void dumpLevel(unsigned level, MainTreeModel::TreeNode::node_list_t list) {
     for(auto &node : list) {
         QString name;
@@ -45,23 +51,18 @@ void dumpLevel(unsigned level, MainTreeModel::TreeNode::node_list_t list) {
             name += "   ";
         }
         name += " --> ";
-        name += node->node().name();
+        name += node->name();
 
         LOG_DEBUG << name;
         dumpLevel(level + 1, node->children());
     }
 }
 
-optional<unsigned> getRow(MainTreeModel::TreeNode::node_list_t& list, const QUuid& uuid) {
-    if (auto it = std::find_if(list.cbegin(), list.cend(), [&](const auto& v) {
-            const auto node_uuid = v->uuid();
-            return node_uuid == uuid;
-        }); it != list.cend()) {
-
-        return distance(list.cbegin(), it);
+// Update the cached rows from `from` to the end of the list
+void updateRows(MainTreeModel::TreeNode::node_list_t& list, int from) {
+    for(auto row = from; row < list.size(); ++row) {
+        list[row]->setRow(row);
     }
-
-    return {};
 }
 
 MainTreeModel::TreeNode * getTreeNode(const QModelIndex& node) noexcept {
@@ -73,23 +74,16 @@ MainTreeModel::TreeNode * getTreeNode(const QModelIndex& node) noexcept {
     return {};
 }
 
-template <typename T, typename ixT>
-void copyTreeBranch(MainTreeModel::TreeNode::node_list_t& list, const T& from, ixT& index, MainTreeModel::TreeNode *parent) {
-    assert(parent);
-    for(auto& node: from) {
-        const auto name = node.node().name();
-        auto new_node = make_shared<MainTreeModel::TreeNode>(node.node(), parent);
-        index[new_node->uuid()] = new_node.get();
-        list.emplace_back(std::move(new_node));
+bool lessByName(const MainTreeModel::TreeNode *left, const MainTreeModel::TreeNode *right) {
+    return left->sortKey().compare(right->sortKey()) < 0;
+}
 
-        // Add children recursively
-        auto& current = list.back();
-        copyTreeBranch(current->children(), node.children(), index, current.get());
+qsizetype countNodes(const QList<nextapp::pb::NodeTreeItem>& items) {
+    auto count = items.size();
+    for(const auto& item : items) {
+        count += countNodes(item.children());
     }
-
-    std::ranges::sort(list, [](const auto& left, const auto& right) {
-        return left->node().name().compare(right->node().name(), Qt::CaseInsensitive) < 0;
-    });
+    return count;
 }
 
 } // anon ns
@@ -99,6 +93,7 @@ MainTreeModel::MainTreeModel(QObject *parent)
     : QAbstractItemModel{parent}
 {
     instance_ = this;
+    collator_.setCaseSensitivity(Qt::CaseInsensitive);
 }
 
 void MainTreeModel::start()
@@ -108,13 +103,23 @@ void MainTreeModel::start()
             this,
             &MainTreeModel::setAllNodes);
 
+    connect(std::addressof(ServerComm::instance()),
+            &ServerComm::receivedChildren,
+            this,
+            &MainTreeModel::onReceivedChildren);
+
+    connect(std::addressof(ServerComm::instance()),
+            &ServerComm::failedToGetChildren,
+            this,
+            &MainTreeModel::onFailedToGetChildren);
+
     connect(std::addressof(ServerComm::instance()),
             &ServerComm::onUpdate,
             this,
             &MainTreeModel::onUpdate);
 
 
-    ServerComm::instance().getNodeTree();
+    ServerComm::instance().getChildren({}, initial_depth);
 }
 
 void MainTreeModel::setSelected(const QString& newSel)
@@ -141,7 +146,7 @@ QModelIndex MainTreeModel::index(int row, int column, const QModelIndex &parent)
     if (parent.isValid()) {
         if (auto *parent_ptr = static_cast<TreeNode *>(parent.internalPointer())) {
             if (parent_ptr->children().size() > row) {
-                auto *current = parent_ptr->children().at(row).get();
+                auto *current = parent_ptr->children().at(row);
                 return createIndex(row, column, current);
             }
         }
@@ -165,15 +170,7 @@ QModelIndex MainTreeModel::parent(const QModelIndex &child) const
                 return createIndex(0, 0, &root_);
             }
 
-            auto& list = const_cast<MainTreeModel *>(this)->getListFromChild(*parent);
-            if (auto row = getRow(list, parent->uuid())) {
-                return createIndex(*row, 0, parent);
-            }
-
-            auto name = current->node().name();
-            if (!name.isEmpty()) {
-                LOG_WARN << "Could not find child " << child << " in childlist from parent '" << parent->node().name() << '\'';
-            }
+            return createIndex(parent->row(), 0, parent);
         }
     }
 
@@ -214,13 +211,34 @@ bool MainTreeModel::hasChildren(const QModelIndex &parent) const
 {
     bool children = true; // The empty QModelIndex always have one child, the root node.
     if (parent.isValid()) {
-        children = !getTreeNode(parent)->children().empty();
+        const auto *current = getTreeNode(parent);
+        children = !current->children().empty() || current->unloadedChildren() > 0;
     }
 
     //LOG_TRACE_N << parent << " children=" << (children ? "true" : "false");
     return children;
 }
 
+bool MainTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    if (const auto *current = getTreeNode(parent)) {
+        return current->unloadedChildren() > 0 && !fetching_.contains(current->uuid());
+    }
+
+    return false;
+}
+
+void MainTreeModel::fetchMore(const QModelIndex &parent)
+{
+    if (!canFetchMore(parent)) {
+        return;
+    }
+
+    const auto uuid = getTreeNode(parent)->uuid();
+    fetching_.insert(uuid, {});
+    ServerComm::instance().getChildren(uuid, fetch_depth);
+}
+
 void MainTreeModel::dump()
 {
     LOG_DEBUG << "Dumping the tree.";
@@ -232,6 +250,9 @@ void MainTreeModel::clear()
 {
     root_.children().clear();
     uuid_index_.clear();
+    fetching_.clear();
+    arena_.clear();
+    strings_.clear();
 }
 
 QModelIndex MainTreeModel::useRoot()
@@ -240,7 +261,7 @@ QModelIndex MainTreeModel::useRoot()
         return index(0, 0, {});
     }
 
-    return getIndex(root_.children().front().get());
+    return getIndex(root_.children().front());
 }
 
 pb::Node MainTreeModel::toNode(const QVariantMap &map)
@@ -308,9 +329,7 @@ void MainTreeModel::addNode(TreeNode *parent, const nextapp::pb::Node &node)
 {
     const int row = getInsertRow(parent, node);
     beginInsertRows(getIndex(parent), row, row);
-    auto new_node = make_shared<TreeNode>(node, parent);
-    uuid_index_[new_node->uuid()] = new_node.get();
-    insertNode(parent->children(), new_node, row);
+    insertNode(parent->children(), createNode(node, parent), row);
     endInsertRows();
 
     if (parent == &root_ && row == 0) {
@@ -332,22 +351,126 @@ void MainTreeModel::moveNode(TreeNode *parent, TreeNode *current, const nextapp:
     const auto dst_row = getInsertRow(parent, node);
     beginMoveRows(sourceParentIx, src_row, src_row, destinationParentIx, dst_row);
 
-    auto tn = old_parent->children().takeAt(src_row);
-    tn->node() = node; // We want version and parent to be up to date
+    auto *tn = takeNode(old_parent->children(), src_row);
+    tn->setNode(node, strings_, collator_); // We want the version to be up to date
     tn->setParent(parent);
     insertNode(parent->children(), tn, dst_row);
     endMoveRows();
 }
 
-void MainTreeModel::insertNode(TreeNode::node_list_t &list, std::shared_ptr<TreeNode> &tn, int row)
+MainTreeModel::TreeNode *MainTreeModel::createNode(const nextapp::pb::Node &node, TreeNode *parent)
+{
+    auto *tn = arena_.create();
+    tn->setNode(node, strings_, collator_);
+    tn->setParent(parent);
+    uuid_index_[tn->uuid()] = tn;
+    return tn;
+}
+
+void MainTreeModel::copyTreeBranch(TreeNode &parent, const QList<nextapp::pb::NodeTreeItem> &from)
+{
+    auto& list = parent.children();
+    list.reserve(from.size());
+    for(const auto& item : from) {
+        // It is already in the tree if it was added or moved there while we waited for it
+        if (uuid_index_.contains(QUuid{item.node().uuid()})) {
+            continue;
+        }
+
+        auto *tn = createNode(item.node(), &parent);
+        list.append(tn);
+
+        if (item.children().isEmpty()) {
+            // The server tells how many children there are, also when it did not send them
+            tn->setUnloadedChildren(item.childCount());
+        }
+
+        // Add children recursively
+        copyTreeBranch(*tn, item.children());
+    }
+
+    std::ranges::sort(list, lessByName);
+    updateRows(list, 0);
+}
+
+void MainTreeModel::releaseBranch(TreeNode *node)
+{
+    for(auto *child : node->children()) {
+        releaseBranch(child);
+    }
+    uuid_index_.remove(node->uuid());
+    arena_.release(node);
+}
+
+void MainTreeModel::removeNode(TreeNode *current)
+{
+    auto *parent = current->parent();
+    assert(parent);
+    const auto row = current->row();
+
+    beginRemoveRows(getIndex(parent), row, row);
+    releaseBranch(takeNode(parent->children(), row));
+    endRemoveRows();
+
+    if (row == 0 && parent == &root_) {
+        emit useRootChanged();
+    }
+}
+
+void MainTreeModel::addUnloadedChildren(TreeNode *parent, int count)
+{
+    assert(parent);
+    assert(parent->children().empty());
+    parent->setUnloadedChildren(std::max(parent->unloadedChildren() + count, 0));
+
+    if (parent->unloadedChildren() == 0 && parent != &root_) {
+        // The view must update the expand indicator
+        const auto ix = getIndex(parent);
+        emit dataChanged(ix, ix);
+    }
+}
+
+void MainTreeModel::insertNode(TreeNode::node_list_t &list, TreeNode *tn, int row)
 {
     if (row >= list.size()) {
+        tn->setRow(list.size());
         list.append(tn);
     } else {
         list.insert(row, tn);
+        updateRows(list, row);
     }
 }
 
+void MainTreeModel::sortIntoPlace(TreeNode *tn)
+{
+    assert(tn->parent());
+    auto& list = tn->parent()->children();
+    const auto src = tn->row();
+
+    // The siblings before and after the node are still sorted
+    const auto pos = list.cbegin() + src;
+    auto it = std::ranges::upper_bound(list.cbegin(), pos, tn, lessByName);
+    if (it == pos) {
+        it = std::ranges::upper_bound(pos + 1, list.cend(), tn, lessByName);
+        if (it == pos + 1) {
+            return; // Already in place
+        }
+    }
+
+    const auto dst = static_cast<int>(std::distance(list.cbegin(), it));
+    const auto parent_ix = getIndex(tn->parent());
+    beginMoveRows(parent_ix, src, src, parent_ix, dst);
+    insertNode(list, takeNode(list, src), dst > src ? dst - 1 : dst);
+    endMoveRows();
+}
+
+MainTreeModel::TreeNode *MainTreeModel::takeNode(TreeNode::node_list_t &list, int row)
+{
+    auto *tn = list.takeAt(row);
+    updateRows(list, row);
+    return tn;
+}
+
 QModelIndex MainTreeModel::getIndex(TreeNode *node)
 {
     assert(node);
@@ -356,29 +479,22 @@ QModelIndex MainTreeModel::getIndex(TreeNode *node)
         return createIndex(0, 0, &root_);
     }
 
-    auto& list = const_cast<MainTreeModel *>(this)->getListFromChild(*node);
-    const auto row = getRow(list, node->uuid());
-    if (row) {
-        return createIndex(*row, 0, node);
-    }
-
-    assert(false);
-    return {};
+    assert(node->parent());
+    assert(node->parent()->children().at(node->row()) == node);
+    return createIndex(node->row(), 0, node);
 }
 
-// We insert in sorted order.
+// We insert in sorted order, after any siblings with the same name.
 int MainTreeModel::getInsertRow(const TreeNode *parent, const nextapp::pb::Node &node)
 {
     assert(parent);
-    int row = 0;
-    for(const auto& n : parent->children()) {
-        if (n->node().name().compare(node.name(), Qt::CaseInsensitive) > 0) {
-            return row;
-        }
-        ++row;
-    }
+    const auto& list = parent->children();
+    const auto key = collator_.sortKey(node.name());
+    const auto it = std::ranges::upper_bound(list, key, [](const auto& left, const auto& right) {
+        return left.compare(right) < 0;
+    }, &TreeNode::sortKey);
 
-    return row;
+    return static_cast<int>(std::distance(list.cbegin(), it));
 }
 
 void MainTreeModel::pocessUpdate(const nextapp::pb::Update &update)
@@ -392,16 +508,20 @@ void MainTreeModel::pocessUpdate(const nextapp::pb::Update &update)
 
     TreeNode* parent = &root_;
     if (!node.parent().isEmpty()) {
+        // nullptr if the parent is not loaded
         parent = lookupTreeNode(QUuid{node.parent()});
     }
     assert(!node.uuid().isEmpty());
 
     TreeNode* current = lookupTreeNode(QUuid{node.uuid()});
 
+    // The children of a node that is not expanded are not loaded. We just keep count of them.
+    const bool parent_loaded = parent && parent->unloadedChildren() == 0;
+
     const auto op = update.op();
 
     if (op != Update::Operation::DELETED) {
-        if (current && current->node().version() > node.version()) {
+        if (current && current->version() > node.version()) {
             LOG_DEBUG << "Received updated/added/moved node " << node.uuid() <<" with version less than the existing node. Ignoring.";
             return;
         }
@@ -410,26 +530,51 @@ void MainTreeModel::pocessUpdate(const nextapp::pb::Update &update)
     switch(op) {
     case Update::Operation::ADDED:
 added:
-        assert(current == nullptr);
-        assert(parent);
+        if (current) {
+            // It came with the children we fetched
+            break;
+        }
+        if (!parent_loaded) {
+            if (parent) {
+                addUnloadedChildren(parent, 1);
+            }
+            break;
+        }
         addNode(parent, node);
         break;
     case Update::Operation::UPDATED:
-        assert(current);
+        if (!current) {
+            break; // Not loaded
+        }
         {
+            const bool renamed = current->name() != node.name();
             auto cix = getIndex(current);
-            current->node() = node;
+            current->setNode(node, strings_, collator_);
             emit dataChanged(cix, cix);
+            if (renamed) {
+                sortIntoPlace(current);
+            }
         }
         break;
     case Update::Operation::MOVED:
         if (current) {
-            assert(parent);
-            assert(parent != current->parent());
-            moveNode(parent, current, node);
+            if (!parent_loaded) {
+                // Moved into a branch that is not loaded
+                removeNode(current);
+                if (parent) {
+                    addUnloadedChildren(parent, 1);
+                }
+            } else if (parent == current->parent()) {
+                // It came with the children we fetched
+                current->setNode(node, strings_, collator_);
+                const auto cix = getIndex(current);
+                emit dataChanged(cix, cix);
+            } else {
+                moveNode(parent, current, node);
+            }
         } else {
-            // Add it!
-            LOG_WARN << "Failed to locate moved node " << current->node().uuid() << ". Will add it.";
+            // It was in a branch that is not loaded. Add it!
+            LOG_DEBUG << "Moved node " << node.uuid() << " is not loaded. Will add it.";
             goto added;
         }
         break;
@@ -439,10 +584,6 @@ added:
                 LOG_WARN << "Cannot delete root node!";
                 return;
             }
-            assert(parent);
-            auto cix = getIndex(current);
-            auto parent_ix = getIndex(parent);
-
             if (auto *sel = lookupTreeNode(QUuid{selected()})) {
                 if (sel == current || isDescent(sel->uuid(), current->uuid())) {
                     LOG_TRACE << "Clearing selection in tree due to deleted node.";
@@ -450,13 +591,9 @@ added:
                 }
             }
 
-            beginRemoveRows(parent_ix, cix.row(), cix.row());
-            parent->children().removeAt(cix.row());
-            endRemoveRows();
-
-            if (cix.row() == 0 && parent == &root_) {
-                emit useRootChanged();
-            }
+            removeNode(current);
+        } else if (parent && parent->unloadedChildren() > 0) {
+            addUnloadedChildren(parent, -1);
         }
         break;
     }
@@ -491,22 +628,13 @@ bool MainTreeModel::isDescent(const QUuid &nodeUuid, const QUuid &descentOf)
     return false;
 }
 
-MainTreeModel::TreeNode::node_list_t &MainTreeModel::getListFromChild(TreeNode &child)
-{
-
-    if (child.hasParent()) {
-        return child.parent()->children();
-    }
-
-    return root_.children();
-}
-
 void MainTreeModel::setAllNodes(const nextapp::pb::NodeTree& tree)
 {
     {
         ResetScope scope{*this};
         clear();
-        copyTreeBranch(root_.children(), tree.root().children(), uuid_index_, &root_);
+        uuid_index_.reserve(countNodes(tree.root().children()));
+        copyTreeBranch(root_, tree.root().children());
     }
 
     // Handle corner-case when updates are arriving before we get the initial tree
@@ -521,6 +649,11 @@ void MainTreeModel::onUpdate(const std::shared_ptr<nextapp::pb::Update>& update)
     assert(update);
     if (update->hasNode()) {
         if (has_initial_tree_) {
+            // The reply with the children may, or may not, have the change
+            if (auto it = fetching_.find(QUuid{update->node().parent()}); it != fetching_.end()) {
+                it->push_back(update);
+                return;
+            }
             return pocessUpdate(*update);
         }
 
@@ -528,13 +661,79 @@ void MainTreeModel::onUpdate(const std::shared_ptr<nextapp::pb::Update>& update)
     }
 }
 
-MainTreeModel::TreeNode::TreeNode(nextapp::pb::Node node, TreeNode *parent)
-    : uuid_{node.uuid()}, node_{std::move(node)}, parent_{parent} {
+void MainTreeModel::onReceivedChildren(const QUuid &parentUuid, const nextapp::pb::NodeTree &tree)
+{
+    if (parentUuid.isNull()) {
+        setAllNodes(tree);
+        return;
+    }
+
+    const auto updates = fetching_.take(parentUuid);
+
+    // The parent may have been deleted, or loaded by a reset, while we waited
+    auto *parent = lookupTreeNode(parentUuid, false);
+    if (parent && parent->unloadedChildren() > 0) {
+        const auto& items = tree.root().children();
+        const auto count = static_cast<int>(std::ranges::count_if(items, [this](const auto& item) {
+            return !uuid_index_.contains(QUuid{item.node().uuid()});
+        }));
+
+        if (count > 0) {
+            beginInsertRows(getIndex(parent), 0, count - 1);
+            copyTreeBranch(*parent, items);
+            parent->setUnloadedChildren(0);
+            endInsertRows();
+        } else {
+            addUnloadedChildren(parent, -parent->unloadedChildren());
+        }
+    }
+
+    std::ranges::for_each(updates, [this](const auto& update) {
+        pocessUpdate(*update);
+    });
+}
+
+void MainTreeModel::onFailedToGetChildren(const QUuid &parentUuid)
+{
+    LOG_WARN_N << "Failed to get the children of " << parentUuid.toString();
+
+    const auto updates = fetching_.take(parentUuid);
+    std::ranges::for_each(updates, [this](const auto& update) {
+        pocessUpdate(*update);
+    });
+}
 
-    auto name = node_.name();
-    if (!name.isEmpty() && !parent) {
-        LOG_WARN << "Impossible!";
-        assert(false);
+nextapp::pb::Node MainTreeModel::TreeNode::node() const
+{
+    nextapp::pb::Node node;
+    node.setUuid(uuid_.toString(QUuid::WithoutBraces));
+    if (parent_ && !parent_->uuid().isNull()) {
+        node.setParent(parent_->uuid().toString(QUuid::WithoutBraces));
+    }
+    node.setUser(user_);
+    node.setActive(active_);
+    node.setName(name_);
+    node.setKind(kind_);
+    node.setDescr(descr());
+    node.setVersion(version_);
+    return node;
+}
+
+void MainTreeModel::TreeNode::setNode(const nextapp::pb::Node &node, StringPool &strings, const QCollator& collator)
+{
+    uuid_ = QUuid{node.uuid()};
+    if (!sort_key_ || name_ != node.name()) {
+        sort_key_.emplace(collator.sortKey(node.name()));
+    }
+    name_ = strings.intern(node.name());
+    user_ = strings.intern(node.user());
+    active_ = node.active();
+    kind_ = node.kind();
+    version_ = node.version();
+    if (node.descr().isEmpty()) {
+        descr_.reset();
+    } else {
+        descr_ = make_unique<QString>(node.descr());
     }
 }
 
@@ -543,18 +742,61 @@ QVariant MainTreeModel::TreeNode::data(int role)
     switch(role) {
     case Qt::DisplayRole:
     case NameRole:
-        return node().name();
+        return name();
     case UuidRole:
-        return node().uuid();
+        return uuid().toString(QUuid::WithoutBraces);
     case KindRole:
-        return MainTreeModel::toString(node().kind());
+        return MainTreeModel::toString(kind());
     case DescrRole:
-        return node().descr();
+        return descr();
     }
 
     return {};
 }
 
+QString MainTreeModel::StringPool::intern(const QString &str)
+{
+    if (str.isEmpty()) {
+        return {};
+    }
+
+    if (auto it = strings_.constFind(str); it != strings_.cend()) {
+        return *it;
+    }
+
+    strings_.insert(str);
+    return str;
+}
+
+MainTreeModel::TreeNode *MainTreeModel::NodeArena::create()
+{
+    if (!free_.empty()) {
+        auto *node = free_.back();
+        free_.pop_back();
+        return node;
+    }
+
+    if (used_ == blocks_.size() * block_size) {
+        blocks_.emplace_back(make_unique<TreeNode[]>(block_size));
+    }
+
+    return &blocks_.back()[used_++ % block_size];
+}
+
+void MainTreeModel::NodeArena::release(TreeNode *node)
+{
+    assert(node);
+    *node = {};
+    free_.push_back(node);
+}
+
+void MainTreeModel::NodeArena::clear()
+{
+    blocks_.clear();
+    free_.clear();
+    used_ = 0;
+}
+
 QHash<int, QByteArray> MainTreeModel::TreeNode::roleNames() {
     QHash<int, QByteArray> roles;
     roles[NameRole] = "name";
@@ -566,7 +808,7 @@ QHash<int, QByteArray> MainTreeModel::TreeNode::roleNames() {
 QString MainTreeModel::nodeName(const QModelIndex &ix) const
 {
     if (auto current = getTreeNode(ix)) {
-        return current->node().name();
+        return current->name();
     }
 
     return {};
@@ -638,7 +880,7 @@ void MainTreeModel::updateNode(const QVariantMap args)
 QString MainTreeModel::uuidFromModelIndex(const QModelIndex ix)
 {
     if (auto current = getTreeNode(ix)) {
-        return current->node().uuid();
+        return current->uuid().toString(QUuid::WithoutBraces);
     }
 
     return {};
@@ -1,10 +1,17 @@
 #pragma once
 
+#include <memory>
+#include <optional>
+#include <vector>
+
 #include <QObject>
 #include <QMap>
 #include <QHash>
+#include <QSet>
 #include <QUuid>
 #include <QAbstractItemModel>
+#include <QCollator>
+#include <QCollatorSortKey>
 
 #include "nextapp.qpb.h"
 
@@ -27,6 +34,24 @@ public:
         MainTreeModel& model_;
     };
 
+    // Keeps one copy of equal strings, like the user and common node names
+    class StringPool {
+    public:
+        QString intern(const QString& str);
+
+        void clear() {
+            strings_.clear();
+        }
+
+    private:
+        QSet<QString> strings_;
+    };
+
+    /*! A node in the tree.
+     *
+     *  Only the fields the tree needs are kept. The pb::Node is built by
+     *  node() when the UI asks for it.
+     */
     class TreeNode {
     public:
         enum Roles {
@@ -36,11 +61,10 @@ public:
             DescrRole,
         };
 
-        // In QT 6.6, QList<> does not work with std::unique_ptr
-        using node_list_t = QList<std::shared_ptr<TreeNode>>;
+        // The nodes are owned by the NodeArena
+        using node_list_t = QList<TreeNode *>;
 
         TreeNode() = default;
-        TreeNode(::nextapp::pb::Node node, TreeNode *parent = {});
 
         auto& children() noexcept {
             return children_;
@@ -50,12 +74,32 @@ public:
             return children_;
         }
 
-        auto& node() noexcept {
-            return node_;
+        // Builds the node, with the parent from the tree
+        [[nodiscard]] ::nextapp::pb::Node node() const;
+
+        // Copy the values from `node`. The parent is set by setParent().
+        void setNode(const ::nextapp::pb::Node& node, StringPool& strings, const QCollator& collator);
+
+        [[nodiscard]] const QString& name() const noexcept {
+            return name_;
+        }
+
+        // For sorting by name. Made once, when the name is set.
+        [[nodiscard]] const QCollatorSortKey& sortKey() const noexcept {
+            assert(sort_key_);
+            return *sort_key_;
+        }
+
+        [[nodiscard]] ::nextapp::pb::Node::Kind kind() const noexcept {
+            return kind_;
         }
 
-        const auto& node() const noexcept {
-            return node_;
+        [[nodiscard]] qint64 version() const noexcept {
+            return version_;
+        }
+
+        [[nodiscard]] QString descr() const {
+            return descr_ ? *descr_ : QString{};
         }
 
         bool hasParent() const noexcept {
@@ -72,7 +116,26 @@ public:
 
         void setParent(TreeNode *parent) {
             parent_ = parent;
-            assert(node_.parent() == parent->node().uuid());
+        }
+
+        // The position in the parent's list of children. Kept up to date by
+        // the model when the list changes, so parent() does not need to search.
+        [[nodiscard]] int row() const noexcept {
+            return row_;
+        }
+
+        void setRow(int row) noexcept {
+            row_ = row;
+        }
+
+        // Children on the server that are not loaded yet. They are all
+        // loaded at once, so when this is set, children() is empty.
+        [[nodiscard]] int unloadedChildren() const noexcept {
+            return unloaded_children_;
+        }
+
+        void setUnloadedChildren(int count) noexcept {
+            unloaded_children_ = count;
         }
 
         QVariant data(int role);
@@ -89,9 +152,46 @@ public:
 
     private:
         QUuid uuid_;
-        ::nextapp::pb::Node node_;
+        QString name_;
+        QString user_;
         node_list_t children_;
+        // Few nodes have a description, so it's only allocated when there is one
+        std::unique_ptr<QString> descr_;
+        // QCollatorSortKey has no default constructor
+        std::optional<QCollatorSortKey> sort_key_;
         TreeNode *parent_{};
+        qint64 version_{};
+        int row_{};
+        int unloaded_children_{};
+        ::nextapp::pb::Node::Kind kind_{};
+        bool active_{};
+    };
+
+    /*! Owns the nodes in the tree.
+     *
+     *  The nodes are allocated in blocks, instead of one by one. A node never
+     *  moves, as the QModelIndex'es point to it, and released nodes are reused.
+     */
+    class NodeArena {
+    public:
+        TreeNode *create();
+
+        // Resets the node and keeps it for reuse
+        void release(TreeNode *node);
+
+        void clear();
+
+        size_t size() const noexcept {
+            return used_ - free_.size();
+        }
+
+    private:
+        static constexpr size_t block_size = 1024;
+
+        std::vector<std::unique_ptr<TreeNode[]>> blocks_;
+        std::vector<TreeNode *> free_;
+        // Nodes taken from the blocks, including the released ones
+        size_t used_ = 0;
     };
 
     explicit MainTreeModel(QObject *parent = nullptr);
@@ -141,6 +241,8 @@ public:
     int columnCount(const QModelIndex &parent) const;
     QVariant data(const QModelIndex &index, int role) const;
     [[nodiscard]] bool hasChildren(const QModelIndex &parent) const;
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
     [[nodiscard]] QHash<int, QByteArray> roleNames() const {
         return TreeNode::roleNames();
     }
@@ -154,6 +256,12 @@ public slots:
 
     void onUpdate(const std::shared_ptr<nextapp::pb::Update>& update);
 
+    // Adds the children we asked for in fetchMore(). The null uuid replaces the tree.
+    void onReceivedChildren(const QUuid& parent, const nextapp::pb::NodeTree& tree);
+
+    // Applies the updates we held back in fetchMore(), so the children can be fetched again
+    void onFailedToGetChildren(const QUuid& parent);
+
     void clear();
 
     std::unique_ptr<ResetScope> resetScope() {
@@ -172,17 +280,30 @@ public slots:
 private:
     void addNode(TreeNode *parent, const nextapp::pb::Node& node);
     void moveNode(TreeNode *parent, TreeNode *current, const nextapp::pb::Node& node);
-    void insertNode(TreeNode::node_list_t& list, std::shared_ptr<TreeNode>& tn, int row);
+    TreeNode *createNode(const nextapp::pb::Node& node, TreeNode *parent);
+    void copyTreeBranch(TreeNode& parent, const QList<nextapp::pb::NodeTreeItem>& from);
+    void releaseBranch(TreeNode *node);
+    void removeNode(TreeNode *current);
+    void addUnloadedChildren(TreeNode *parent, int count);
+    void insertNode(TreeNode::node_list_t& list, TreeNode *tn, int row);
+    TreeNode *takeNode(TreeNode::node_list_t& list, int row);
+    void sortIntoPlace(TreeNode *tn);
     QModelIndex getIndex(TreeNode *node);
     int getInsertRow(const TreeNode *parent, const nextapp::pb::Node& node);
     void pocessUpdate(const nextapp::pb::Update& update);
     TreeNode *lookupTreeNode(const QUuid& uuid, bool emptyIsRoot = true);
     bool isDescent(const QUuid &uuid, const QUuid &toParentUuid);
 
-    TreeNode::node_list_t& getListFromChild(MainTreeModel::TreeNode& child);
+    NodeArena arena_;
+    StringPool strings_;
+    // Compares the names in the users locale, ignoring case
+    QCollator collator_;
     TreeNode root_;
-    QMap<QUuid, TreeNode*> uuid_index_;
+    QHash<QUuid, TreeNode*> uuid_index_;
     std::vector<std::shared_ptr<nextapp::pb::Update>> pending_updates_;
+    // Parents we have asked the server for the children of, with the updates
+    // for their children that arrive before the reply
+    QHash<QUuid, std::vector<std::shared_ptr<nextapp::pb::Update>>> fetching_;
     bool has_initial_tree_ = false;
     QString selected_;
     static MainTreeModel *instance_;
@@ -168,6 +168,26 @@ void ServerComm::getNodeTree()
     }, req);
 }
 
+void ServerComm::getChildren(const QUuid &parent, int depth)
+{
+    nextapp::pb::GetChildrenReq req;
+    if (!parent.isNull()) {
+        req.setParent(parent.toString(QUuid::WithoutBraces));
+    }
+    req.setDepth(depth);
+
+    GrpcCallOptions opts;
+    opts.on_error = [this, parent](const QGrpcStatus&) {
+        emit failedToGetChildren(parent);
+    };
+
+    callRpc<nextapp::pb::NodeTree>([this](nextapp::pb::GetChildrenReq req) {
+        return client_->GetChildren(req);
+    }, [this, parent](const nextapp::pb::NodeTree& tree) {
+        emit receivedChildren(parent, tree);
+    }, opts, req);
+}
+
 void ServerComm::getDayColorDefinitions()
 {    
     callRpc<nextapp::pb::DayColorDefinitions>([this]() {
@@ -198,6 +218,20 @@ void ServerComm::fetchDay(int year, int month, int day)
     }, req);
 }
 
+void ServerComm::getDayStats(int year)
+{
+    nextapp::pb::DayStatsReq req;
+    req.setYear(year);
+
+    callRpc<nextapp::pb::DayStats>([this](nextapp::pb::DayStatsReq req) {
+        return client_->GetDayStats(req);
+    } , [this, year](const nextapp::pb::DayStats& stats) {
+        LOG_TRACE << "Received day stats for " << year;
+        assert(stats.year() == year);
+        emit receivedDayStats(stats);
+    }, req);
+}
+
 void ServerComm::createPerson(const nextapp::pb::User &user)
 {
     qDebug() << "ServerComm::createPerson" << user.name() << user.email() << user.kind();
@@ -63,10 +63,15 @@ public:
 
     void getNodeTree();
 
+    // The children of `parent`, `depth` levels down. The null uuid is the top level.
+    void getChildren(const QUuid& parent, int depth);
+
     void getDayColorDefinitions();
 
     void fetchDay(int year, int month, int day);
 
+    void getDayStats(int year);
+
     static QString getDefaultServerAddress() {
         return SERVER_ADDRESS;
     }
@@ -87,10 +92,18 @@ signals:
     // When we get the full node-list
     void receivedNodeTree(const nextapp::pb::NodeTree& tree);
 
+    // When we get the nodes below `parent` we asked for with getChildren()
+    void receivedChildren(const QUuid& parent, const nextapp::pb::NodeTree& tree);
+
+    // When getChildren() for `parent` failed
+    void failedToGetChildren(const QUuid& parent);
+
     void receivedMonth(const nextapp::pb::Month& month);
 
     void receivedDay(const nextapp::pb::CompleteDay& day);
 
+    void receivedDayStats(const nextapp::pb::DayStats& stats);
+
     // Triggered on all updates from the server
     void onUpdate(const std::shared_ptr<nextapp::pb::Update>& update);
 
@@ -104,12 +117,15 @@ private:
 
     struct GrpcCallOptions {
         bool enable_queue = true;
+
+        // Called if the request fails, after the error is logged
+        std::function<void(const QGrpcStatus& status)> on_error;
     };
 
     template <typename respT, typename callT, typename doneT, typename ...Args>
     void callRpc_(callT&& call, doneT && done, const GrpcCallOptions& opts, Args... args) {
 
-        auto exec = [this, call=std::move(call), done=std::move(done), args...]() {
+        auto exec = [this, call=std::move(call), done=std::move(done), on_error=opts.on_error, args...]() {
             auto rpc_method = call(args...);
             rpc_method->subscribe(this, [this, rpc_method, done=std::move(done)] () {
                 respT rval = rpc_method-> template read<respT>();
@@ -121,8 +137,11 @@ private:
                     assert(!done);
                 }
             },
-            [this](QGrpcStatus status) {
+            [this, on_error](QGrpcStatus status) {
                 LOG_ERROR_N << "Comm error: " << status.message();
+                if (on_error) {
+                    on_error(status);
+                }
             });
         };
 
@@ -0,0 +1,227 @@
+// Benchmark and stress test for MainTreeModel with a large tree.
+//
+// Loads a tree of about 100k nodes with setAllNodes(), walks it the way the
+// QML TreeView does when everything is expanded, and applies 10k random
+// add/move/delete updates. The peak memory for the process is reported when
+// the benchmarks are done.
+//
+// Run with -median N or -iterations N to get stable numbers, and compare
+// the output before and after a change to the model.
+
+#include <array>
+#include <random>
+#include <vector>
+
+#include <QtTest>
+
+#ifdef Q_OS_UNIX
+#   include <sys/resource.h>
+#endif
+
+#include "MainTreeModel.h"
+
+using namespace std;
+
+namespace {
+
+// Children for each node on each level; 10 + 100 + 1000 + 100000 nodes
+constexpr auto levels = to_array<unsigned>({10, 10, 10, 100});
+
+constexpr unsigned num_updates = 10'000;
+
+QString newUuid() {
+    return QUuid::createUuid().toString(QUuid::StringFormat::WithoutBraces);
+}
+
+nextapp::pb::Node createNode(const QString& name, const QString& parent, bool leaf) {
+    nextapp::pb::Node n;
+    n.setUuid(newUuid());
+    n.setName(name);
+    n.setParent(parent);
+    n.setKind(leaf ? nextapp::pb::Node::Kind::TASK : nextapp::pb::Node::Kind::FOLDER);
+    n.setVersion(1);
+    return n;
+}
+
+void addChildren(nextapp::pb::NodeTreeItem& item, size_t level, vector<QString>& uuids) {
+    if (level >= levels.size()) {
+        return;
+    }
+
+    const bool leaf = level + 1 == levels.size();
+    for(unsigned i = 0; i < levels[level]; ++i) {
+        nextapp::pb::NodeTreeItem child;
+        // Descending names, so the model has to sort each level
+        child.setNode(createNode(QString{"Node %1-%2"}.arg(level).arg(levels[level] - i),
+                                 item.node().uuid(), leaf));
+        uuids.push_back(child.node().uuid());
+        addChildren(child, level + 1, uuids);
+        item.children().append(child);
+    }
+}
+
+// Memory in KB from /proc/self/status, like "VmRSS" or "VmHWM"
+qint64 procStatus(const char *name) {
+#ifdef Q_OS_LINUX
+    QFile file{"/proc/self/status"};
+    if (file.open(QIODevice::ReadOnly)) {
+        const auto prefix = QByteArray{name} + ':';
+        for(auto line = file.readLine(); !line.isEmpty(); line = file.readLine()) {
+            if (line.startsWith(prefix)) {
+                return line.mid(prefix.size()).trimmed().split(' ').front().toLongLong();
+            }
+        }
+    }
+#endif
+    return -1;
+}
+
+qint64 peakMemoryKb() {
+    if (const auto hwm = procStatus("VmHWM"); hwm >= 0) {
+        return hwm;
+    }
+#ifdef Q_OS_UNIX
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#   ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024; // bytes
+#   else
+        return usage.ru_maxrss;
+#   endif
+    }
+#endif
+    return -1;
+}
+
+} // anon ns
+
+class BenchMainTreeModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() {
+        uuids_.reserve(120'000);
+        nextapp::pb::NodeTreeItem root;
+        addChildren(root, 0, uuids_);
+        tree_.setRoot(root);
+        qInfo() << "Tree with" << uuids_.size() << "nodes";
+    }
+
+    void setAllNodes() {
+        MainTreeModel model;
+        const auto before = procStatus("VmRSS");
+
+        QBENCHMARK {
+            model.setAllNodes(tree_);
+        }
+
+        if (const auto after = procStatus("VmRSS"); before >= 0 && after >= 0) {
+            qInfo() << "Memory used by the model:" << (after - before) / 1024 << "MB";
+        }
+        QCOMPARE(model.rowCount(model.index(0, 0, {})), static_cast<int>(levels.front()));
+    }
+
+    // Like the TreeView, when all the nodes are expanded
+    void traverse() {
+        MainTreeModel model;
+        model.setAllNodes(tree_);
+        size_t visited = 0;
+
+        QBENCHMARK {
+            visited = 0;
+            visit(model, model.index(0, 0, {}), visited);
+        }
+
+        QCOMPARE(visited, uuids_.size());
+    }
+
+    // Random add, move and delete updates, like the ones from the server
+    void updates() {
+        MainTreeModel model;
+        model.setAllNodes(tree_);
+        auto live = uuids_;
+        mt19937 rnd{1};
+        unsigned added = 0, moved = 0, deleted = 0;
+
+        const auto pick = [&] {
+            return live[uniform_int_distribution<size_t>{0, live.size() - 1}(rnd)];
+        };
+
+        QBENCHMARK_ONCE {
+            for(unsigned i = 0; i < num_updates; ++i) {
+                auto update = make_shared<nextapp::pb::Update>();
+                const auto what = uniform_int_distribution<int>{0, 9}(rnd);
+
+                if (what < 4) {
+                    const auto parent = pick();
+                    update->setOp(nextapp::pb::Update::Operation::ADDED);
+                    update->setNode(createNode(QString{"Added %1"}.arg(i), parent, true));
+                    live.push_back(update->node().uuid());
+                    ++added;
+                } else if (what < 7) {
+                    const auto uuid = pick();
+                    const auto parent = pick();
+                    auto node = MainTreeModel::toNode(model.nodeMapFromUuid(uuid));
+                    if (node.parent() == parent || !model.canMove(uuid, parent)) {
+                        continue;
+                    }
+                    node.setParent(parent);
+                    node.setVersion(node.version() + 1);
+                    update->setOp(nextapp::pb::Update::Operation::MOVED);
+                    update->setNode(node);
+                    ++moved;
+                } else {
+                    // Only leafs, so the nodes in `live` stay valid
+                    const auto ix = uniform_int_distribution<size_t>{0, live.size() - 1}(rnd);
+                    const auto uuid = live[ix];
+                    if (model.hasChildren(model.indexFromUuid(uuid))) {
+                        continue;
+                    }
+                    update->setOp(nextapp::pb::Update::Operation::DELETED);
+                    update->setNode(MainTreeModel::toNode(model.nodeMapFromUuid(uuid)));
+                    live[ix] = live.back();
+                    live.pop_back();
+                    ++deleted;
+                }
+
+                model.onUpdate(update);
+            }
+        }
+
+        qInfo() << "Added" << added << "moved" << moved << "and deleted" << deleted << "nodes";
+        size_t visited = 0;
+        visit(model, model.index(0, 0, {}), visited);
+        QCOMPARE(visited, live.size());
+    }
+
+    void cleanupTestCase() {
+        if (const auto peak = peakMemoryKb(); peak >= 0) {
+            qInfo() << "Peak memory:" << peak / 1024 << "MB";
+        }
+    }
+
+private:
+    // The calls the TreeView makes for each row it shows
+    static void visit(const MainTreeModel& model, const QModelIndex& parent, size_t& visited) {
+        const auto rows = model.rowCount(parent);
+        for(int row = 0; row < rows; ++row) {
+            const auto ix = model.index(row, 0, parent);
+            QVERIFY(ix.isValid());
+            QCOMPARE(model.parent(ix), parent);
+            model.data(ix, MainTreeModel::TreeNode::NameRole);
+            model.data(ix, MainTreeModel::TreeNode::KindRole);
+            ++visited;
+            if (model.hasChildren(ix)) {
+                visit(model, ix, visited);
+            }
+        }
+    }
+
+    nextapp::pb::NodeTree tree_;
+    vector<QString> uuids_;
+};
+
+QTEST_GUILESS_MAIN(BenchMainTreeModel)
+
+#include "bench_main_tree_model.moc"
@@ -9,6 +9,8 @@ Rectangle {
     id: root
 
     property int fontSize: 16
+    property int year: 2024
+    property var stats: DaysModel.yearStats
 
     color: Colors.background
 
@@ -80,8 +82,23 @@ Rectangle {
         Month {
             month: Calendar.December
         }
+
+        Text {
+            Layout.columnSpan: 4
+            Layout.alignment: Qt.AlignHCenter
+            color: Colors.text
+            font.pixelSize: root.fontSize
+            visible: root.stats.year === root.year
+            text: qsTr("Average score %1 over %2 days. Longest streak %3 days. Current streak %4 days.")
+                    .arg(Number(root.stats.averageScore).toFixed(1))
+                    .arg(root.stats.days)
+                    .arg(root.stats.longestStreak)
+                    .arg(root.stats.currentStreak)
+        }
     }
 
+    Component.onCompleted: DaysModel.fetchYearStats(root.year)
+
     component Quarter : Text {
             id: qtext
             color: Colors.text
@@ -141,7 +158,7 @@ Rectangle {
                 MonthGrid {
                     id: grid
                     month: grid.month
-                    year: 2024
+                    year: root.year
 
                     Layout.fillWidth: true
                     Layout.fillHeight: true
@@ -0,0 +1,347 @@
+// Tests for how MainTreeModel loads the children of a node on demand, and
+// for how it applies the updates from the server to a partly loaded tree.
+//
+// The trees are small, and the replies from the server are delivered by
+// calling the model's slots. ServerComm is not started, so the requests
+// from fetchMore() are just queued.
+
+#include <memory>
+
+#include <QtTest>
+
+#include "MainTreeModel.h"
+#include "ServerComm.h"
+
+using namespace std;
+using nextapp::pb::Update;
+
+namespace {
+
+// The same uuid for a name each time, so the tests can refer to the nodes by name
+QString uuid(const QString& name) {
+    return QUuid::createUuidV5(QUuid{}, name).toString(QUuid::WithoutBraces);
+}
+
+nextapp::pb::Node createNode(const QString& name, const QString& parent = {}, qint64 version = 1) {
+    nextapp::pb::Node n;
+    n.setUuid(uuid(name));
+    n.setName(name);
+    if (!parent.isEmpty()) {
+        n.setParent(uuid(parent));
+    }
+    n.setKind(nextapp::pb::Node::Kind::FOLDER);
+    n.setVersion(version);
+    return n;
+}
+
+// A node with `unloaded` children on the server, that are not sent
+nextapp::pb::NodeTreeItem createItem(const QString& name, const QString& parent = {}, int unloaded = 0) {
+    nextapp::pb::NodeTreeItem item;
+    item.setNode(createNode(name, parent));
+    item.setChildCount(unloaded);
+    return item;
+}
+
+nextapp::pb::NodeTree createTree(const QList<nextapp::pb::NodeTreeItem>& items) {
+    nextapp::pb::NodeTreeItem root;
+    root.setChildren(items);
+    nextapp::pb::NodeTree tree;
+    tree.setRoot(root);
+    return tree;
+}
+
+shared_ptr<Update> createUpdate(Update::Operation op, const nextapp::pb::Node& node) {
+    auto update = make_shared<Update>();
+    update->setOp(op);
+    update->setNode(node);
+    return update;
+}
+
+QStringList childNames(const MainTreeModel& model, const QModelIndex& parent) {
+    QStringList names;
+    for(int row = 0; row < model.rowCount(parent); ++row) {
+        names.append(model.data(model.index(row, 0, parent), MainTreeModel::TreeNode::NameRole).toString());
+    }
+    return names;
+}
+
+// Checks that each index agrees with its parent about where it is
+void verifyBranch(const MainTreeModel& model, const QModelIndex& parent) {
+    const auto rows = model.rowCount(parent);
+    if (rows > 0 || model.canFetchMore(parent)) {
+        QVERIFY(model.hasChildren(parent));
+    }
+    for(int row = 0; row < rows; ++row) {
+        const auto ix = model.index(row, 0, parent);
+        QVERIFY(ix.isValid());
+        QCOMPARE(ix.row(), row);
+        QCOMPARE(model.parent(ix), parent);
+        verifyBranch(model, ix);
+    }
+}
+
+} // anon ns
+
+class TestMainTreeModel : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase() {
+        comm_ = make_unique<ServerComm>();
+    }
+
+    void init() {
+        model_ = make_unique<MainTreeModel>();
+
+        // "a" has two children on the server that are not loaded
+        model_->setAllNodes(createTree({createItem("a", {}, 2), createItem("b"), createItem("c")}));
+        QCOMPARE(childNames(*model_, top()), (QStringList{"a", "b", "c"}));
+    }
+
+    void cleanup() {
+        model_.reset();
+    }
+
+    void cleanupTestCase() {
+        comm_.reset();
+    }
+
+    void fetchMore() {
+        auto& model = *model_;
+        const auto a = ix("a");
+        QVERIFY(model.hasChildren(a));
+        QVERIFY(model.canFetchMore(a));
+        QCOMPARE(model.rowCount(a), 0);
+
+        model.fetchMore(a);
+        QVERIFY(!model.canFetchMore(a));
+
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("a2", "a", 1), createItem("a1", "a")}));
+        QCOMPARE(childNames(model, a), (QStringList{"a1", "a2"}));
+        QVERIFY(!model.canFetchMore(a));
+        QVERIFY(model.canFetchMore(ix("a2")));
+        QVERIFY(!model.hasChildren(ix("a1")));
+        verifyBranch(model, {});
+    }
+
+    // Updates for the children that arrive before the reply are applied after it
+    void holdBackUpdatesWhileFetching() {
+        auto& model = *model_;
+        model.fetchMore(ix("a"));
+
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("a3", "a")));
+        // Also in the reply, as the server added it before it read the children
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("a2", "a")));
+        QCOMPARE(model.rowCount(ix("a")), 0);
+        QVERIFY(!model.indexFromUuid(uuid("a3")).isValid());
+
+        // Updates for other parents are not held back
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("b1", "b")));
+        QCOMPARE(childNames(model, ix("b")), QStringList{"b1"});
+
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("a1", "a"), createItem("a2", "a")}));
+        QCOMPARE(childNames(model, ix("a")), (QStringList{"a1", "a2", "a3"}));
+        verifyBranch(model, {});
+    }
+
+    // When the request fails, the held back updates go to the unloaded count
+    void replayUpdatesWhenFetchFails() {
+        auto& model = *model_;
+        model.fetchMore(ix("a"));
+
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("a3", "a")));
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("a4", "a")));
+        model.onUpdate(createUpdate(Update::Operation::DELETED, createNode("a1", "a")));
+
+        model.onFailedToGetChildren(uuidOf("a"));
+        QCOMPARE(model.rowCount(ix("a")), 0);
+        QVERIFY(model.hasChildren(ix("a")));
+        QVERIFY(model.canFetchMore(ix("a")));
+
+        model.fetchMore(ix("a"));
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("a2", "a"), createItem("a3", "a"),
+                                                          createItem("a4", "a")}));
+        QCOMPARE(childNames(model, ix("a")), (QStringList{"a2", "a3", "a4"}));
+        verifyBranch(model, {});
+    }
+
+    void unloadedChildren() {
+        auto& model = *model_;
+        QSignalSpy changed{&model, &QAbstractItemModel::dataChanged};
+
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("a3", "a")));
+        QCOMPARE(model.rowCount(ix("a")), 0);
+        QVERIFY(model.canFetchMore(ix("a")));
+
+        // A node moved into an unloaded branch only adds to the count
+        model.onUpdate(createUpdate(Update::Operation::MOVED, createNode("c", "a", 2)));
+        QVERIFY(!model.indexFromUuid(uuid("c")).isValid());
+        QCOMPARE(childNames(model, top()), (QStringList{"a", "b"}));
+        QCOMPARE(model.rowCount(ix("a")), 0);
+        verifyBranch(model, {});
+
+        // Deleting the four children on the server empties the node
+        model.onUpdate(createUpdate(Update::Operation::DELETED, createNode("a1", "a")));
+        model.onUpdate(createUpdate(Update::Operation::DELETED, createNode("a2", "a")));
+        model.onUpdate(createUpdate(Update::Operation::DELETED, createNode("a3", "a")));
+        QVERIFY(model.hasChildren(ix("a")));
+        QVERIFY(model.canFetchMore(ix("a")));
+        QCOMPARE(changed.count(), 0);
+
+        model.onUpdate(createUpdate(Update::Operation::DELETED, createNode("c", "a", 2)));
+        QVERIFY(!model.hasChildren(ix("a")));
+        QVERIFY(!model.canFetchMore(ix("a")));
+        QCOMPARE(changed.count(), 1);
+        QCOMPARE(changed.front().front().value<QModelIndex>(), ix("a"));
+
+        // The count never goes below zero
+        model.onUpdate(createUpdate(Update::Operation::DELETED, createNode("a4", "a")));
+        QVERIFY(!model.hasChildren(ix("a")));
+        verifyBranch(model, {});
+    }
+
+    // A node in the reply that is already in the tree is not added again
+    void skipNodesAlreadyLoaded() {
+        auto& model = *model_;
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("b1", "b")));
+        model.fetchMore(ix("a"));
+
+        // The server moved "b1" to "a" before it read the children
+        model.onUpdate(createUpdate(Update::Operation::MOVED, createNode("b1", "a", 2)));
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("a1", "a"), createItem("b1", "a")}));
+        QCOMPARE(childNames(model, ix("a")), (QStringList{"a1", "b1"}));
+        QCOMPARE(model.rowCount(ix("b")), 0);
+        QCOMPARE(model.parent(ix("b1")), ix("a"));
+        verifyBranch(model, {});
+    }
+
+    // The reply has nothing new, so the node ends up with just the moved node
+    void skipAllNodesInReply() {
+        auto& model = *model_;
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("b1", "b")));
+        model.fetchMore(ix("a"));
+
+        model.onUpdate(createUpdate(Update::Operation::MOVED, createNode("b1", "a", 2)));
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("b1", "a")}));
+        QCOMPARE(childNames(model, ix("a")), QStringList{"b1"});
+        QVERIFY(!model.canFetchMore(ix("a")));
+        verifyBranch(model, {});
+    }
+
+    // A node moved out while we wait is not put back by an older reply
+    void moveOutOfFetchingBranch() {
+        auto& model = *model_;
+        model.fetchMore(ix("a"));
+
+        model.onUpdate(createUpdate(Update::Operation::MOVED, createNode("a1", "b", 2)));
+        QCOMPARE(childNames(model, ix("b")), QStringList{"a1"});
+
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("a1", "a"), createItem("a2", "a")}));
+        QCOMPARE(childNames(model, ix("a")), QStringList{"a2"});
+        QCOMPARE(childNames(model, ix("b")), QStringList{"a1"});
+        QCOMPARE(model.parent(ix("a1")), ix("b"));
+        verifyBranch(model, {});
+    }
+
+    // A node moved into the branch we fetch, from a branch that is not loaded
+    void moveIntoFetchingBranch() {
+        auto& model = *model_;
+        model.fetchMore(ix("a"));
+
+        model.onUpdate(createUpdate(Update::Operation::MOVED, createNode("x", "a", 2)));
+        QVERIFY(!model.indexFromUuid(uuid("x")).isValid());
+
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("a1", "a"), createItem("a2", "a")}));
+        QCOMPARE(childNames(model, ix("a")), (QStringList{"a1", "a2", "x"}));
+        verifyBranch(model, {});
+    }
+
+    void sortIntoPlace() {
+        auto& model = *model_;
+
+        auto node = createNode("b", {}, 2);
+        node.setName("d");
+        model.onUpdate(createUpdate(Update::Operation::UPDATED, node));
+        QCOMPARE(childNames(model, top()), (QStringList{"a", "c", "d"}));
+        verifyBranch(model, {});
+
+        node = createNode("c", {}, 2);
+        node.setName("0");
+        model.onUpdate(createUpdate(Update::Operation::UPDATED, node));
+        QCOMPARE(childNames(model, top()), (QStringList{"0", "a", "d"}));
+        verifyBranch(model, {});
+
+        // Still in place, and only the data changes
+        QSignalSpy moved{&model, &QAbstractItemModel::rowsMoved};
+        node = createNode("a", {}, 2);
+        node.setName("b");
+        model.onUpdate(createUpdate(Update::Operation::UPDATED, node));
+        QCOMPARE(childNames(model, top()), (QStringList{"0", "b", "d"}));
+        QCOMPARE(moved.count(), 0);
+        verifyBranch(model, {});
+    }
+
+    void reuseReleasedNodes() {
+        MainTreeModel::NodeArena arena;
+        auto *first = arena.create();
+        auto *second = arena.create();
+        QCOMPARE(arena.size(), size_t{2});
+
+        first->setUnloadedChildren(3);
+        first->setRow(1);
+        first->children().append(second);
+        arena.release(first);
+        QCOMPARE(arena.size(), size_t{1});
+
+        auto *reused = arena.create();
+        QCOMPARE(reused, first);
+        QCOMPARE(reused->unloadedChildren(), 0);
+        QCOMPARE(reused->row(), 0);
+        QVERIFY(reused->children().empty());
+        QVERIFY(!reused->hasParent());
+        QCOMPARE(arena.size(), size_t{2});
+    }
+
+    // The nodes of a deleted branch are reused by the nodes added after it
+    void reuseDeletedBranch() {
+        auto& model = *model_;
+        model.fetchMore(ix("a"));
+        model.onReceivedChildren(uuidOf("a"), createTree({createItem("a1", "a"), createItem("a2", "a")}));
+
+        model.onUpdate(createUpdate(Update::Operation::DELETED, createNode("a")));
+        QVERIFY(!model.indexFromUuid(uuid("a")).isValid());
+        QVERIFY(!model.indexFromUuid(uuid("a1")).isValid());
+
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("d")));
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("d1", "d")));
+        model.onUpdate(createUpdate(Update::Operation::ADDED, createNode("d2", "d")));
+        QCOMPARE(childNames(model, top()), (QStringList{"b", "c", "d"}));
+        QCOMPARE(childNames(model, ix("d")), (QStringList{"d1", "d2"}));
+        QVERIFY(!model.canFetchMore(ix("d1")));
+        QVERIFY(!model.hasChildren(ix("d1")));
+        QCOMPARE(model.data(ix("d1"), MainTreeModel::TreeNode::DescrRole).toString(), QString{});
+        verifyBranch(model, {});
+    }
+
+private:
+    // The parent of the top level nodes
+    QModelIndex top() const {
+        return model_->index(0, 0, {});
+    }
+
+    QModelIndex ix(const QString& name) const {
+        return model_->indexFromUuid(uuid(name));
+    }
+
+    static QUuid uuidOf(const QString& name) {
+        return QUuid{uuid(name)};
+    }
+
+    unique_ptr<ServerComm> comm_;
+    unique_ptr<MainTreeModel> model_;
+};
+
+QTEST_GUILESS_MAIN(TestMainTreeModel)
+
+#include "tst_main_tree_model.moc"
@@ -0,0 +1,234 @@
+
+// Micro-benchmarks for the hot paths in the backend.
+//
+// The rows come from a synthetic source (rows.h), so no database is needed.
+// The heap allocations for each iteration are reported in the "allocs" counter.
+//
+// Save the results as JSON, to compare them across commits with the
+// tools/compare.py script from Google Benchmark:
+//
+//   nextapp_bench --benchmark_out=before.json --benchmark_out_format=json
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <queue>
+
+#include <benchmark/benchmark.h>
+#include <boost/uuid/uuid_io.hpp>
+#include <google/protobuf/arena.h>
+
+#include "nextapp/GrpcServer.h"
+#include "nextapp/Server.h"
+#include "grpc/shared_grpc_server.h"
+#include "rows.h"
+
+namespace {
+
+std::atomic_size_t allocations{0};
+
+} // anon ns
+
+void *operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (auto *p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+using namespace std;
+using namespace nextapp;
+using namespace nextapp::grpc;
+using namespace nextapp::bench;
+
+namespace {
+
+// Adds the "allocs" counter, as allocations per iteration
+class CountAllocs {
+public:
+    explicit CountAllocs(benchmark::State& state)
+        : state_{state}, start_{allocations.load()} {}
+
+    ~CountAllocs() {
+        state_.counters["allocs"] = benchmark::Counter(static_cast<double>(allocations.load() - start_),
+                                                       benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State& state_;
+    const size_t start_;
+};
+
+void BM_ToNodeAssign(benchmark::State& state) {
+    const auto rows = makeNodeRows(100, 10);
+    pb::Node node;
+    size_t i = 0;
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        ToNode::assign(rows[i++ % rows.size()], node);
+        benchmark::DoNotOptimize(node);
+    }
+}
+BENCHMARK(BM_ToNodeAssign);
+
+// The tree-linking in GetNodes, with the reply on the heap or on an arena like in the service
+void BM_BuildNodeTree(benchmark::State& state) {
+    const auto rows = makeNodeRows(static_cast<size_t>(state.range(0)), 10);
+    const bool use_arena = state.range(1) != 0;
+    state.SetLabel(use_arena ? "arena" : "heap");
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        if (use_arena) {
+            google::protobuf::Arena arena;
+            buildNodeTree(rows, *google::protobuf::Arena::CreateMessage<pb::NodeTree>(&arena));
+        } else {
+            pb::NodeTree reply;
+            buildNodeTree(rows, reply);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BuildNodeTree)->ArgsProduct({{1000, 10000}, {0, 1}})->Unit(benchmark::kMicrosecond);
+
+void BM_BuildMonth(benchmark::State& state) {
+    const auto rows = makeMonthRows();
+    const bool use_arena = state.range(0) != 0;
+    state.SetLabel(use_arena ? "arena" : "heap");
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        auto build = [&](pb::Month& reply) {
+            reply.set_year(2024);
+            reply.set_month(0);
+            buildMonth(rows, reply);
+        };
+
+        if (use_arena) {
+            google::protobuf::Arena arena;
+            build(*google::protobuf::Arena::CreateMessage<pb::Month>(&arena));
+        } else {
+            pb::Month reply;
+            build(reply);
+        }
+    }
+}
+BENCHMARK(BM_BuildMonth)->Arg(0)->Arg(1);
+
+void BM_ToJsonMessage(benchmark::State& state) {
+    const auto rows = makeNodeRows(1, 1);
+    pb::Node node;
+    ToNode::assign(rows.front(), node);
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(toJson(node));
+    }
+}
+BENCHMARK(BM_ToJsonMessage);
+
+void BM_ToJsonMap(benchmark::State& state) {
+    google::protobuf::Map<string, string> map;
+    for(auto i = 0; i < 8; ++i) {
+        map[format("key-{}", i)] = format("Some value {}", i);
+    }
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(toJson(map));
+    }
+}
+BENCHMARK(BM_ToJsonMap);
+
+void BM_ToAnsiDate(benchmark::State& state) {
+    pb::Date date;
+    date.set_year(2024);
+    date.set_month(1);
+    date.set_mday(29);
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(toAnsiDate(date));
+    }
+}
+BENCHMARK(BM_ToAnsiDate);
+
+void BM_ToDate(benchmark::State& state) {
+    const boost::mysql::date from{2024, 2, 29};
+    pb::Date date;
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        toDate(from, date);
+        benchmark::DoNotOptimize(date);
+    }
+}
+BENCHMARK(BM_ToDate);
+
+class BenchPublisher : public GrpcServer::Publisher {
+public:
+    // Like the subscriber's reactor, that queue the update for the stream
+    void publish(const std::shared_ptr<pb::Update>& message) override {
+        scoped_lock lock{mutex_};
+        updates_.emplace(message);
+        if (updates_.size() > 8) {
+            updates_.pop();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::queue<std::shared_ptr<pb::Update>> updates_;
+};
+
+// GrpcServer::publish to a number of subscribers
+void BM_PublishFanOut(benchmark::State& state) {
+    Server server{Config{}};
+    auto service = make_shared<GrpcServer>(server);
+
+    vector<shared_ptr<BenchPublisher>> publishers;
+    for(auto i = 0; i < state.range(0); ++i) {
+        publishers.emplace_back(make_shared<BenchPublisher>());
+        service->addPublisher(publishers.back());
+    }
+
+    auto update = make_shared<pb::Update>();
+    ToNode::assign(makeNodeRows(1, 1).front(), *update->mutable_node());
+
+    CountAllocs allocs{state};
+    for(auto _ : state) {
+        service->publish(update);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PublishFanOut)->RangeMultiplier(10)->Range(1, 1000);
+
+void BM_NewUuid(benchmark::State& state) {
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(newUuid());
+    }
+}
+BENCHMARK(BM_NewUuid)->Threads(1)->Threads(4);
+
+void BM_NewUuidString(benchmark::State& state) {
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(boost::uuids::to_string(newUuid()));
+    }
+}
+BENCHMARK(BM_NewUuidString);
+
+} // anon ns
+
+BENCHMARK_MAIN();
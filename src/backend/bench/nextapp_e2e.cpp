@@ -0,0 +1,310 @@
+
+// End-to-end benchmark for the gRPC service.
+//
+// Starts the server in this process on a local port, with the MemoryDb in place
+// of MariaDB, and sends requests from a number of client threads. Each client
+// sends one request at a time, round-robin over the operations.
+//
+// The database latency is injected with a fixed seed, so the results are
+// stable enough to compare between commits. With --max-p99-ms and --min-rps
+// the exit code is 1 if the service is slower than that, for use in CI.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <format>
+#include <iostream>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include <boost/program_options.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <grpcpp/grpcpp.h>
+
+#include "nextapp/GrpcServer.h"
+#include "nextapp/MemoryDb.h"
+#include "nextapp/Server.h"
+#include "nextapp.grpc.pb.h"
+#include "rows.h"
+
+using namespace std;
+using namespace nextapp;
+using namespace nextapp::grpc;
+using namespace nextapp::bench;
+
+namespace {
+
+constexpr array<string_view, 4> operations = {"GetNodes", "GetMonth", "SetColorOnDay", "CreateNode"};
+
+struct Options {
+    string address = "127.0.0.1:10399";
+    size_t clients = 8;
+    size_t duration_sec = 10;
+    size_t warmup_sec = 2;
+    size_t io_threads = 2;
+    size_t nodes = 1000;
+    uint64_t db_latency_us = 200;
+    uint64_t db_jitter_us = 100;
+    uint64_t seed = 1;
+    double max_p99_ms = 0;
+    double min_rps = 0;
+};
+
+// Replies shaped like the ones from MariaDB for the queries the operations use
+shared_ptr<MemoryDb> makeDb(const Options& opts) {
+    auto db = make_shared<MemoryDb>(MemoryDb::Latency{chrono::microseconds{opts.db_latency_us},
+                                                      chrono::microseconds{opts.db_jitter_us},
+                                                      opts.seed});
+
+    using boost::mysql::field;
+
+    db->on("SELECT version FROM nextapp", {{field{static_cast<int64_t>(Server::latest_version)}}});
+    db->on("SELECT id, name, color, score FROM day_colors", {
+        {field{string{"green"}}, field{string{"Green"}}, field{string{"#00ff00"}}, field{int64_t{10}}},
+        {field{string{"red"}}, field{string{"Red"}}, field{string{"#ff0000"}}, field{int64_t{-10}}}
+    });
+    db->on("SELECT score FROM day_colors", {{field{int64_t{10}}}});
+    db->on("SELECT date, user, color, ISNULL(notes)", makeMonthRows());
+    db->on("WITH RECURSIVE tree", makeNodeRows(opts.nodes, 10));
+    db->on("SELECT d.color", DbResult::rows_t{});
+    db->on("SELECT start", DbResult::rows_t{});
+    db->on("SELECT end", DbResult::rows_t{});
+
+    // RETURNING the node that was inserted
+    db->on("INSERT INTO node", [](string_view, MemoryDb::args_t args) {
+        DbResult::rows_t rows(1, row_t(args.begin(), args.end()));
+        rows.front().emplace_back(int64_t{1});
+        return DbResult{rows};
+    });
+
+    return db;
+}
+
+class Client {
+public:
+    Client(const shared_ptr<::grpc::Channel>& channel, size_t id)
+        : stub_{pb::Nextapp::NewStub(channel)}, id_{id} {}
+
+    // Sends the next operation. Returns false if it failed.
+    bool call(string_view operation) {
+        ::grpc::ClientContext ctx;
+        ctx.set_deadline(chrono::system_clock::now() + 10s);
+        ::grpc::Status status;
+
+        if (operation == "GetNodes") {
+            pb::GetNodesReq req;
+            pb::NodeTree reply;
+            status = stub_->GetNodes(&ctx, req, &reply);
+        } else if (operation == "GetMonth") {
+            pb::MonthReq req;
+            req.set_year(2024);
+            req.set_month(static_cast<int32_t>(count_ % 12));
+            pb::Month reply;
+            status = stub_->GetMonth(&ctx, req, &reply);
+        } else if (operation == "SetColorOnDay") {
+            pb::SetColorReq req;
+            req.mutable_date()->set_year(2024);
+            req.mutable_date()->set_month(static_cast<int32_t>(count_ % 12));
+            req.mutable_date()->set_mday(static_cast<int32_t>(1 + count_ % 28));
+            req.set_color("green");
+            pb::Status reply;
+            status = stub_->SetColorOnDay(&ctx, req, &reply);
+        } else {
+            pb::CreateNodeReq req;
+            auto *node = req.mutable_node();
+            node->set_uuid(boost::uuids::to_string(newUuid()));
+            node->set_name(format("Client #{} node {}", id_, count_));
+            node->set_kind(pb::Node::FOLDER);
+            pb::Status reply;
+            status = stub_->CreateNode(&ctx, req, &reply);
+        }
+
+        ++count_;
+        if (!status.ok()) {
+            LOG_DEBUG << operation << " failed: " << status.error_message();
+        }
+        return status.ok();
+    }
+
+private:
+    unique_ptr<pb::Nextapp::Stub> stub_;
+    const size_t id_;
+    size_t count_ = 0;
+};
+
+struct Samples {
+    vector<double> ms;
+    uint64_t failed = 0;
+};
+
+double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    const auto ix = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1));
+    return sorted[ix];
+}
+
+// Returns true if the thresholds were met
+bool runLoad(const Options& opts) {
+    auto channel = ::grpc::CreateChannel(opts.address, ::grpc::InsecureChannelCredentials());
+    if (!channel->WaitForConnected(chrono::system_clock::now() + 10s)) {
+        cerr << "Failed to connect to " << opts.address << endl;
+        return false;
+    }
+
+    using clock = chrono::steady_clock;
+    const auto measure_from = clock::now() + chrono::seconds{opts.warmup_sec};
+    const auto end = measure_from + chrono::seconds{opts.duration_sec};
+
+    vector<map<string_view, Samples>> results(opts.clients);
+    {
+        vector<jthread> threads;
+        for(size_t i = 0; i < opts.clients; ++i) {
+            threads.emplace_back([&, i] {
+                Client client{channel, i};
+                auto& samples = results[i];
+                for(size_t n = i; clock::now() < end; ++n) {
+                    const auto operation = operations[n % operations.size()];
+                    const auto start = clock::now();
+                    const bool ok = client.call(operation);
+                    if (start < measure_from) {
+                        continue;
+                    }
+                    auto& s = samples[operation];
+                    if (ok) {
+                        s.ms.push_back(chrono::duration<double, milli>(clock::now() - start).count());
+                    } else {
+                        ++s.failed;
+                    }
+                }
+            });
+        }
+    }
+
+    map<string_view, Samples> total;
+    for(auto& r : results) {
+        for(auto& [operation, s] : r) {
+            auto& t = total[operation];
+            t.ms.insert(t.ms.end(), s.ms.begin(), s.ms.end());
+            t.failed += s.failed;
+        }
+    }
+
+    bool ok = true;
+    uint64_t requests = 0;
+    cout << format("{:<16} {:>10} {:>8} {:>10} {:>10} {:>10} {:>10}\n",
+                   "operation", "count", "failed", "req/s", "p50 ms", "p99 ms", "max ms");
+    for(auto& [operation, s] : total) {
+        ranges::sort(s.ms);
+        const auto p99 = percentile(s.ms, 0.99);
+        requests += s.ms.size();
+        cout << format("{:<16} {:>10} {:>8} {:>10.1f} {:>10.2f} {:>10.2f} {:>10.2f}\n",
+                       operation, s.ms.size(), s.failed,
+                       static_cast<double>(s.ms.size()) / static_cast<double>(opts.duration_sec),
+                       percentile(s.ms, 0.5), p99, s.ms.empty() ? 0.0 : s.ms.back());
+
+        if (s.failed) {
+            cerr << operation << ": " << s.failed << " requests failed" << endl;
+            ok = false;
+        }
+        if (opts.max_p99_ms > 0 && p99 > opts.max_p99_ms) {
+            cerr << format("{}: p99 {:.2f} ms is over the limit of {:.2f} ms\n", operation, p99, opts.max_p99_ms);
+            ok = false;
+        }
+    }
+
+    const auto rps = static_cast<double>(requests) / static_cast<double>(opts.duration_sec);
+    cout << format("Total: {:.1f} req/s from {} clients\n", rps, opts.clients);
+    if (opts.min_rps > 0 && rps < opts.min_rps) {
+        cerr << format("The throughput {:.1f} req/s is under the limit of {:.1f} req/s\n", rps, opts.min_rps);
+        ok = false;
+    }
+
+    return ok;
+}
+
+} // anon ns
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    LogConfig log;
+    log.console_level = "warn";
+
+    namespace po = boost::program_options;
+    po::options_description general("Options");
+    general.add_options()
+        ("help,h", "Print help and exit")
+        ("log-to-console,C", po::value(&log.console_level)->default_value(log.console_level),
+         "Log-level to the console; one of 'info', 'debug', 'trace'. Empty string to disable.")
+        ("grpc-address", po::value(&opts.address)->default_value(opts.address),
+         "Local address and port for the gRPC service")
+        ("clients,c", po::value(&opts.clients)->default_value(opts.clients),
+         "Client threads. Each client sends one request at a time")
+        ("duration,d", po::value(&opts.duration_sec)->default_value(opts.duration_sec),
+         "Seconds to measure")
+        ("warmup", po::value(&opts.warmup_sec)->default_value(opts.warmup_sec),
+         "Seconds to send requests before the measurement starts")
+        ("io-threads", po::value(&opts.io_threads)->default_value(opts.io_threads),
+         "Threads for the server's IO")
+        ("nodes", po::value(&opts.nodes)->default_value(opts.nodes),
+         "Nodes in the tree returned by GetNodes")
+        ("db-latency-us", po::value(&opts.db_latency_us)->default_value(opts.db_latency_us),
+         "Latency injected for each database query, in microseconds")
+        ("db-jitter-us", po::value(&opts.db_jitter_us)->default_value(opts.db_jitter_us),
+         "Random extra latency for each database query, from 0 to this, in microseconds")
+        ("seed", po::value(&opts.seed)->default_value(opts.seed),
+         "Seed for the random latency")
+        ("max-p99-ms", po::value(&opts.max_p99_ms)->default_value(opts.max_p99_ms),
+         "Fail if the p99 latency for any operation is higher than this. 0 to disable")
+        ("min-rps", po::value(&opts.min_rps)->default_value(opts.min_rps),
+         "Fail if the total throughput is lower than this. 0 to disable")
+        ;
+
+    try {
+        po::variables_map vm;
+        po::store(po::command_line_parser(argc, argv).options(general).run(), vm);
+        po::notify(vm);
+        if (vm.count("help")) {
+            cout << general;
+            return 0;
+        }
+    } catch (const exception& ex) {
+        cerr << ex.what() << endl;
+        return -1;
+    }
+
+    Server::setupLogging(log);
+
+    Config config;
+    config.grpc.address = opts.address;
+    config.svr.io_threads = opts.io_threads;
+    config.svr.metrics_endpoint.clear();
+    config.trace.sample_rate = 0;
+    config.slow_query.threshold_ms = 0;
+
+    Server server{config};
+    server.useMemoryDb(makeDb(opts));
+    server.init();
+
+    jthread server_thread{[&server] {
+        server.run();
+    }};
+
+    const auto give_up = chrono::steady_clock::now() + 10s;
+    while(!server.ready()) {
+        if (server.is_done() || chrono::steady_clock::now() > give_up) {
+            cerr << "The server failed to start" << endl;
+            server.stop();
+            return 1;
+        }
+        this_thread::sleep_for(10ms);
+    }
+
+    const bool ok = runLoad(opts);
+
+    server.grpc().stop();
+    server.stop();
+    return ok ? 0 : 1;
+}
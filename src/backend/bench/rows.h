@@ -0,0 +1,82 @@
+#pragma once
+
+// Synthetic rows, shaped like the results of the queries in the gRPC handlers,
+// so the benchmarks don't need a database.
+
+#include <algorithm>
+#include <format>
+#include <string>
+#include <vector>
+
+#include <boost/mysql/date.hpp>
+#include <boost/mysql/field.hpp>
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+#include "grpc/shared_grpc_server.h"
+
+namespace nextapp::bench {
+
+using row_t = std::vector<boost::mysql::field>;
+
+// Rows like the ones GetNodes query, ordered by parent
+inline std::vector<row_t> makeNodeRows(size_t numNodes, size_t childrenPerNode) {
+    using grpc::ToNode;
+
+    boost::uuids::random_generator uuid_gen;
+    const auto user = boost::uuids::to_string(uuid_gen());
+
+    std::vector<std::string> ids;
+    ids.reserve(numNodes);
+    for(size_t i = 0; i < numNodes; ++i) {
+        ids.emplace_back(boost::uuids::to_string(uuid_gen()));
+    }
+
+    std::vector<row_t> rows;
+    rows.reserve(numNodes);
+    for(size_t i = 0; i < numNodes; ++i) {
+        boost::mysql::field parent;
+        if (i >= childrenPerNode) {
+            parent = boost::mysql::field{ids[(i / childrenPerNode) - 1]};
+        }
+
+        rows.push_back({
+            boost::mysql::field{ids[i]},
+            boost::mysql::field{user},
+            boost::mysql::field{std::format("Node number {}", i)},
+            boost::mysql::field{static_cast<int64_t>(pb::Node::Kind_MIN)},
+            boost::mysql::field{},
+            boost::mysql::field{int64_t{1}},
+            parent,
+            boost::mysql::field{int64_t{1}}
+        });
+    }
+
+    // Like "ORDER BY parent", so many children come before their parent
+    std::ranges::stable_sort(rows, [](const row_t& a, const row_t& b) {
+        if (a[ToNode::PARENT].is_null() || b[ToNode::PARENT].is_null()) {
+            return a[ToNode::PARENT].is_null() && !b[ToNode::PARENT].is_null();
+        }
+        return a[ToNode::PARENT].as_string() < b[ToNode::PARENT].as_string();
+    });
+
+    return rows;
+}
+
+// Rows like the ones GetMonth query
+inline std::vector<row_t> makeMonthRows() {
+    const std::string user = "dd2068f6-9cbb-11ee-bfc9-f78040cadf6b";
+    std::vector<row_t> rows;
+    for(uint8_t day = 1; day <= 31; ++day) {
+        rows.push_back({
+            boost::mysql::field{boost::mysql::date{2024, 1, day}},
+            boost::mysql::field{user},
+            boost::mysql::field{std::string{"green"}},
+            boost::mysql::field{int64_t{day % 2}},
+            boost::mysql::field{int64_t{1}}
+        });
+    }
+    return rows;
+}
+
+} // ns
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+namespace nextapp {
+
+/*! Decides if a request can be handled now.
+ *
+ *  There is a token bucket for each user and RPC method, and a global
+ *  cap on the number of requests in flight. Requests over the limits
+ *  should be rejected before they cost anything.
+ */
+class AdmissionControl {
+public:
+    struct Config {
+        // Requests per second for each user and method. 0 to disable.
+        double rate = 0;
+
+        // Requests a user can make in a burst for each method.
+        double burst = 0;
+
+        // Max number of requests in flight. 0 to disable.
+        size_t max_in_flight = 0;
+    };
+
+    // Holds a slot for a request in flight until it's destroyed
+    class Ticket {
+    public:
+        Ticket() = default;
+        explicit Ticket(std::atomic_size_t *inFlight) noexcept
+            : in_flight_{inFlight} {}
+
+        Ticket(const Ticket&) = delete;
+        Ticket& operator = (const Ticket&) = delete;
+
+        Ticket(Ticket&& v) noexcept
+            : in_flight_{std::exchange(v.in_flight_, nullptr)} {}
+
+        Ticket& operator = (Ticket&& v) noexcept {
+            release();
+            in_flight_ = std::exchange(v.in_flight_, nullptr);
+            return *this;
+        }
+
+        ~Ticket() {
+            release();
+        }
+
+    private:
+        void release() noexcept {
+            if (in_flight_) {
+                --*in_flight_;
+                in_flight_ = {};
+            }
+        }
+
+        std::atomic_size_t *in_flight_ = {};
+    };
+
+    AdmissionControl(const Config& config);
+
+    // Change the limits for the requests from now on
+    void setConfig(const Config& config) noexcept;
+
+    /*! Try to admit a request.
+     *
+     *  \return A ticket that must be kept until the request is done,
+     *      or nullopt if the request is over a limit. In that case,
+     *      `reason` is set.
+     */
+    std::optional<Ticket> admit(std::string_view user, std::string_view method, std::string& reason);
+
+    size_t inFlight() const noexcept {
+        return in_flight_;
+    }
+
+    size_t rejected() const noexcept {
+        return rejected_;
+    }
+
+private:
+    struct Bucket {
+        double tokens = 0;
+        std::chrono::steady_clock::time_point last;
+    };
+
+    // The buckets are split over a few maps to reduce lock contention
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Bucket> buckets;
+    };
+
+    static constexpr size_t num_shards = 16;
+    static constexpr size_t max_buckets_in_shard = 4096;
+
+    bool take(std::string_view user, std::string_view method, double rate);
+
+    std::atomic<double> rate_;
+    std::atomic<double> burst_;
+    std::atomic_size_t max_in_flight_;
+    std::array<Shard, num_shards> shards_;
+    std::atomic_size_t in_flight_{0};
+    std::atomic_size_t rejected_{0};
+};
+
+} // ns
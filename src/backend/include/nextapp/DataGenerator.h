@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/uuid/random_generator.hpp>
+#include "nextapp/Server.h"
+#include "nextapp/util.h"
+
+namespace nextapp::grpc {
+
+/*! Creates a large synthetic data set for performance tests.
+ *
+ *  Creates tenants whose users each have a tree of nodes with actions,
+ *  a color on most days, and work sessions on weekdays. The same
+ *  configuration and seed always give the same rows, including the uuid's.
+ *  The uuid's are UUIDv7 with the time from the generated dates, like the
+ *  ids the server would have created on those dates, or random UUIDv4 if
+ *  `uuid_version` is "v4". The load times, in rows per second, show what
+ *  the kind of id does to the inserts into the primary key indexes.
+ *
+ *  The rows are written with multi-row INSERT's. The foreign key and
+ *  unique checks are off and the secondary indexes on `action` are dropped
+ *  during the load, and the indexes are built again when it is done. The
+ *  derived tables (day statistics, streaks and time spent) are built from
+ *  the loaded rows for each tenant.
+ */
+class DataGenerator {
+public:
+    struct Counts {
+        size_t tenants = 0;
+        size_t users = 0;
+        size_t nodes = 0;
+        size_t actions = 0;
+        size_t days = 0;
+        size_t work = 0;
+
+        size_t total() const noexcept {
+            return tenants + users + nodes + actions + days + work;
+        }
+    };
+
+    DataGenerator(Server& server, const DataGenConfig& config);
+
+    boost::asio::awaitable<void> run();
+
+    const Counts& counts() const noexcept {
+        return counts_;
+    }
+
+    // Human readable summary of what was created
+    std::string summary() const;
+
+private:
+    boost::asio::awaitable<void> generateTenant(size_t tenantIx);
+    boost::asio::awaitable<void> generateUser(const std::string& tenant, size_t tenantIx, size_t userIx);
+    boost::asio::awaitable<void> prepare();
+    boost::asio::awaitable<void> restore();
+    boost::asio::awaitable<void> flushIfFull();
+    boost::asio::awaitable<void> flush();
+    void addActions(const std::string& node, const std::string& user);
+    void addDays(const std::string& user);
+    void addWork(const std::vector<std::string>& nodes);
+    std::string uuid(std::chrono::sys_time<std::chrono::milliseconds> when);
+    size_t random(size_t min, size_t max);
+    bool chance(double probability);
+
+    Server& server_;
+    const DataGenConfig config_;
+    std::chrono::sys_days end_date_;
+    std::chrono::sys_days first_date_;
+    std::mt19937_64 rng_;
+    boost::uuids::basic_random_generator<std::mt19937_64> random_uuid_{rng_};
+    bool time_ordered_ = true;
+    uint64_t last_ms_ = 0;
+    uint16_t seq_ = 0;
+    std::optional<Server::Db::Handle> handle_;
+    std::vector<std::string> colors_;
+    BulkInsert tenants_;
+    BulkInsert users_;
+    BulkInsert nodes_;
+    BulkInsert actions_;
+    BulkInsert days_;
+    BulkInsert work_;
+    Counts counts_;
+};
+
+} // ns
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <functional>
+#include <optional>
+#include <string_view>
+
+#include <boost/asio.hpp>
+
+#include "nextapp/logging.h"
+#include "nextapp/Metrics.h"
+#include "nextapp/Tracing.h"
+#include "nextapp/SlowQueryLog.h"
+#include "nextapp/DbResult.h"
+#include "nextapp/MemoryDb.h"
+#include "mysqlpool/mysqlpool.h"
+
+namespace nextapp {
+
+/*! Forwards to a database pool, or to the MemoryDb if one is in use.
+ *
+ *  Records the time spent in the metrics and the current trace, and
+ *  logs the queries that are slower than the slow-query threshold.
+ *  The same is done for the queries on a Handle.
+ */
+class Db {
+public:
+    using pool_t = jgaa::mysqlpool::Mysqlpool;
+
+    // Shared by all the queries. Owned by the Server.
+    struct Context {
+        Metrics::Histogram& query_time;
+        Metrics::Histogram& pool_wait;
+        SlowQueryLog& slow_query_log;
+        // A single connection for `KILL QUERY`, so a busy pool can't delay it
+        pool_t *control = {};
+    };
+
+    /*! A connection from the pool.
+     *
+     *  The thread id on the database server is only valid for as long as we
+     *  have the connection, as the pool may reconnect it between the uses.
+     */
+    struct Connection {
+        pool_t::Handle handle;
+        std::optional<uint64_t> id;
+    };
+
+    // A connection from the pool, or the MemoryDb.
+    class Handle {
+    public:
+        using pool_handle_t = pool_t::Handle;
+        using pool_trx_t = decltype(std::declval<pool_handle_t&>().transaction())::value_type;
+
+        // Rolls back if it is not committed. A no-op with the MemoryDb.
+        class Transaction {
+        public:
+            Transaction() = default;
+            explicit Transaction(pool_trx_t&& trx)
+                : trx_{std::move(trx)} {}
+
+            boost::asio::awaitable<void> commit() {
+                if (trx_) {
+                    co_await trx_->commit();
+                }
+            }
+
+        private:
+            std::optional<pool_trx_t> trx_;
+        };
+
+        Handle(Context& context, pool_handle_t&& handle)
+            : context_{&context}, conn_{Connection{std::move(handle)}} {}
+
+        Handle(Context& context, MemoryDb& memory) noexcept
+            : context_{&context}, memory_{&memory} {}
+
+        template <typename... T>
+        boost::asio::awaitable<DbResult> exec(std::string_view query, const T&... args) {
+            co_return co_await execOn(*context_, memory_, conn_ ? &*conn_ : nullptr, {}, query, args...);
+        }
+
+        boost::asio::awaitable<Transaction> transaction() {
+            if (!conn_) {
+                co_return Transaction{};
+            }
+            co_return Transaction{co_await conn_->handle.transaction()};
+        }
+
+    private:
+        Context *context_ = {};
+        std::optional<Connection> conn_;
+        MemoryDb *memory_ = {};
+    };
+
+    Db(pool_t& pool, Context& context) noexcept
+        : pool_{&pool}, context_{context} {}
+
+    Db(MemoryDb& memory, Context& context) noexcept
+        : memory_{&memory}, context_{context} {}
+
+    template <typename... T>
+    boost::asio::awaitable<DbResult> exec(std::string_view query, const T&... args) {
+        if (memory_) {
+            co_return co_await execOn(context_, memory_, nullptr, {}, query, args...);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        Connection conn{co_await [this]() -> boost::asio::awaitable<pool_t::Handle> {
+            Span span{"db.acquire"};
+            co_return co_await pool_->getConnection();
+        }()};
+        const auto poolWait = std::chrono::steady_clock::now() - start;
+        context_.pool_wait.observe(poolWait);
+
+        co_return co_await execOn(context_, nullptr, &conn, poolWait, query, args...);
+    }
+
+    // Time spent waiting for a connection is the pool wait time
+    boost::asio::awaitable<Handle> getConnection() {
+        if (memory_) {
+            co_return Handle{context_, *memory_};
+        }
+        Span span{"db.acquire"};
+        Metrics::ScopedTimer timer{context_.pool_wait};
+        co_return Handle{context_, co_await pool_->getConnection()};
+    }
+
+    boost::asio::awaitable<void> init() {
+        if (pool_) {
+            co_await pool_->init();
+        }
+    }
+
+    boost::asio::awaitable<void> close() {
+        if (pool_) {
+            co_await pool_->close();
+        }
+    }
+
+private:
+    using run_t = std::function<boost::asio::awaitable<boost::mysql::results>()>;
+
+    // Runs the query on `conn`, or on `memory` if `conn` is nullptr
+    template <typename... T>
+    static boost::asio::awaitable<DbResult> execOn(Context& context, MemoryDb *memory, Connection *conn,
+                                                   SlowQueryLog::duration_t poolWait,
+                                                   std::string_view query, const T&... args) {
+        Span span{"db.query", Trace::Kind::CLIENT};
+        span.attr("db.statement", query);
+
+        try {
+            if (!conn) {
+                Metrics::ScopedTimer timer{context.query_time};
+                co_return co_await memory->exec(query, MemoryDb::toFields(args...));
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            auto res = co_await execCancellable(context, *conn, [&]() {
+                return conn->handle.exec(query, args...);
+            });
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            context.query_time.observe(elapsed);
+
+            if (context.slow_query_log.isSlow(elapsed)) [[unlikely]] {
+                co_await logSlowQuery(context, conn->handle, query, elapsed, poolWait, args...);
+            }
+            co_return DbResult{std::move(res)};
+        } catch (const std::exception& ex) {
+            span.fail(ex.what());
+            throw;
+        }
+    }
+
+    /*! Runs a query for a request that may be cancelled while it waits.
+     *
+     *  Aborting the query itself would leave the connection in the middle of
+     *  the protocol, and it would go back to the pool like that. So the query
+     *  is shielded from the cancellation, and the database server is asked to
+     *  stop it with `KILL QUERY` over the control connection. The connection is
+     *  kept until the KILL is done, so that it can't stop the next query on it.
+     */
+    static boost::asio::awaitable<boost::mysql::results> execCancellable(Context& context, Connection& conn,
+                                                                          run_t run);
+
+    // The thread id for the connection on the database server
+    static boost::asio::awaitable<uint64_t> connectionId(Connection& conn);
+
+    static boost::asio::awaitable<void> killQuery(Context& context, uint64_t id);
+
+    template <typename... T>
+    static boost::asio::awaitable<void> logSlowQuery(Context& context, pool_t::Handle& handle,
+                                                     std::string_view query,
+                                                     SlowQueryLog::duration_t elapsed,
+                                                     SlowQueryLog::duration_t poolWait,
+                                                     const T&... args) {
+        auto& log = context.slow_query_log;
+        SlowQueryLog::Entry entry{query, {SlowQueryLog::redacted(args)...}, elapsed, poolWait};
+        if (const auto *trace = Trace::current()) {
+            entry.trace_id = trace->id();
+        }
+
+        if (log.shouldExplain(query)) {
+            try {
+                const auto res = co_await handle.exec(std::format("EXPLAIN FORMAT=JSON {}", query), args...);
+                if (!res.rows().empty() && res.rows().front().at(0).is_string()) {
+                    entry.explain.emplace(res.rows().front().at(0).as_string());
+                }
+            } catch (const std::exception& ex) {
+                LOG_DEBUG << "Failed to explain a slow query: " << ex.what();
+            }
+        }
+
+        log.write(entry);
+    }
+
+    pool_t *pool_ = {};
+    MemoryDb *memory_ = {};
+    Context& context_;
+};
+
+} // ns
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+#include <boost/mysql/field.hpp>
+#include <boost/mysql/field_view.hpp>
+#include <boost/mysql/results.hpp>
+
+namespace nextapp {
+
+// One row in a DbResult. Works like boost::mysql::row_view.
+class DbRow {
+public:
+    using value_type = boost::mysql::field_view;
+    using iterator = const boost::mysql::field_view *;
+
+    DbRow() = default;
+    DbRow(const boost::mysql::field_view *fields, size_t size) noexcept
+        : fields_{fields}, size_{size} {}
+
+    boost::mysql::field_view at(size_t column) const {
+        if (column >= size_) {
+            throw std::out_of_range{"DbRow::at: column out of range"};
+        }
+        return fields_[column];
+    }
+
+    boost::mysql::field_view operator[](size_t column) const noexcept {
+        assert(column < size_);
+        return fields_[column];
+    }
+
+    boost::mysql::field_view front() const noexcept {
+        assert(size_);
+        return fields_[0];
+    }
+
+    iterator begin() const noexcept { return fields_; }
+    iterator end() const noexcept { return fields_ + size_; }
+    size_t size() const noexcept { return size_; }
+    bool empty() const noexcept { return size_ == 0; }
+
+private:
+    const boost::mysql::field_view *fields_ = {};
+    size_t size_ = 0;
+};
+
+// The rows in a DbResult. Works like boost::mysql::rows_view.
+class DbRows {
+public:
+    class iterator {
+    public:
+        using value_type = DbRow;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        iterator(const boost::mysql::field_view *fields, size_t columns) noexcept
+            : fields_{fields}, columns_{columns} {}
+
+        DbRow operator*() const noexcept { return {fields_, columns_}; }
+        iterator& operator++() noexcept { fields_ += columns_; return *this; }
+        iterator operator++(int) noexcept { auto prev = *this; ++*this; return prev; }
+        bool operator==(const iterator& other) const noexcept { return fields_ == other.fields_; }
+
+    private:
+        const boost::mysql::field_view *fields_ = {};
+        size_t columns_ = 0;
+    };
+
+    using value_type = DbRow;
+
+    DbRows() = default;
+    DbRows(const boost::mysql::field_view *fields, size_t rows, size_t columns) noexcept
+        : fields_{fields}, rows_{rows}, columns_{columns} {}
+
+    DbRow at(size_t row) const {
+        if (row >= rows_) {
+            throw std::out_of_range{"DbRows::at: row out of range"};
+        }
+        return (*this)[row];
+    }
+
+    DbRow operator[](size_t row) const noexcept {
+        assert(row < rows_);
+        return {fields_ + row * columns_, columns_};
+    }
+
+    DbRow front() const noexcept {
+        return (*this)[0];
+    }
+
+    iterator begin() const noexcept { return {fields_, columns_}; }
+    iterator end() const noexcept { return {fields_ + rows_ * columns_, columns_}; }
+    size_t size() const noexcept { return rows_; }
+    bool empty() const noexcept { return rows_ == 0; }
+    size_t num_columns() const noexcept { return columns_; }
+
+private:
+    const boost::mysql::field_view *fields_ = {};
+    size_t rows_ = 0;
+    size_t columns_ = 0;
+};
+
+/*! The result from a query, from MariaDB or from the MemoryDb.
+ *
+ *  Has the part of the boost::mysql::results interface that the handlers
+ *  use. The rows from the database are not copied.
+ */
+class DbResult {
+public:
+    using rows_t = std::vector<std::vector<boost::mysql::field>>;
+
+    DbResult() = default;
+
+    DbResult(boost::mysql::results&& results)
+        : results_{std::move(results)} {}
+
+    // A result with the rows for one resultset
+    DbResult(const rows_t& rows, uint64_t affectedRows = 0, uint64_t lastInsertId = 0)
+        : memory_{true}, affected_rows_{affectedRows}, last_insert_id_{lastInsertId}
+    {
+        columns_ = rows.empty() ? 0 : rows.front().size();
+        fields_.reserve(rows.size() * columns_);
+        for(const auto& row : rows) {
+            if (row.size() != columns_) {
+                throw std::invalid_argument{"DbResult: all the rows must have the same number of columns"};
+            }
+            fields_.insert(fields_.end(), row.begin(), row.end());
+        }
+        views_.assign(fields_.begin(), fields_.end());
+    }
+
+    // The views point into the owned fields
+    DbResult(const DbResult&) = delete;
+    DbResult& operator=(const DbResult&) = delete;
+    DbResult(DbResult&&) = default;
+    DbResult& operator=(DbResult&&) = default;
+
+    bool has_value() const noexcept {
+        return memory_ || (results_ && results_->has_value());
+    }
+
+    // True if there are no resultsets, like boost::mysql::results::empty()
+    bool empty() const noexcept {
+        if (memory_) {
+            return false;
+        }
+        return !results_ || !results_->has_value() || results_->empty();
+    }
+
+    DbRows rows() const {
+        if (memory_) {
+            return {views_.data(), columns_ ? views_.size() / columns_ : 0, columns_};
+        }
+        assert(results_);
+        const auto rows = results_->rows();
+        if (rows.empty()) {
+            return {};
+        }
+        return {rows[0].begin(), rows.size(), rows[0].size()};
+    }
+
+    uint64_t affected_rows() const {
+        return memory_ ? affected_rows_ : results_.value().affected_rows();
+    }
+
+    uint64_t last_insert_id() const {
+        return memory_ ? last_insert_id_ : results_.value().last_insert_id();
+    }
+
+private:
+    std::optional<boost::mysql::results> results_;
+    bool memory_ = false;
+    std::vector<boost::mysql::field> fields_;
+    std::vector<boost::mysql::field_view> views_;
+    size_t columns_ = 0;
+    uint64_t affected_rows_ = 0;
+    uint64_t last_insert_id_ = 0;
+};
+
+} // ns
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <optional>
+
+#include <boost/asio.hpp>
+
+namespace nextapp {
+
+/*! Measures how long handlers wait in the queue of an io_context.
+ *
+ *  A timer on the context is re-armed every interval. The time from when
+ *  it should have fired until the handler actually runs is the queue lag.
+ */
+class LagProbe {
+public:
+    LagProbe(boost::asio::io_context& ctx, std::string name,
+             std::chrono::milliseconds warnAfter = std::chrono::milliseconds{200},
+             std::chrono::milliseconds interval = std::chrono::seconds{1});
+
+    void start();
+    void stop();
+
+    const std::string& name() const noexcept {
+        return name_;
+    }
+
+    // The lag for the last probe, in microseconds
+    uint64_t lastLagUs() const noexcept {
+        return last_lag_us_;
+    }
+
+    // The largest lag seen since the start, in microseconds
+    uint64_t maxLagUs() const noexcept {
+        return max_lag_us_;
+    }
+
+private:
+    void schedule();
+
+    boost::asio::steady_timer timer_;
+    const std::string name_;
+    const std::chrono::milliseconds warn_after_;
+    const std::chrono::milliseconds interval_;
+    std::atomic_uint64_t last_lag_us_{0};
+    std::atomic_uint64_t max_lag_us_{0};
+    std::atomic_bool stopped_{false};
+};
+
+/*! An io_context with its own threads.
+ *
+ *  Used to keep different kinds of work, like database I/O and CPU bound
+ *  protobuf building, from delaying each other.
+ */
+class ExecutorPool {
+public:
+    ExecutorPool(std::string name, size_t numThreads,
+                 std::chrono::milliseconds warnAfter = std::chrono::milliseconds{200});
+    ~ExecutorPool();
+
+    void start();
+    void stop();
+
+    auto& ctx() noexcept {
+        return ctx_;
+    }
+
+    const std::string& name() const noexcept {
+        return name_;
+    }
+
+    size_t threads() const noexcept {
+        return num_threads_;
+    }
+
+    const LagProbe& lag() const noexcept {
+        return probe_;
+    }
+
+private:
+    void run(size_t id);
+
+    const std::string name_;
+    const size_t num_threads_;
+    boost::asio::io_context ctx_;
+    std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work_;
+    LagProbe probe_;
+    std::vector<std::jthread> threads_;
+};
+
+} // ns
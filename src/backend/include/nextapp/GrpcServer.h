@@ -2,6 +2,9 @@
 
 #include <queue>
 #include <map>
+#include <optional>
+#include <source_location>
+#include <string_view>
 #include <boost/uuid/uuid.hpp>
 
 #include <grpcpp/grpcpp.h>
@@ -16,11 +19,18 @@
 #include "nextapp.grpc.pb.h"
 #include "nextapp/logging.h"
 #include "nextapp/errors.h"
+#include "nextapp/AdmissionControl.h"
 
 namespace nextapp::grpc {
 
 boost::uuids::uuid newUuid();
 
+// A UUIDv7 with the unix time in milliseconds, a 12 bit sequence and 62 random bits
+boost::uuids::uuid toUuidV7(uint64_t unixMs, uint16_t seq, uint64_t random) noexcept;
+
+// The name of the RPC method, from the source location in it's handler
+std::string_view methodName(const std::source_location& location) noexcept;
+
 class GrpcServer {
 public:
     template <typename T>
@@ -76,6 +86,55 @@ public:
         const boost::uuids::uuid uuid_ = newUuid();
     };
 
+    // Cancellation state for an unary request. Only used from the request's strand.
+    struct RequestState {
+        enum class Cancelled {
+            NO,
+            BY_CLIENT,
+            DEADLINE
+        };
+
+        RequestState(boost::asio::io_context& ctx)
+            : strand{boost::asio::make_strand(ctx)} {}
+
+        // Aborts whatever the request coroutine is waiting for. A database query is
+        // stopped with `KILL QUERY`, so its connection can go back to the pool (see Db).
+        void cancel(Cancelled why) {
+            if (cancelled == Cancelled::NO) {
+                cancelled = why;
+                signal.emit(boost::asio::cancellation_type::terminal);
+            }
+        }
+
+        boost::asio::strand<boost::asio::io_context::executor_type> strand;
+        boost::asio::cancellation_signal signal;
+        Cancelled cancelled = Cancelled::NO;
+    };
+
+    // Reactor for unary requests that forward the clients cancellation to the request coroutine
+    class UnaryReactor : public ::grpc::ServerUnaryReactor {
+    public:
+        UnaryReactor(boost::asio::io_context& ctx)
+            : state_{std::make_shared<RequestState>(ctx)} {}
+
+        void OnCancel() override {
+            boost::asio::post(state_->strand, [state=state_] {
+                state->cancel(RequestState::Cancelled::BY_CLIENT);
+            });
+        }
+
+        void OnDone() override {
+            delete this;
+        }
+
+        const auto& state() const noexcept {
+            return state_;
+        }
+
+    private:
+        std::shared_ptr<RequestState> state_;
+    };
+
     /*! RPC implementation
      *
      *  This class overrides our RPC methods from the code
@@ -94,50 +153,160 @@ public:
         ::grpc::ServerUnaryReactor *SetDay(::grpc::CallbackServerContext *ctx, const pb::CompleteDay *req, pb::Status *reply) override;
         ::grpc::ServerWriteReactor<::nextapp::pb::Update>* SubscribeToUpdates(::grpc::CallbackServerContext* context, const ::nextapp::pb::UpdatesReq* request) override;
         ::grpc::ServerUnaryReactor *CreateTenant(::grpc::CallbackServerContext *ctx, const pb::CreateTenantReq *req, pb::Status *reply) override;
+        ::grpc::ServerUnaryReactor *CreateUsers(::grpc::CallbackServerContext *ctx, const pb::CreateUsersReq *req, pb::Status *reply) override;
         ::grpc::ServerUnaryReactor *CreateNode(::grpc::CallbackServerContext *ctx, const pb::CreateNodeReq *req, pb::Status *reply) override;
         ::grpc::ServerUnaryReactor *UpdateNode(::grpc::CallbackServerContext *ctx, const pb::Node*req, pb::Status *reply) override;
         ::grpc::ServerUnaryReactor *MoveNode(::grpc::CallbackServerContext *ctx, const pb::MoveNodeReq*req, pb::Status *reply) override;
         ::grpc::ServerUnaryReactor *DeleteNode(::grpc::CallbackServerContext *ctx, const pb::DeleteNodeReq*req, pb::Status *reply) override;
         ::grpc::ServerUnaryReactor *GetNodes(::grpc::CallbackServerContext *ctx, const pb::GetNodesReq *req, pb::NodeTree *reply) override;
+        ::grpc::ServerUnaryReactor *GetChildren(::grpc::CallbackServerContext *ctx, const pb::GetChildrenReq *req, pb::NodeTree *reply) override;
+        ::grpc::ServerUnaryReactor *GetTimeSpent(::grpc::CallbackServerContext *ctx, const pb::TimeSpentReq *req, pb::TimeSpentSummary *reply) override;
+        ::grpc::ServerUnaryReactor *GetDayStats(::grpc::CallbackServerContext *ctx, const pb::DayStatsReq *req, pb::DayStats *reply) override;
+        ::grpc::ServerWriteReactor<pb::ExportRecord> *ExportTenant(::grpc::CallbackServerContext *ctx, const pb::ExportTenantReq *req) override;
+        ::grpc::ServerReadReactor<pb::ExportRecord> *ImportTenant(::grpc::CallbackServerContext *ctx, pb::Status *reply) override;
 
     private:
         // Boilerplate code to run async SQL queries or other async coroutines from an unary gRPC callback
-        auto unaryHandler(::grpc::CallbackServerContext *ctx, const auto * req, auto *reply, auto fn) noexcept {
+        auto unaryHandler(::grpc::CallbackServerContext *ctx, const auto * req, auto *reply, auto fn,
+                          const std::source_location location = std::source_location::current()) noexcept {
             assert(ctx);
             assert(reply);
 
-            auto* reactor = ctx->DefaultReactor();
-
-            boost::asio::co_spawn(owner_.server().ctx(), [this, ctx, req, reply, reactor, fn]() -> boost::asio::awaitable<void> {
+            const auto arrived = TrafficRecorder::clock_t::now();
+            auto& rpc = owner_.rpcMetrics(methodName(location));
+            rpc.requests.inc();
+
+            // The service listens while the server starts up, so clients get a proper error
+            if (!owner_.server().ready()) {
+                rpc.rejected.inc();
+                const ::grpc::Status status{::grpc::StatusCode::UNAVAILABLE, "The server is starting up"};
+                record(ctx, methodName(location), arrived, status, *req, 0);
+                auto* reactor = ctx->DefaultReactor();
+                reactor->Finish(status);
+                return static_cast<::grpc::ServerUnaryReactor *>(reactor);
+            }
+
+            // Reject the request before it use any resources if it's over the limits
+            std::string reason;
+            auto ticket = owner_.admission().admit(owner_.currentUser(ctx), methodName(location), reason);
+            if (!ticket) {
+                LOG_DEBUG_N << "Rejecting request: " << reason;
+                rpc.rejected.inc();
+                const ::grpc::Status status{::grpc::StatusCode::RESOURCE_EXHAUSTED, reason};
+                record(ctx, methodName(location), arrived, status, *req, 0);
+                auto* reactor = ctx->DefaultReactor();
+                reactor->Finish(status);
+                return static_cast<::grpc::ServerUnaryReactor *>(reactor);
+            }
+
+            auto* reactor = new UnaryReactor{owner_.server().requestCtx()};
+            auto state = reactor->state();
+
+            auto trace = owner_.server().tracer().startTrace(methodName(location));
+            if (trace) {
+                LOG_DEBUG_N << "Tracing " << methodName(location) << " as trace " << trace->id();
+            }
+
+            auto coro = [this, ctx, req, reply, reactor, fn, state, trace, arrived, method=methodName(location), rpc=&rpc, ticket=std::move(*ticket)]() -> boost::asio::awaitable<void> {
+
+                    Metrics::ScopedTimer timer{rpc->duration};
+
+                    // Abort the request if the client's deadline pass before we are done
+                    std::optional<boost::asio::steady_timer> deadline_timer;
+                    if (const auto timeout = ctx->deadline() - std::chrono::system_clock::now();
+                        timeout < std::chrono::hours{24 * 365}) {
+                        deadline_timer.emplace(state->strand, std::chrono::duration_cast<std::chrono::steady_clock::duration>(timeout));
+                        deadline_timer->async_wait([state](const boost::system::error_code& ec) {
+                            if (!ec) {
+                                state->cancel(RequestState::Cancelled::DEADLINE);
+                            }
+                        });
+                    }
 
+                    // The reply is sent when the request is recorded, below
+                    ::grpc::Status status;
                     try {
                         co_await fn(reply);
-                        reactor->Finish(::grpc::Status::OK);
+                        status = ::grpc::Status::OK;
+                        if (trace) {
+                            trace->finish(true);
+                        }
                     } catch (const db_err& ex) {
+                        rpc->failed.inc();
+                        if (trace) {
+                            trace->finish(false, ex.what());
+                        }
                         if constexpr (std::is_same_v<pb::Status *, decltype(reply)>) {
                             reply->Clear();
                             reply->set_error(ex.error());
                             reply->set_message(ex.what());
-                            reactor->Finish(::grpc::Status::OK);
+                            status = ::grpc::Status::OK;
                         } else {
                             LOG_WARN_N << "Caught db_err exception while handling grpc request coro: " << ex.what();
-                            reactor->Finish(::grpc::Status::CANCELLED);
+                            status = ::grpc::Status::CANCELLED;
                         }
                     } catch (const std::exception& ex) {
-                        LOG_WARN_N << "Caught exception while handling grpc request coro: " << ex.what();
-                        reactor->Finish(::grpc::Status::CANCELLED);
+                        rpc->failed.inc();
+                        if (trace) {
+                            trace->finish(false, ex.what());
+                        }
+                        if (state->cancelled == RequestState::Cancelled::DEADLINE) {
+                            LOG_DEBUG_N << "The request passed it's deadline: " << ex.what();
+                            status = {::grpc::StatusCode::DEADLINE_EXCEEDED, "Deadline exceeded"};
+                        } else if (state->cancelled == RequestState::Cancelled::BY_CLIENT) {
+                            LOG_DEBUG_N << "The request was cancelled by the client: " << ex.what();
+                            status = ::grpc::Status::CANCELLED;
+                        } else {
+                            LOG_WARN_N << "Caught exception while handling grpc request coro: " << ex.what();
+                            status = ::grpc::Status::CANCELLED;
+                        }
                     }
 
+                    if (deadline_timer) {
+                        deadline_timer->cancel();
+                    }
+
+                    // `req` and `reply` are released by gRPC when the request is finished
+                    record(ctx, method, arrived, status, *req, reply->ByteSizeLong());
+                    reactor->Finish(status);
+
                     LOG_TRACE_N << "Exiting unary handler.";
 
-                }, boost::asio::detached);
+                };
+
+            // Sampled requests run on an executor that makes the trace current, so the
+            // spans for the database queries etc. find it.
+            if (trace) {
+                boost::asio::co_spawn(TracedExecutor{state->strand, trace}, std::move(coro),
+                                      boost::asio::bind_cancellation_slot(state->signal.slot(), boost::asio::detached));
+            } else {
+                boost::asio::co_spawn(state->strand, std::move(coro),
+                                      boost::asio::bind_cancellation_slot(state->signal.slot(), boost::asio::detached));
+            }
+
+            return static_cast<::grpc::ServerUnaryReactor *>(reactor);
+        }
 
-            return reactor;
+        void record(::grpc::CallbackServerContext *ctx, std::string_view method,
+                    TrafficRecorder::clock_t::time_point arrived, const ::grpc::Status& status,
+                    const ::google::protobuf::Message& req, size_t replySize) {
+            if (auto& recorder = owner_.server().recorder(); recorder.enabled()) {
+                recorder.record(method, owner_.currentUser(ctx), arrived, TrafficRecorder::clock_t::now() - arrived,
+                                status.error_code(), req, replySize);
+            }
         }
 
         GrpcServer& owner_;
     };
 
+    // Metrics for one RPC method
+    struct RpcMetrics {
+        Metrics::Counter& requests;
+        Metrics::Counter& failed;
+        Metrics::Counter& rejected;
+        Metrics::Histogram& duration;
+    };
+
     GrpcServer(Server& server);
 
     Server& server() {
@@ -148,20 +317,67 @@ public:
 
     void stop();
 
+    // Status reported by the gRPC health-checking service
+    void setServing(bool serving);
+
     const GrpcConfig& config() const noexcept {
         return server_.config().grpc;
     }
 
+    AdmissionControl& admission() noexcept {
+        return admission_;
+    }
+
+    // Metrics for a method, like "GetDay". Unknown names share the "other" metrics.
+    RpcMetrics& rpcMetrics(std::string_view method) noexcept {
+        if (auto it = rpc_metrics_.find(method); it != rpc_metrics_.end()) {
+            return it->second;
+        }
+        return rpc_metrics_.at("other");
+    }
+
     void addPublisher(const std::shared_ptr<Publisher>& publisher);
     void removePublisher(const boost::uuids::uuid& uuid);
     void publish(const std::shared_ptr<pb::Update>& update);
     boost::asio::awaitable<void> validateParent(const std::string& parentUuid, const std::string& userUuid);
+
+    // Throws if the user is not an active super-user in the super tenant
+    boost::asio::awaitable<void> validateAdmin(const std::string& userUuid);
     boost::asio::awaitable<nextapp::pb::Node> fetcNode(const std::string& uuid, const std::string& userUuid);
 
+    // Inserts the users in multi-row batches. Returns the number of users.
+    boost::asio::awaitable<size_t> insertUsers(Server::Db::Handle& handle,
+                                               const std::string& tenantUuid,
+                                               const google::protobuf::RepeatedPtrField<pb::User>& templates);
+
+    // The color for a day, and the score it added to the statistics
+    struct DayColor {
+        std::string color;
+        int64_t score{};
+    };
+
+    // Locks the users day statistics for the transaction and returns the current color for the day
+    boost::asio::awaitable<std::optional<DayColor>> fetchDayColorForUpdate(Server::Db::Handle& handle,
+                                                                              const std::string& userUuid,
+                                                                              const pb::Date& date);
+
+    // Updates the day statistics after the color for a day changed from `previous` to `current`
+    boost::asio::awaitable<void> updateDayStats(Server::Db::Handle& handle,
+                                                const std::string& userUuid,
+                                                const pb::Date& date,
+                                                const std::optional<DayColor>& previous,
+                                                const std::optional<std::string>& current);
+
 private:
 
     // TODO: Implement auth
-    std::string currentUser(::grpc::CallbackServerContext */*ctx*/) const {
+    std::string currentUser(::grpc::CallbackServerContext *ctx) const {
+        if (ctx && server_.config().grpc.user_from_metadata) {
+            const auto& metadata = ctx->client_metadata();
+            if (auto it = metadata.find("nextapp-user"); it != metadata.end()) {
+                return {it->second.data(), it->second.size()};
+            }
+        }
         return "dd2068f6-9cbb-11ee-bfc9-f78040cadf6b";
     }
 
@@ -185,6 +401,12 @@ private:
     // A gRPC server object
     std::unique_ptr<::grpc::Server> grpc_server_;
 
+    AdmissionControl admission_;
+
+    // Populated in the constructor for all the methods in the service, and read-only after that
+    std::map<std::string, RpcMetrics, std::less<>> rpc_metrics_;
+    Metrics::Histogram& publish_time_;
+
     std::map<boost::uuids::uuid, std::weak_ptr<Publisher>> publishers_;
     std::mutex mutex_;
 };
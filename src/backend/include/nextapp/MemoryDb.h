@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/mysql/date.hpp>
+#include <boost/mysql/field.hpp>
+
+#include "nextapp/DbResult.h"
+#include "nextapp/util.h"
+
+namespace nextapp {
+
+/*! In-process stand-in for the database.
+ *
+ *  Used by the end-to-end benchmarks and tests, so the gRPC handlers can be
+ *  exercised without MariaDB, with a latency that is the same on every run.
+ *
+ *  It does not understand SQL. The replies are registered in advance for the
+ *  statements that start with a prefix. Statements without a reply get an
+ *  empty result with one affected row.
+ */
+class MemoryDb {
+public:
+    using args_t = std::span<const boost::mysql::field>;
+    using reply_fn_t = std::function<DbResult(std::string_view query, args_t args)>;
+
+    struct Latency {
+        // Injected for each statement
+        std::chrono::microseconds fixed{0};
+        // A random extra delay from 0 to `jitter`
+        std::chrono::microseconds jitter{0};
+        // For the jitter, so the runs are repeatable
+        uint64_t seed = 1;
+    };
+
+    MemoryDb() = default;
+    explicit MemoryDb(const Latency& latency)
+        : latency_{latency} {}
+
+    // Register the replies before the server starts. If more than one
+    // prefix match, the last one registered is used.
+
+    // Rows for the statements that start with `prefix`.
+    void on(std::string_view prefix, DbResult::rows_t rows);
+
+    // Computes the reply from the statement and its arguments.
+    void on(std::string_view prefix, reply_fn_t fn);
+
+    // Waits for the injected latency, and returns the reply for the statement.
+    boost::asio::awaitable<DbResult> exec(std::string_view query, std::vector<boost::mysql::field> args);
+
+    // Statements executed so far
+    uint64_t count() const noexcept {
+        return count_;
+    }
+
+    // Statements executed so far that had no registered reply
+    uint64_t unmatched() const noexcept {
+        return unmatched_;
+    }
+
+    template <typename T>
+    static boost::mysql::field toField(const T& value) {
+        return toDbField(value);
+    }
+
+    template <typename... T>
+    static std::vector<boost::mysql::field> toFields(const T&... args) {
+        std::vector<boost::mysql::field> fields;
+        fields.reserve(sizeof...(args));
+        (fields.emplace_back(toField(args)), ...);
+        return fields;
+    }
+
+    // The arguments for a BulkInsert::Batch
+    static std::vector<boost::mysql::field> toFields(const std::vector<boost::mysql::field_view>& args) {
+        return {args.begin(), args.end()};
+    }
+
+private:
+    struct Rule {
+        std::string prefix;
+        reply_fn_t fn;
+    };
+
+    std::chrono::microseconds nextDelay();
+
+    const Latency latency_;
+    std::mutex mutex_;
+    std::mt19937_64 rng_{latency_.seed};
+    std::vector<Rule> rules_;
+    std::atomic_uint64_t count_{0};
+    std::atomic_uint64_t unmatched_{0};
+};
+
+} // ns
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace nextapp {
+
+/*! Metrics in the Prometheus text format.
+ *
+ *  The metrics are registered at startup, and the references returned
+ *  are valid for the lifetime of the Metrics instance. Updating a metric
+ *  is lock-free. Counters and histograms are split over cache-line
+ *  aligned slots, and each thread updates its own slot.
+ */
+class Metrics {
+public:
+    static constexpr size_t num_slots = 16;
+
+    class Counter {
+    public:
+        void inc(uint64_t value = 1) noexcept {
+            slots_[threadSlot()].value.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        uint64_t value() const noexcept;
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic_uint64_t value{0};
+        };
+
+        std::array<Slot, num_slots> slots_;
+    };
+
+    class Gauge {
+    public:
+        void set(int64_t value) noexcept {
+            value_.store(value, std::memory_order_relaxed);
+        }
+
+        void add(int64_t value) noexcept {
+            value_.fetch_add(value, std::memory_order_relaxed);
+        }
+
+        int64_t value() const noexcept {
+            return value_.load(std::memory_order_relaxed);
+        }
+
+    private:
+        std::atomic_int64_t value_{0};
+    };
+
+    /*! Latency histogram with HDR style buckets.
+     *
+     *  The buckets are log-linear; each power of two from 16 microseconds
+     *  to about one minute is split in two.
+     */
+    class Histogram {
+    public:
+        static constexpr unsigned min_bits = 4; // 16 microseconds
+        static constexpr unsigned octaves = 22;
+        static constexpr unsigned sub_buckets = 2;
+        static constexpr size_t num_buckets = 1 + (octaves * sub_buckets) + 1; // Includes +Inf
+
+        void observe(std::chrono::steady_clock::duration duration) noexcept {
+            observeUs(static_cast<uint64_t>(std::max<int64_t>(0,
+                std::chrono::duration_cast<std::chrono::microseconds>(duration).count())));
+        }
+
+        void observeUs(uint64_t us) noexcept;
+
+        // Inclusive upper bound for a bucket, in microseconds
+        static uint64_t upperBoundUs(size_t bucket) noexcept;
+
+        struct Snapshot {
+            std::array<uint64_t, num_buckets> buckets{};
+            uint64_t count = 0;
+            uint64_t sum_us = 0;
+        };
+
+        Snapshot snapshot() const noexcept;
+
+    private:
+        static size_t bucketFor(uint64_t us) noexcept;
+
+        struct alignas(64) Slot {
+            std::array<std::atomic_uint64_t, num_buckets> buckets{};
+            std::atomic_uint64_t count{0};
+            std::atomic_uint64_t sum_us{0};
+        };
+
+        std::array<Slot, num_slots / 2> slots_;
+    };
+
+    // Records the time from construction until destruction in a histogram
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram) noexcept
+            : histogram_{histogram} {}
+
+        ~ScopedTimer() {
+            histogram_.observe(std::chrono::steady_clock::now() - start_);
+        }
+
+    private:
+        Histogram& histogram_;
+        const std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+    };
+
+    /*! Register metrics
+     *
+     *  \param name Prometheus metric name, like `nextapp_grpc_requests_total`
+     *  \param help Description of the metric
+     *  \param labels Labels for this instance, like `method="GetDay"`
+     */
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = {});
+    Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = {});
+    Histogram& histogram(const std::string& name, const std::string& help, const std::string& labels = {});
+
+    // A gauge that is read by calling `fn` when the metrics are collected
+    void gauge(const std::string& name, const std::string& help, std::function<double()> fn,
+               const std::string& labels = {});
+
+    // All the metrics in the Prometheus text exposition format
+    std::string render() const;
+
+private:
+    static size_t threadSlot() noexcept;
+
+    enum class Type {
+        COUNTER,
+        GAUGE,
+        HISTOGRAM
+    };
+
+    struct Entry {
+        std::string labels;
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        std::function<double()> fn;
+    };
+
+    struct Family {
+        std::string help;
+        Type type;
+        std::deque<Entry> entries;
+    };
+
+    Entry& add(const std::string& name, const std::string& help, Type type, const std::string& labels);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
+
+/*! Serves the metrics over HTTP, on `GET /metrics`
+ *
+ *  This is a minimal HTTP/1.1 server for a Prometheus scraper on a local
+ *  port. It is not meant to be exposed to the internet.
+ */
+class MetricsHttpServer {
+public:
+    MetricsHttpServer(boost::asio::io_context& ctx, const Metrics& metrics);
+
+    // Starts listening on an endpoint like "127.0.0.1:9012"
+    void start(const std::string& endpoint);
+    void stop();
+
+private:
+    boost::asio::awaitable<void> accept();
+    boost::asio::awaitable<void> handle(boost::asio::ip::tcp::socket socket);
+
+    boost::asio::io_context& ctx_;
+    const Metrics& metrics_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+};
+
+} // ns
@@ -1,14 +1,25 @@
 #pragma once
 
 #include <thread>
+#include <functional>
 #include <optional>
 #include <atomic>
+#include <memory>
+#include <vector>
 
 #include <boost/asio.hpp>
 
 #include "nextapp/nextapp.h"
 #include "nextapp/config.h"
 #include "nextapp/util.h"
+#include "nextapp/logging.h"
+#include "nextapp/ExecutorPool.h"
+#include "nextapp/Metrics.h"
+#include "nextapp/Tracing.h"
+#include "nextapp/SlowQueryLog.h"
+#include "nextapp/TrafficRecorder.h"
+#include "nextapp/Db.h"
+#include "nextapp/MemoryDb.h"
 #include "mysqlpool/mysqlpool.h"
 
 namespace nextapp {
@@ -19,12 +30,18 @@ class GrpcServer;
 
 class Server {
 public:
-    static constexpr uint latest_version = 3;
+    static constexpr uint latest_version = 7;
+
+    // Reads the configuration again. Throws if it is not valid.
+    using config_loader_t = std::function<Config()>;
 
     struct BootstrapOptions {
         bool drop_old_db = false;
         std::string db_root_user = getEnv("NA_ROOT_DBUSER", "root");
         std::string db_root_passwd = getEnv("NA_ROOT_DBPASSWD");
+        // Fill the new database with synthetic data
+        bool generate_data = false;
+        DataGenConfig data;
     };
 
     Server(const Config& config);
@@ -38,45 +55,187 @@ public:
 
     void bootstrap(const BootstrapOptions& opts);
 
+    // Writes all the data for a tenant to a file with length-delimited ExportRecord messages
+    void exportTenant(const std::string& tenant, const std::string& path);
+
+    // Imports a file created by exportTenant()
+    void importTenant(const std::string& path);
+
     const auto& config() const noexcept {
         return config_;
     }
 
+    // Used to reload the configuration on SIGHUP
+    void setConfigLoader(config_loader_t loader) {
+        config_loader_ = std::move(loader);
+    }
+
+    // Loads the configuration again and applies the settings that can be changed
+    // while the server runs. Changes to the other settings are logged and ignored.
+    void reloadConfig();
+
+    // Replaces the log handlers
+    static void setupLogging(const LogConfig& config);
+
     auto& ctx() noexcept {
         return ctx_;
     }
 
-    auto& db() noexcept {
+    // Context for the database connections
+    boost::asio::io_context& dbCtx() noexcept {
+        return db_pool_ ? db_pool_->ctx() : ctx_;
+    }
+
+    // Context for CPU bound work, so that it don't delay I/O
+    boost::asio::io_context& cpuCtx() noexcept {
+        return cpu_pool_ ? cpu_pool_->ctx() : ctx_;
+    }
+
+    // Runs `fn` on the CPU context and resumes the caller with the result
+    template <typename FnT>
+    auto onCpu(FnT fn) {
+        using result_t = std::invoke_result_t<FnT>;
+        return boost::asio::co_spawn(cpuCtx(), [fn=std::move(fn)]() mutable -> boost::asio::awaitable<result_t> {
+            co_return fn();
+        }, boost::asio::use_awaitable);
+    }
+
+    // Queue-lag probes for the executors that are in use
+    std::vector<const LagProbe *> lagProbes() const;
+
+    /*! Context to run a new request on.
+     *
+     *  With thread_per_core, the requests are spread round-robin over the
+     *  shards, and a request stays on its shard until it is done.
+     */
+    boost::asio::io_context& requestCtx() noexcept;
+
+    using Db = nextapp::Db;
+
+    // The database pool for the calling thread. Each shard has its own pool.
+    Db db() noexcept {
+        if (memory_db_) {
+            return {*memory_db_, db_context_};
+        }
+        if (current_shard_ && current_shard_->db) {
+            return {*current_shard_->db, db_context_};
+        }
         assert(db_.has_value());
-        return *db_;
+        return {*db_, db_context_};
+    }
+
+    // Use `db` instead of MariaDB. Must be called before init().
+    void useMemoryDb(std::shared_ptr<MemoryDb> db) {
+        memory_db_ = std::move(db);
+    }
+
+    Metrics& metrics() noexcept {
+        return metrics_;
+    }
+
+    Tracer& tracer() noexcept {
+        return tracer_;
+    }
+
+    TrafficRecorder& recorder() noexcept {
+        return recorder_;
+    }
+
+    size_t shards() const noexcept {
+        return shards_.size();
+    }
+
+    // The shard for the calling thread, if it is a shard thread
+    static std::optional<size_t> currentShard() noexcept {
+        if (current_shard_) {
+            return current_shard_->id;
+        }
+        return {};
+    }
+
+    // Run `fn` on the given shard. Without shards, it is posted to the shared context.
+    template <typename FnT>
+    void post(size_t shard, FnT&& fn) {
+        if (shards_.empty()) {
+            boost::asio::post(ctx_, std::forward<FnT>(fn));
+            return;
+        }
+        assert(shard < shards_.size());
+        boost::asio::post(shards_[shard]->ctx, std::forward<FnT>(fn));
     }
 
     bool is_done() const noexcept {
         return done_;
     }
 
+    // True when the startup is complete and the server can handle requests
+    bool ready() const noexcept {
+        return ready_;
+    }
+
     auto& grpc() noexcept {
         assert(grpc_service_);
         return *grpc_service_;
     }
 
 private:
+    struct Shard {
+        Shard(size_t id)
+            : id{id} {}
+
+        const size_t id;
+        boost::asio::io_context ctx{1};
+        std::optional<jgaa::mysqlpool::Mysqlpool> db;
+        std::jthread thread;
+    };
+
     void handleSignals();
     void initCtx(size_t numThreads);
+    void initShards(size_t numShards);
+    boost::asio::awaitable<void> initShardDbs();
+    void runShard(Shard& shard);
     void runIoThread(size_t id);
+    // Checks or upgrades the schema, on a connection of its own
     boost::asio::awaitable<bool> checkDb();
+    // Initializes the main database pool while the schema is checked
+    boost::asio::awaitable<bool> prepareDb();
+    boost::asio::awaitable<void> initDbControl();
     boost::asio::awaitable<void> createDb(const BootstrapOptions& opts);
     boost::asio::awaitable<void> upgradeDbTables(uint version);
     boost::asio::awaitable<void> startGrpcService();
-
+    void startMetricsService();
+
+    Metrics metrics_;
+    Metrics::Histogram& db_query_time_;
+    Metrics::Histogram& db_pool_wait_;
+    // Must outlive grpc_service_, as the requests submit their traces when they are done
+    Tracer tracer_;
+    SlowQueryLog slow_query_log_;
+    Db::Context db_context_;
+    TrafficRecorder recorder_;
     boost::asio::io_context ctx_;
+    // Must outlive db_, that use its context
+    std::optional<ExecutorPool> db_pool_;
+    std::optional<ExecutorPool> cpu_pool_;
+    std::optional<LagProbe> io_lag_;
     std::optional<boost::asio::signal_set> signals_;
     std::vector <std::jthread> io_threads_;
     std::optional<jgaa::mysqlpool::Mysqlpool> db_;
+    // A single connection for `KILL QUERY`, so a busy pool can't delay it
+    std::optional<jgaa::mysqlpool::Mysqlpool> db_control_;
+    std::shared_ptr<MemoryDb> memory_db_;
     Config config_;
+    // The settings in use after SIGHUP. Only used by the signal handler.
+    Config active_config_;
+    config_loader_t config_loader_;
     std::atomic_size_t running_io_threads_{0};
     std::atomic_bool done_{false};
+    std::atomic_bool ready_{false};
     std::shared_ptr<grpc::GrpcServer> grpc_service_;
+    std::optional<MetricsHttpServer> metrics_service_;
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::atomic_size_t next_shard_{0};
+    static thread_local Shard *current_shard_;
 };
 
 } // ns
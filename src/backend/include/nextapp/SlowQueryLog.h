@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <format>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_set>
+#include <vector>
+
+#include "nextapp/config.h"
+
+namespace nextapp {
+
+/*! Log for database queries that are slower than a threshold.
+ *
+ *  Each entry is one line of JSON with the SQL, the redacted parameters, the
+ *  duration and the time spent waiting for a connection. The first time a
+ *  statement is slow, the entry also has the output from `EXPLAIN FORMAT=JSON`.
+ *
+ *  The log is written to a file that is rotated by size, or to the
+ *  application log if no file is configured.
+ */
+class SlowQueryLog {
+public:
+    using duration_t = std::chrono::steady_clock::duration;
+
+    struct Entry {
+        std::string_view query;
+        std::vector<std::string> params;
+        duration_t duration{};
+        duration_t pool_wait{};
+        std::string trace_id;
+        std::optional<std::string> explain;
+    };
+
+    explicit SlowQueryLog(const SlowQueryConfig& config);
+
+    void open();
+
+    [[nodiscard]] bool isSlow(duration_t duration) const noexcept {
+        const std::chrono::milliseconds threshold{threshold_ms_.load(std::memory_order_relaxed)};
+        return threshold.count() > 0 && duration >= threshold;
+    }
+
+    // Change the threshold from now on. 0 to disable.
+    void setThreshold(std::chrono::milliseconds threshold) noexcept {
+        threshold_ms_ = threshold.count();
+    }
+
+    // True the first time a statement is slow, when its plan should be captured
+    [[nodiscard]] bool shouldExplain(std::string_view query);
+
+    void write(const Entry& entry);
+
+    uint64_t count() const noexcept {
+        return count_;
+    }
+
+    // The type and size of a query parameter, without the value
+    template <typename T>
+    static std::string redacted(const T& value) {
+        using V = std::remove_cvref_t<T>;
+        if constexpr (std::is_same_v<V, std::nullopt_t> || std::is_same_v<V, std::nullptr_t>) {
+            return "NULL";
+        } else if constexpr (requires { value.has_value(); *value; }) {
+            return value ? redacted(*value) : "NULL";
+        } else if constexpr (std::is_same_v<V, bool>) {
+            return "bool";
+        } else if constexpr (std::is_arithmetic_v<V>) {
+            return "number";
+        } else if constexpr (std::is_convertible_v<const V&, std::string_view>) {
+            return std::format("string({})", std::string_view{value}.size());
+        } else {
+            return "value";
+        }
+    }
+
+private:
+    void rotate();
+
+    const SlowQueryConfig config_;
+    std::atomic<std::chrono::milliseconds::rep> threshold_ms_;
+    std::mutex mutex_;
+    std::unordered_set<size_t> explained_;
+    std::ofstream out_;
+    size_t size_ = 0;
+    std::atomic_uint64_t count_{0};
+};
+
+} // ns
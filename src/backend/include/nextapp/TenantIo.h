@@ -0,0 +1,126 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <vector>
+#include <optional>
+
+#include <boost/asio.hpp>
+
+#include "nextapp/Server.h"
+#include "nextapp/util.h"
+#include "nextapp.pb.h"
+
+namespace nextapp::grpc {
+
+/*! Reads all the data for a tenant from the database, in batches.
+ *
+ *  The records are returned in an order that allows them to be
+ *  imported in sequence; the tenant, users, nodes, days and actions.
+ *  Only one batch is kept in memory at any time.
+ */
+class TenantExporter {
+public:
+    TenantExporter(Server& server, std::string tenant, size_t batchSize = 500);
+
+    /*! Get the next batch of records
+     *
+     *  \param records Cleared and filled with the next batch.
+     *  \return false when there are no more records to export.
+     */
+    boost::asio::awaitable<bool> next(std::vector<pb::ExportRecord>& records);
+
+private:
+    enum class Stage {
+        TENANT,
+        USERS,
+        NODES,
+        DAYS,
+        ACTIONS,
+        DONE
+    };
+
+    boost::asio::awaitable<void> fetchTenant(std::vector<pb::ExportRecord>& records);
+    boost::asio::awaitable<void> fetchUsers(std::vector<pb::ExportRecord>& records);
+    boost::asio::awaitable<void> fetchNodes(std::vector<pb::ExportRecord>& records);
+    boost::asio::awaitable<void> fetchDays(std::vector<pb::ExportRecord>& records);
+    boost::asio::awaitable<void> fetchActions(std::vector<pb::ExportRecord>& records);
+    void nextStage();
+
+    Server& server_;
+    const std::string tenant_;
+    const size_t batch_size_;
+    Stage stage_{Stage::TENANT};
+
+    // Keyset for the current stage. Days are keyed by (user, date),
+    // and nodes by (level, id), so that the parents come first.
+    std::string last_id_;
+    std::string last_date_;
+    int64_t last_level_ = 0;
+};
+
+/*! Writes exported records to the database in one transaction.
+ *
+ *  The records are collected in multi-row INSERT statements, one for
+ *  each table, and written when one of them is full.
+ *
+ *  The foreign keys are checked, so a node must come after its parent,
+ *  as they do from TenantExporter.
+ */
+class TenantImporter {
+public:
+    struct Counts {
+        size_t tenants = 0;
+        size_t users = 0;
+        size_t nodes = 0;
+        size_t days = 0;
+        size_t actions = 0;
+    };
+
+    TenantImporter(Server& server, size_t batchSize = 500);
+
+    // Starts the transaction. Must be called before add()
+    boost::asio::awaitable<void> begin();
+
+    // Rolls back the transaction if it is not committed
+    ~TenantImporter();
+
+    boost::asio::awaitable<void> add(const pb::ExportRecord& record);
+
+    // Writes the remaining records, updates the day statistics and commits the transaction.
+    boost::asio::awaitable<void> commit();
+
+    // Rolls back the transaction.
+    boost::asio::awaitable<void> abort();
+
+    const Counts& counts() const noexcept {
+        return counts_;
+    }
+
+    // Human readable summary of what was imported
+    std::string summary() const;
+
+private:
+    boost::asio::awaitable<void> flush();
+    void addNode(const pb::Node& node);
+
+    Server& server_;
+    std::optional<Server::Db::Handle> handle_;
+    // After the handle, so it is rolled back before the connection is released
+    std::optional<Server::Db::Handle::Transaction> trx_;
+    BulkInsert tenants_;
+    BulkInsert users_;
+    BulkInsert nodes_;
+    BulkInsert days_;
+    BulkInsert actions_;
+    std::set<std::string> imported_tenants_;
+    Counts counts_;
+};
+
+// Rebuilds day_stats and day_streak for the users in a tenant from their days
+boost::asio::awaitable<void> rebuildDayStats(Server::Db::Handle& handle, const std::string& tenant);
+
+// Rebuilds time_spent for the users in a tenant from their work sessions
+boost::asio::awaitable<void> rebuildTimeSpent(Server::Db::Handle& handle, const std::string& tenant);
+
+} // ns
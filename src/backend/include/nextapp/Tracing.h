@@ -0,0 +1,242 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "nextapp/config.h"
+
+namespace nextapp {
+
+class Tracer;
+
+/*! The spans for one sampled request.
+ *
+ *  The first span is the request itself. The trace is owned by the
+ *  executor of the request's coroutine, so it is exported when the
+ *  coroutine is done and the last reference is released.
+ */
+class Trace {
+public:
+    // Same values as the OTLP SpanKind
+    enum class Kind {
+        INTERNAL = 1,
+        SERVER = 2,
+        CLIENT = 3
+    };
+
+    struct SpanData {
+        std::string name;
+        uint64_t id = 0;
+        uint64_t parent_id = 0;
+        Kind kind = Kind::INTERNAL;
+        uint64_t start_ns = 0; // Nanoseconds since the unix epoch
+        uint64_t end_ns = 0;
+        bool failed = false;
+        std::string message;
+        std::vector<std::pair<std::string, std::string>> attributes;
+    };
+
+    Trace(Tracer& tracer, uint64_t idHigh, std::string_view name);
+    ~Trace();
+
+    Trace(const Trace&) = delete;
+    Trace& operator = (const Trace&) = delete;
+
+    // Ends the span for the request
+    void finish(bool ok, std::string_view message = {});
+
+    void add(SpanData&& span);
+
+    uint64_t rootSpanId() const noexcept {
+        return root_id_;
+    }
+
+    // 32 hex digits, like in the OTLP data. Useful in log messages.
+    std::string id() const;
+
+    // The trace for the request running on this thread, or nullptr
+    static Trace *current() noexcept {
+        return current_;
+    }
+
+    // Makes a trace current for the lifetime of the scope
+    class Scope {
+    public:
+        explicit Scope(Trace *trace) noexcept
+            : prev_{std::exchange(current_, trace)} {}
+
+        ~Scope() {
+            current_ = prev_;
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator = (const Scope&) = delete;
+
+    private:
+        Trace *prev_;
+    };
+
+private:
+    friend class Tracer;
+
+    Tracer& tracer_;
+    std::array<uint64_t, 2> id_;
+    uint64_t root_id_;
+    std::mutex mutex_;
+    std::vector<SpanData> spans_;
+    static thread_local Trace *current_;
+};
+
+/*! Times a part of the current request, like a database query.
+ *
+ *  Does nothing if the request is not sampled, so it's cheap to
+ *  sprinkle around.
+ */
+class Span {
+public:
+    explicit Span(std::string_view name, Trace::Kind kind = Trace::Kind::INTERNAL);
+    ~Span();
+
+    Span(const Span&) = delete;
+    Span& operator = (const Span&) = delete;
+
+    bool active() const noexcept {
+        return trace_ != nullptr;
+    }
+
+    Span& attr(std::string_view key, std::string_view value);
+    Span& attr(std::string_view key, int64_t value);
+    void fail(std::string_view message);
+
+private:
+    Trace *trace_ = Trace::current();
+    Trace::SpanData data_;
+};
+
+/*! Samples requests and writes their traces to a file.
+ *
+ *  Each line in the file is an OTLP/JSON ExportTraceServiceRequest, the
+ *  format read by the OpenTelemetry collector's `otlpjsonfile` receiver.
+ *  The traces are serialized and written by a background thread.
+ */
+class Tracer {
+public:
+    explicit Tracer(const TraceConfig& config);
+    ~Tracer();
+
+    void start();
+    void stop();
+
+    bool enabled() const noexcept {
+        return running_;
+    }
+
+    // Fraction of the requests to trace from now on
+    void setSampleRate(double rate) noexcept;
+
+    // A new trace for a request, or nullptr if the request is not sampled
+    std::shared_ptr<Trace> startTrace(std::string_view name);
+
+    uint64_t exported() const noexcept {
+        return exported_;
+    }
+
+    // Traces that were discarded because the writer could not keep up
+    uint64_t dropped() const noexcept {
+        return dropped_;
+    }
+
+    static uint64_t random() noexcept;
+    static uint64_t nowNs() noexcept;
+
+private:
+    friend class Trace;
+
+    struct Pending {
+        std::array<uint64_t, 2> id;
+        std::vector<Trace::SpanData> spans;
+    };
+
+    void submit(Pending&& trace);
+    void write(std::deque<Pending>& batch);
+    void run(std::stop_token token);
+
+    const TraceConfig config_;
+    std::atomic_uint64_t threshold_;
+    std::ofstream out_;
+    std::mutex mutex_;
+    std::condition_variable_any cv_;
+    std::deque<Pending> pending_;
+    std::atomic_uint64_t exported_{0};
+    std::atomic_uint64_t dropped_{0};
+    std::atomic_bool running_{false};
+    std::jthread writer_;
+};
+
+/*! Executor that makes a trace current while it runs handlers.
+ *
+ *  The coroutine for a sampled request runs on this executor, so the
+ *  trace is current whenever the coroutine runs, also after it is
+ *  resumed on another thread. All the properties are forwarded to the
+ *  wrapped executor.
+ */
+template <typename InnerT>
+class TracedExecutor {
+public:
+    TracedExecutor(InnerT inner, std::shared_ptr<Trace> trace) noexcept
+        : inner_{std::move(inner)}, trace_{std::move(trace)} {}
+
+    template <typename PropertyT>
+    auto query(const PropertyT& p) const
+        -> decltype(std::declval<const InnerT&>().query(p)) {
+        return inner_.query(p);
+    }
+
+    template <typename PropertyT>
+    auto require(const PropertyT& p) const
+        -> TracedExecutor<std::decay_t<decltype(std::declval<const InnerT&>().require(p))>> {
+        return {inner_.require(p), trace_};
+    }
+
+    template <typename PropertyT>
+    auto prefer(const PropertyT& p) const
+        -> TracedExecutor<std::decay_t<decltype(std::declval<const InnerT&>().prefer(p))>> {
+        return {inner_.prefer(p), trace_};
+    }
+
+    template <typename FnT>
+    void execute(FnT&& fn) const {
+        inner_.execute([trace=trace_, fn=std::forward<FnT>(fn)]() mutable {
+            Trace::Scope scope{trace.get()};
+            std::move(fn)();
+        });
+    }
+
+    friend bool operator == (const TracedExecutor& a, const TracedExecutor& b) noexcept {
+        return a.inner_ == b.inner_ && a.trace_ == b.trace_;
+    }
+
+    friend bool operator != (const TracedExecutor& a, const TracedExecutor& b) noexcept {
+        return !(a == b);
+    }
+
+private:
+    template <typename> friend class TracedExecutor;
+
+    InnerT inner_;
+    std::shared_ptr<Trace> trace_;
+};
+
+} // ns
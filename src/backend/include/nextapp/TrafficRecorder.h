@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string_view>
+
+#include "nextapp/config.h"
+
+namespace google::protobuf {
+class Message;
+}
+
+namespace nextapp {
+
+/*! Records the unary requests, for replay with nextapp-replay.
+ *
+ *  Each request is written as a length-delimited `pb::TrafficRecord` with the
+ *  method, the user, when it arrived, how long it took and the sizes of the
+ *  request and reply. Optionally the record has the request payload, either
+ *  as it was or anonymized.
+ *
+ *  Anonymized payloads have the same shape and about the same size as the
+ *  original. Strings that are uuid's are replaced by a uuid derived from the
+ *  original, so a node created by one request is the same node in the next
+ *  one. All other strings and bytes are replaced by 'x' characters.
+ */
+class TrafficRecorder {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    enum class Payloads {
+        NONE,
+        ANONYMIZED,
+        RAW
+    };
+
+    explicit TrafficRecorder(const RecordConfig& config);
+
+    void open();
+
+    [[nodiscard]] bool enabled() const noexcept {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    void record(std::string_view method, std::string_view user, clock_t::time_point arrived,
+                clock_t::duration duration, int status, const google::protobuf::Message& request,
+                size_t replySize);
+
+    uint64_t count() const noexcept {
+        return count_;
+    }
+
+    // Replace the user data in `message`
+    static void anonymize(google::protobuf::Message& message);
+
+private:
+    const RecordConfig config_;
+    Payloads payloads_ = Payloads::NONE;
+    const clock_t::time_point start_{clock_t::now()};
+    std::atomic_bool enabled_{false};
+    std::mutex mutex_;
+    std::ofstream out_;
+    std::atomic_uint64_t count_{0};
+};
+
+} // ns
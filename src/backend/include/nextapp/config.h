@@ -8,18 +8,133 @@
 
 namespace nextapp {
 
+struct LogConfig {
+    // One of 'info', 'debug', 'trace'. Empty to disable.
+    std::string console_level = "info";
+    std::string level = "info";
+
+    // Log-file in addition to the console. Empty for no file.
+    std::string file;
+    bool truncate = false;
+
+    bool operator == (const LogConfig&) const = default;
+};
+
 struct ServerConfig {
     size_t io_threads = std::min<size_t>(std::max<size_t>(2,std::thread::hardware_concurrency()), 8);
+
+    // One io_context, thread and database pool per io-thread, instead of
+    // io_threads threads sharing one io_context.
+    bool thread_per_core = false;
+
+    // Pin the shard threads to one CPU core each. Only used with thread_per_core.
+    bool pin_threads = true;
+
+    // Threads for the database I/O. 0 to use the io-threads.
+    size_t db_threads = 2;
+
+    // Threads for CPU bound work, like building large replies. 0 to use the io-threads.
+    size_t cpu_threads = 2;
+
+    // Log a warning when handlers wait longer than this in the queue of an executor.
+    size_t executor_lag_warn_ms = 200;
+
+    // host:port for the Prometheus metrics. Empty to disable.
+    std::string metrics_endpoint = "127.0.0.1:9012";
 };
 
 struct GrpcConfig {
     std::string address = "127.0.0.1:10321";
+
+    // Max number of unary requests in progress. 0 for no limit.
+    size_t max_in_flight = 0;
+
+    // Requests per second allowed for each user, for each RPC method. 0 for no limit.
+    // Off by default. Until there is authentication, all the clients are the same
+    // user and share the same buckets.
+    double rate_limit = 0;
+
+    // Requests a user can make in a burst, for each RPC method.
+    double rate_limit_burst = 100;
+
+    // Take the user from the "nextapp-user" request metadata. Only for tests,
+    // until there is authentication.
+    bool user_from_metadata = false;
+};
+
+struct TraceConfig {
+    // File to append the traces to, in the OTLP/JSON format. Empty to disable tracing.
+    std::string path;
+
+    // Fraction of the requests to trace, from 0.0 to 1.0
+    double sample_rate = 0.01;
+};
+
+struct SlowQueryConfig {
+    // Queries that take longer than this are logged. 0 to disable.
+    size_t threshold_ms = 500;
+
+    // File for the slow-query log. If empty, slow queries are logged to the application log.
+    std::string path;
+
+    // Rotate the file when it reach this size
+    size_t max_size_mb = 10;
+
+    // Number of rotated files to keep
+    size_t max_files = 5;
+};
+
+// Recording of the unary requests, for replay with nextapp-replay
+struct RecordConfig {
+    // File to append the records to. If empty, nothing is recorded.
+    std::string path;
+
+    // "none", "anonymized" or "raw"
+    std::string payloads = "none";
+};
+
+// Synthetic data for performance tests, created by --bootstrap --generate-data
+struct DataGenConfig {
+    size_t tenants = 1;
+
+    // Users in each tenant
+    size_t users = 10;
+
+    // Levels in each users node tree, and children for each node
+    size_t depth = 3;
+    size_t fanout = 5;
+
+    // Actions for each node
+    size_t actions = 4;
+
+    // Years of days, ending at `end_date`, each with a color
+    size_t years = 2;
+
+    // Work sessions for each user on each weekday
+    size_t work_sessions = 2;
+
+    // YYYY-MM-DD. Today if empty. Set it to get the same data on different days.
+    std::string end_date;
+
+    // The same seed gives the same data, including the uuid's
+    uint64_t seed = 42;
+
+    // "v7" for time-ordered ids, like the server creates, or "v4" for random ids.
+    // Compare the load times to see what the id's do to the inserts.
+    std::string uuid_version = "v7";
+
+    // Rows in each INSERT statement
+    size_t batch_size = 1000;
 };
 
 struct Config {
+    LogConfig log;
     ServerConfig svr;
     jgaa::mysqlpool::DbConfig db;
     GrpcConfig grpc;
+    TraceConfig trace;
+    SlowQueryConfig slow_query;
+    RecordConfig record;
 };
 
 } // ns
@@ -1,10 +1,128 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <optional>
+#include <type_traits>
 #include <cstddef>
+#include <vector>
+
+#include <boost/mysql/field.hpp>
+#include <boost/mysql/field_view.hpp>
 
 namespace nextapp {
 
     std::string getEnv(const char *name, std::string def = {});
 
+    // Converts a value to a field that can be bound to a query
+    template <typename T>
+    boost::mysql::field toDbField(const T& value) {
+        using V = std::remove_cvref_t<T>;
+        if constexpr (std::is_same_v<V, std::nullopt_t> || std::is_same_v<V, std::nullptr_t>) {
+            return {};
+        } else if constexpr (requires { value.has_value(); *value; }) {
+            return value ? toDbField(*value) : boost::mysql::field{};
+        } else if constexpr (std::is_same_v<V, bool>) {
+            return boost::mysql::field{static_cast<int64_t>(value)};
+        } else if constexpr (std::is_enum_v<V>) {
+            return boost::mysql::field{static_cast<int64_t>(value)};
+        } else if constexpr (std::is_integral_v<V> && std::is_signed_v<V>) {
+            return boost::mysql::field{static_cast<int64_t>(value)};
+        } else if constexpr (std::is_integral_v<V>) {
+            return boost::mysql::field{static_cast<uint64_t>(value)};
+        } else if constexpr (std::is_floating_point_v<V>) {
+            return boost::mysql::field{static_cast<double>(value)};
+        } else if constexpr (std::is_convertible_v<const V&, std::string_view>) {
+            return boost::mysql::field{std::string{std::string_view{value}}};
+        } else {
+            return boost::mysql::field{value};
+        }
+    }
+
+    // An SQL expression that is added to a query as is, like `DEFAULT`.
+    // Any `?` in the expression are bound to `args`.
+    struct SqlExpr {
+        std::string expr;
+        std::vector<boost::mysql::field> args;
+    };
+
+    /*! Builds multi-row INSERT statements.
+     *
+     *  Each row adds a group of placeholders to the query, and the values
+     *  are bound as arguments, like for any other query.
+     */
+    class BulkInsert {
+    public:
+        // The statement for one batch, and the values to bind to it
+        struct Batch {
+            std::string query;
+            std::vector<boost::mysql::field> values;
+
+            // The arguments for exec(). Only valid as long as the batch.
+            [[nodiscard]] std::vector<boost::mysql::field_view> args() const {
+                return {values.begin(), values.end()};
+            }
+        };
+
+        /*! Constructor
+         *
+         *  \param prefix The start of the query, up to and including `VALUES`
+         *  \param maxRows The number of rows that makes the batch `full()`
+         *  \param suffix Optional end of the query, like `ON DUPLICATE KEY UPDATE ...`
+         */
+        BulkInsert(std::string prefix, size_t maxRows = 500, std::string suffix = {});
+
+        template <typename... T>
+        void add(const T&... values) {
+            query_ += rows_ ? ",(" : "(";
+            size_t col = 0;
+            ((query_ += col++ ? "," : "", append(values)), ...);
+            query_ += ')';
+            ++rows_;
+        }
+
+        [[nodiscard]] bool empty() const noexcept {
+            return rows_ == 0;
+        }
+
+        // Also full before a row more could exceed the placeholders a statement can have
+        [[nodiscard]] bool full() const noexcept {
+            return rows_ >= max_rows_ || values_.size() >= max_values;
+        }
+
+        [[nodiscard]] size_t size() const noexcept {
+            return rows_;
+        }
+
+        // Returns the batch and resets the builder for the next batch
+        Batch take();
+
+    private:
+        // MariaDB allows 65535 placeholders in a prepared statement
+        static constexpr size_t max_values = 60000;
+
+        template <typename T>
+        void append(const T& value) {
+            if constexpr (std::is_same_v<T, SqlExpr>) {
+                query_ += value.expr;
+                values_.insert(values_.end(), value.args.begin(), value.args.end());
+            } else if constexpr (requires { value.has_value(); *value; }) {
+                if (value) {
+                    append(*value);
+                } else {
+                    query_ += "NULL";
+                }
+            } else {
+                query_ += '?';
+                values_.emplace_back(toDbField(value));
+            }
+        }
+
+        const std::string prefix_;
+        const std::string suffix_;
+        const size_t max_rows_;
+        std::string query_;
+        std::vector<boost::mysql::field> values_;
+        size_t rows_ = 0;
+    };
 }
@@ -0,0 +1,84 @@
+
+#include <format>
+
+#include "nextapp/AdmissionControl.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+
+namespace nextapp {
+
+AdmissionControl::AdmissionControl(const Config &config)
+    : rate_{config.rate}, burst_{config.burst}, max_in_flight_{config.max_in_flight}
+{
+}
+
+void AdmissionControl::setConfig(const Config &config) noexcept
+{
+    rate_ = config.rate;
+    burst_ = config.burst;
+    max_in_flight_ = config.max_in_flight;
+}
+
+std::optional<AdmissionControl::Ticket> AdmissionControl::admit(std::string_view user, std::string_view method, string& reason)
+{
+    // The requests are always counted, so the limit can be enabled while the server runs
+    const size_t max_in_flight = max_in_flight_;
+    if (++in_flight_ > max_in_flight && max_in_flight) {
+        --in_flight_;
+        ++rejected_;
+        reason = format("The server is busy. There are already {} requests in progress.", max_in_flight);
+        return {};
+    }
+
+    Ticket ticket{&in_flight_};
+
+    if (const double rate = rate_; rate > 0 && !take(user, method, rate)) {
+        ++rejected_;
+        reason = format("Too many {} requests. The limit is {} per second.", method, rate);
+        return {};
+    }
+
+    return ticket;
+}
+
+bool AdmissionControl::take(std::string_view user, std::string_view method, double rate)
+{
+    const auto now = chrono::steady_clock::now();
+    const auto burst = max(burst_.load(), 1.0);
+
+    string key;
+    key.reserve(user.size() + method.size() + 1);
+    key.append(user);
+    key += '/';
+    key.append(method);
+
+    auto& shard = shards_[hash<string>{}(key) % num_shards];
+    lock_guard lock{shard.mutex};
+
+    if (shard.buckets.size() >= max_buckets_in_shard) {
+        // Forget the buckets that are full again. They are the same as new ones.
+        erase_if(shard.buckets, [&](const auto& v) {
+            const chrono::duration<double> elapsed = now - v.second.last;
+            return v.second.tokens + elapsed.count() * rate >= burst;
+        });
+    }
+
+    auto [it, added] = shard.buckets.try_emplace(std::move(key), Bucket{burst, now});
+    auto& bucket = it->second;
+    if (!added) {
+        const chrono::duration<double> elapsed = now - bucket.last;
+        bucket.tokens = min(burst, bucket.tokens + elapsed.count() * rate);
+        bucket.last = now;
+    }
+
+    if (bucket.tokens < 1.0) {
+        LOG_TRACE_N << "Rate limit exceeded for " << it->first;
+        return false;
+    }
+
+    bucket.tokens -= 1.0;
+    return true;
+}
+
+} // ns
@@ -0,0 +1,90 @@
+
+#include <exception>
+#include <format>
+#include <memory>
+
+#include "nextapp/Db.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace nextapp {
+
+asio::awaitable<boost::mysql::results> Db::execCancellable(Context& context, Connection& conn, run_t run)
+{
+    const auto state = co_await asio::this_coro::cancellation_state;
+    auto slot = state.slot();
+    if (!slot.is_connected()) {
+        co_return co_await run();
+    }
+    if (state.cancelled() != asio::cancellation_type::none) {
+        throw boost::system::system_error{asio::error::operation_aborted};
+    }
+
+    // We must be able to wait for the KILL after the request is cancelled
+    co_await asio::this_coro::throw_if_cancelled(false);
+
+    const auto executor = co_await asio::this_coro::executor;
+    auto shielded = asio::bind_cancellation_slot(asio::cancellation_slot{}, asio::use_awaitable);
+
+    exception_ptr error;
+    boost::mysql::results res;
+    bool killing = false;
+    auto killed = make_shared<asio::steady_timer>(executor, asio::steady_timer::time_point::max());
+    try {
+        const auto id = co_await asio::co_spawn(executor, connectionId(conn), shielded);
+
+        slot.assign([&context, &killing, id, killed, executor](asio::cancellation_type) {
+            killing = true;
+            asio::co_spawn(executor, killQuery(context, id), [killed](exception_ptr) {
+                killed->cancel();
+            });
+        });
+
+        res = co_await asio::co_spawn(executor, run(), shielded);
+    } catch (...) {
+        error = current_exception();
+    }
+    slot.clear();
+
+    if (killing) {
+        boost::system::error_code ec;
+        co_await killed->async_wait(asio::bind_cancellation_slot(asio::cancellation_slot{},
+                                    asio::redirect_error(asio::use_awaitable, ec)));
+    }
+    co_await asio::this_coro::throw_if_cancelled(true);
+
+    if (error) {
+        // The connection may have been reconnected, with a new thread id
+        conn.id.reset();
+        rethrow_exception(error);
+    }
+    co_return res;
+}
+
+asio::awaitable<uint64_t> Db::connectionId(Connection& conn)
+{
+    if (!conn.id) {
+        const auto res = co_await conn.handle.exec("SELECT CONNECTION_ID()");
+        const auto& field = res.rows().at(0).at(0);
+        conn.id = field.is_uint64() ? field.as_uint64() : static_cast<uint64_t>(field.as_int64());
+    }
+    co_return *conn.id;
+}
+
+asio::awaitable<void> Db::killQuery(Context& context, uint64_t id)
+{
+    try {
+        if (!context.control) {
+            LOG_DEBUG << "No control connection to kill the query on database connection " << id;
+            co_return;
+        }
+        co_await context.control->exec(format("KILL QUERY {}", id));
+    } catch (const exception& ex) {
+        // Like when the query was done before the KILL
+        LOG_DEBUG << "Failed to kill the query on database connection " << id << ": " << ex.what();
+    }
+}
+
+} // ns
@@ -0,0 +1,114 @@
+
+#include "nextapp/ExecutorPool.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+using nextapp::logging::LogEvent;
+namespace asio = boost::asio;
+
+namespace nextapp {
+
+LagProbe::LagProbe(boost::asio::io_context &ctx, std::string name,
+                   std::chrono::milliseconds warnAfter, std::chrono::milliseconds interval)
+    : timer_{ctx}, name_{std::move(name)}, warn_after_{warnAfter}, interval_{interval}
+{
+}
+
+void LagProbe::start()
+{
+    stopped_ = false;
+    schedule();
+}
+
+void LagProbe::stop()
+{
+    stopped_ = true;
+    asio::post(timer_.get_executor(), [this] {
+        timer_.cancel();
+    });
+}
+
+void LagProbe::schedule()
+{
+    timer_.expires_after(interval_);
+    timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec || stopped_) {
+            return;
+        }
+
+        const auto lag = chrono::steady_clock::now() - timer_.expiry();
+        const auto lag_us = static_cast<uint64_t>(max<int64_t>(0,
+            chrono::duration_cast<chrono::microseconds>(lag).count()));
+
+        last_lag_us_ = lag_us;
+        if (lag_us > max_lag_us_) {
+            max_lag_us_ = lag_us;
+        }
+
+        if (lag > warn_after_) {
+            LOG_WARN << "The " << name_ << " executor is saturated. Handlers wait "
+                     << (lag_us / 1000) << " milliseconds in its queue.";
+        }
+
+        schedule();
+    });
+}
+
+ExecutorPool::ExecutorPool(std::string name, size_t numThreads, std::chrono::milliseconds warnAfter)
+    : name_{std::move(name)}
+    , num_threads_{max<size_t>(numThreads, 1)}
+    , ctx_{static_cast<int>(num_threads_)}
+    , probe_{ctx_, name_, warnAfter}
+{
+}
+
+ExecutorPool::~ExecutorPool()
+{
+    stop();
+    threads_.clear(); // join
+}
+
+void ExecutorPool::start()
+{
+    assert(threads_.empty());
+    LOG_DEBUG_N << "Starting " << num_threads_ << " threads for the " << name_ << " executor.";
+
+    work_.emplace(ctx_.get_executor());
+    probe_.start();
+
+    threads_.reserve(num_threads_);
+    for(size_t i = 0; i < num_threads_; ++i) {
+        threads_.emplace_back([this, i] {
+            run(i);
+        });
+    }
+}
+
+void ExecutorPool::stop()
+{
+    if (!work_) {
+        return;
+    }
+
+    probe_.stop();
+    work_.reset();
+    ctx_.stop();
+}
+
+void ExecutorPool::run(size_t id)
+{
+    LOG_DEBUG_N << "starting " << name_ << " thread " << id;
+    while(!ctx_.stopped()) {
+        try {
+            ctx_.run();
+        } catch (const std::exception& ex) {
+            LOG_ERROR << LogEvent::LE_IOTHREAD_THREW
+                      << "Caught exception from " << name_ << " thread #" << id
+                      << ": " << ex.what();
+        }
+    }
+
+    LOG_DEBUG_N << name_ << " thread " << id << " is done.";
+}
+
+} // ns
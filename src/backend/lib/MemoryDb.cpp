@@ -0,0 +1,59 @@
+
+#include <ranges>
+
+#include "nextapp/MemoryDb.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace nextapp {
+
+void MemoryDb::on(std::string_view prefix, DbResult::rows_t rows)
+{
+    on(prefix, [rows=std::move(rows)](string_view, args_t) {
+        return DbResult{rows, rows.empty() ? 1U : rows.size()};
+    });
+}
+
+void MemoryDb::on(std::string_view prefix, reply_fn_t fn)
+{
+    rules_.emplace_back(string{prefix}, std::move(fn));
+}
+
+boost::asio::awaitable<DbResult> MemoryDb::exec(std::string_view query, std::vector<boost::mysql::field> args)
+{
+    ++count_;
+
+    if (const auto delay = nextDelay(); delay.count() > 0) {
+        asio::steady_timer timer{co_await asio::this_coro::executor, delay};
+        co_await timer.async_wait(asio::use_awaitable);
+    }
+
+    if (const auto start = query.find_first_not_of(" \t\r\n"); start != string_view::npos) {
+        query = query.substr(start);
+    }
+
+    for(const auto& rule : rules_ | views::reverse) {
+        if (query.starts_with(rule.prefix)) {
+            co_return rule.fn(query, args);
+        }
+    }
+
+    ++unmatched_;
+    LOG_TRACE_N << "No reply for: " << query;
+    co_return DbResult{DbResult::rows_t{}, 1};
+}
+
+std::chrono::microseconds MemoryDb::nextDelay()
+{
+    if (latency_.jitter.count() <= 0) {
+        return latency_.fixed;
+    }
+
+    uniform_int_distribution<chrono::microseconds::rep> jitter{0, latency_.jitter.count()};
+    lock_guard lock{mutex_};
+    return latency_.fixed + chrono::microseconds{jitter(rng_)};
+}
+
+} // ns
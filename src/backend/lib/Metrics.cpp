@@ -0,0 +1,277 @@
+
+#include <bit>
+#include <format>
+
+#include "nextapp/Metrics.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+using namespace std::chrono_literals;
+namespace asio = boost::asio;
+
+namespace nextapp {
+
+namespace {
+
+string labelsFor(const string& labels, const string& extra = {}) {
+    if (labels.empty() && extra.empty()) {
+        return {};
+    }
+    if (labels.empty()) {
+        return format("{{{}}}", extra);
+    }
+    if (extra.empty()) {
+        return format("{{{}}}", labels);
+    }
+    return format("{{{},{}}}", labels, extra);
+}
+
+constexpr string_view typeName(int type) {
+    constexpr array<string_view, 3> names = {"counter", "gauge", "histogram"};
+    return names.at(type);
+}
+
+} // anon ns
+
+size_t Metrics::threadSlot() noexcept
+{
+    static atomic_size_t next{0};
+    thread_local const size_t slot = next++ % num_slots;
+    return slot;
+}
+
+uint64_t Metrics::Counter::value() const noexcept
+{
+    uint64_t sum = 0;
+    for(const auto& slot : slots_) {
+        sum += slot.value.load(memory_order_relaxed);
+    }
+    return sum;
+}
+
+size_t Metrics::Histogram::bucketFor(uint64_t us) noexcept
+{
+    if (us <= (1U << min_bits)) {
+        return 0;
+    }
+
+    // The upper bounds are inclusive, like `le` in Prometheus. So a value on
+    // a bound belongs to the bucket below it.
+    const auto below = us - 1;
+    const auto octave = static_cast<unsigned>(bit_width(below)) - 1 - min_bits;
+    if (octave >= octaves) {
+        return num_buckets - 1;
+    }
+
+    // The bit(s) below the leading one select the sub-bucket
+    const auto sub = (below >> (octave + min_bits - 1)) & (sub_buckets - 1);
+    return 1 + (octave * sub_buckets) + sub;
+}
+
+uint64_t Metrics::Histogram::upperBoundUs(size_t bucket) noexcept
+{
+    if (bucket == 0) {
+        return 1U << min_bits;
+    }
+
+    const auto octave = (bucket - 1) / sub_buckets;
+    const auto sub = (bucket - 1) % sub_buckets;
+    const uint64_t lower = uint64_t{1} << (octave + min_bits);
+    const uint64_t width = lower / sub_buckets;
+    return lower + (width * (sub + 1));
+}
+
+void Metrics::Histogram::observeUs(uint64_t us) noexcept
+{
+    auto& slot = slots_[threadSlot() % slots_.size()];
+    slot.buckets[bucketFor(us)].fetch_add(1, memory_order_relaxed);
+    slot.count.fetch_add(1, memory_order_relaxed);
+    slot.sum_us.fetch_add(us, memory_order_relaxed);
+}
+
+Metrics::Histogram::Snapshot Metrics::Histogram::snapshot() const noexcept
+{
+    Snapshot snap;
+    for(const auto& slot : slots_) {
+        for(size_t i = 0; i < num_buckets; ++i) {
+            snap.buckets[i] += slot.buckets[i].load(memory_order_relaxed);
+        }
+        snap.count += slot.count.load(memory_order_relaxed);
+        snap.sum_us += slot.sum_us.load(memory_order_relaxed);
+    }
+    return snap;
+}
+
+Metrics::Counter &Metrics::counter(const std::string &name, const std::string &help, const std::string &labels)
+{
+    auto& entry = add(name, help, Type::COUNTER, labels);
+    entry.counter = make_unique<Counter>();
+    return *entry.counter;
+}
+
+Metrics::Gauge &Metrics::gauge(const std::string &name, const std::string &help, const std::string &labels)
+{
+    auto& entry = add(name, help, Type::GAUGE, labels);
+    entry.gauge = make_unique<Gauge>();
+    return *entry.gauge;
+}
+
+Metrics::Histogram &Metrics::histogram(const std::string &name, const std::string &help, const std::string &labels)
+{
+    auto& entry = add(name, help, Type::HISTOGRAM, labels);
+    entry.histogram = make_unique<Histogram>();
+    return *entry.histogram;
+}
+
+void Metrics::gauge(const std::string &name, const std::string &help, std::function<double ()> fn, const std::string &labels)
+{
+    auto& entry = add(name, help, Type::GAUGE, labels);
+    entry.fn = std::move(fn);
+}
+
+Metrics::Entry &Metrics::add(const std::string &name, const std::string &help, Type type, const std::string &labels)
+{
+    lock_guard lock{mutex_};
+    auto [it, _] = families_.try_emplace(name, Family{help, type, {}});
+    if (it->second.type != type) {
+        throw runtime_error{format("Metric {} is already registered with a different type", name)};
+    }
+    auto& entry = it->second.entries.emplace_back();
+    entry.labels = labels;
+    return entry;
+}
+
+std::string Metrics::render() const
+{
+    string out;
+    out.reserve(16 * 1024);
+
+    lock_guard lock{mutex_};
+    for(const auto& [name, family] : families_) {
+        out += format("# HELP {} {}\n# TYPE {} {}\n", name, family.help, name,
+                      typeName(static_cast<int>(family.type)));
+
+        for(const auto& entry : family.entries) {
+            if (entry.counter) {
+                out += format("{}{} {}\n", name, labelsFor(entry.labels), entry.counter->value());
+            } else if (entry.gauge) {
+                out += format("{}{} {}\n", name, labelsFor(entry.labels), entry.gauge->value());
+            } else if (entry.fn) {
+                out += format("{}{} {}\n", name, labelsFor(entry.labels), entry.fn());
+            } else if (entry.histogram) {
+                const auto snap = entry.histogram->snapshot();
+                uint64_t cumulative = 0;
+                for(size_t i = 0; i + 1 < Histogram::num_buckets; ++i) {
+                    cumulative += snap.buckets[i];
+                    const auto le = static_cast<double>(Histogram::upperBoundUs(i)) / 1'000'000.0;
+                    out += format("{}_bucket{} {}\n", name,
+                                  labelsFor(entry.labels, format("le=\"{}\"", le)), cumulative);
+                }
+                out += format("{}_bucket{} {}\n", name, labelsFor(entry.labels, "le=\"+Inf\""), snap.count);
+                out += format("{}_sum{} {}\n", name, labelsFor(entry.labels),
+                              static_cast<double>(snap.sum_us) / 1'000'000.0);
+                out += format("{}_count{} {}\n", name, labelsFor(entry.labels), snap.count);
+            }
+        }
+    }
+
+    return out;
+}
+
+MetricsHttpServer::MetricsHttpServer(boost::asio::io_context &ctx, const Metrics &metrics)
+    : ctx_{ctx}, metrics_{metrics}, acceptor_{ctx}
+{
+}
+
+void MetricsHttpServer::start(const std::string &endpoint)
+{
+    const auto colon = endpoint.rfind(':');
+    if (colon == string::npos) {
+        throw runtime_error{format("Invalid metrics endpoint '{}'. Expected host:port", endpoint)};
+    }
+
+    asio::ip::tcp::resolver resolver{ctx_};
+    const auto addresses = resolver.resolve(endpoint.substr(0, colon), endpoint.substr(colon + 1));
+    if (addresses.empty()) {
+        throw runtime_error{format("Failed to resolve the metrics endpoint '{}'", endpoint)};
+    }
+
+    const auto ep = addresses.begin()->endpoint();
+    acceptor_.open(ep.protocol());
+    acceptor_.set_option(asio::socket_base::reuse_address(true));
+    acceptor_.bind(ep);
+    acceptor_.listen();
+
+    LOG_INFO << "Serving metrics on http://" << ep << "/metrics";
+
+    asio::co_spawn(ctx_, accept(), asio::detached);
+}
+
+void MetricsHttpServer::stop()
+{
+    asio::post(ctx_, [this] {
+        boost::system::error_code ec;
+        acceptor_.close(ec);
+    });
+}
+
+boost::asio::awaitable<void> MetricsHttpServer::accept()
+{
+    // Errors like EMFILE don't go away by themselves. Wait a little before trying again.
+    constexpr auto min_backoff = 100ms;
+    constexpr auto max_backoff = 5s;
+    chrono::milliseconds backoff = min_backoff;
+    asio::steady_timer timer{ctx_};
+
+    while(acceptor_.is_open()) {
+        boost::system::error_code ec;
+        auto socket = co_await acceptor_.async_accept(asio::redirect_error(asio::use_awaitable, ec));
+        if (ec) {
+            if (ec == asio::error::operation_aborted) {
+                co_return;
+            }
+
+            LOG_WARN_N << "Failed to accept a metrics connection: " << ec.message()
+                       << ". Trying again in " << backoff.count() << " ms.";
+            timer.expires_after(backoff);
+            co_await timer.async_wait(asio::redirect_error(asio::use_awaitable, ec));
+            backoff = min(backoff * 2, chrono::milliseconds{max_backoff});
+            continue;
+        }
+
+        backoff = min_backoff;
+        asio::co_spawn(ctx_, handle(std::move(socket)), asio::detached);
+    }
+}
+
+boost::asio::awaitable<void> MetricsHttpServer::handle(boost::asio::ip::tcp::socket socket)
+{
+    try {
+        string request;
+        co_await asio::async_read_until(socket, asio::dynamic_buffer(request, 8192), "\r\n\r\n",
+                                        asio::use_awaitable);
+
+        string body;
+        string status = "200 OK";
+        if (request.starts_with("GET /metrics ") || request.starts_with("GET / ")) {
+            body = metrics_.render();
+        } else {
+            status = "404 Not Found";
+            body = "Not found\n";
+        }
+
+        const auto reply = format("HTTP/1.1 {}\r\n"
+                                  "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                                  "Content-Length: {}\r\n"
+                                  "Connection: close\r\n\r\n{}", status, body.size(), body);
+
+        co_await asio::async_write(socket, asio::buffer(reply), asio::use_awaitable);
+
+        boost::system::error_code ec;
+        socket.shutdown(asio::ip::tcp::socket::shutdown_both, ec);
+    } catch (const exception& ex) {
+        LOG_DEBUG_N << "Metrics request failed: " << ex.what();
+    }
+}
+
+} // ns
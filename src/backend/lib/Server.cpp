@@ -3,8 +3,17 @@
 #include <format>
 #include <span>
 #include <ranges>
+#include <fstream>
+#include <cstring>
+
+#ifdef __linux__
+#   include <pthread.h>
+#endif
 
 #include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/experimental/awaitable_operators.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
 #include <boost/mysql/diagnostics.hpp>
 #include <boost/mysql/error_with_diagnostics.hpp>
 #include <boost/mysql/handshake_params.hpp>
@@ -12,9 +21,13 @@
 #include <boost/mysql/tcp.hpp>
 #include <boost/mysql/throw_on_error.hpp>
 #include <boost/mysql.hpp>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
 
 #include "nextapp/Server.h"
 #include "nextapp/GrpcServer.h"
+#include "nextapp/TenantIo.h"
+#include "nextapp/DataGenerator.h"
 #include "nextapp/logging.h"
 
 using namespace std;
@@ -25,10 +38,60 @@ using jgaa::mysqlpool::tuple_awaitable;
 
 namespace nextapp {
 
+namespace {
+
+optional<logfault::LogLevel> toLogLevel(string_view name) {
+    if (name.empty() || name == "off" || name == "false") {
+        return {};
+    }
+
+    if (name == "debug") {
+        return logfault::LogLevel::DEBUGGING;
+    }
+
+    if (name == "trace") {
+        return logfault::LogLevel::TRACE;
+    }
+
+    return logfault::LogLevel::INFO;
+}
+
+double msSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Runs a startup phase and logs how long it took
+template <typename T>
+asio::awaitable<T> timed(string_view phase, asio::awaitable<T> work) {
+    const auto start = chrono::steady_clock::now();
+    if constexpr (is_void_v<T>) {
+        co_await std::move(work);
+        LOG_INFO << "Startup: " << phase << " took " << format("{:.1f}", msSince(start)) << " ms";
+    } else {
+        auto rval = co_await std::move(work);
+        LOG_INFO << "Startup: " << phase << " took " << format("{:.1f}", msSince(start)) << " ms";
+        co_return rval;
+    }
+}
+
+} // anon ns
+
+thread_local Server::Shard *Server::current_shard_ = {};
+
 Server::Server(const Config& config)
-    : config_(config)
+    : db_query_time_{metrics_.histogram("nextapp_db_query_duration_seconds",
+                                        "Time spent on database queries")}
+    , db_pool_wait_{metrics_.histogram("nextapp_db_pool_wait_seconds",
+                                       "Time spent waiting for a database connection from the pool")}
+    , tracer_{config.trace}
+    , slow_query_log_{config.slow_query}
+    , db_context_{db_query_time_, db_pool_wait_, slow_query_log_}
+    , recorder_{config.record}
+    , config_(config)
+    , active_config_(config)
 {
-
+    metrics_.gauge("nextapp_io_threads_running", "Number of io-threads that are running",
+                   [this] { return static_cast<double>(running_io_threads_.load()); });
 }
 
 Server::~Server()
@@ -39,21 +102,70 @@ Server::~Server()
 void Server::init()
 {
     handleSignals();
-    initCtx(config().svr.io_threads);
+    if (config().svr.thread_per_core) {
+        initShards(config().svr.io_threads);
+    } else {
+        initCtx(config().svr.io_threads);
+    }
 
-    db_.emplace(ctx_, config().db);
+    const chrono::milliseconds warn_after{config().svr.executor_lag_warn_ms};
+    if (config().svr.db_threads) {
+        db_pool_.emplace("database", config().svr.db_threads, warn_after);
+        db_pool_->start();
+    }
+    if (config().svr.cpu_threads) {
+        cpu_pool_.emplace("cpu", config().svr.cpu_threads, warn_after);
+        cpu_pool_->start();
+    }
+    io_lag_.emplace(ctx_, "io", warn_after);
+    io_lag_->start();
+
+    for(const auto *probe : lagProbes()) {
+        const auto labels = format("executor=\"{}\"", probe->name());
+        metrics_.gauge("nextapp_executor_queue_lag_seconds", "Time handlers waited in the executors queue at the last probe",
+                       [probe] { return static_cast<double>(probe->lastLagUs()) / 1'000'000.0; }, labels);
+        metrics_.gauge("nextapp_executor_queue_lag_max_seconds", "Longest time handlers have waited in the executors queue",
+                       [probe] { return static_cast<double>(probe->maxLagUs()) / 1'000'000.0; }, labels);
+    }
+
+    if (!memory_db_) {
+        db_.emplace(dbCtx(), config().db);
+
+        auto cfg = config().db;
+        cfg.max_connections = 1;
+        db_control_.emplace(dbCtx(), cfg);
+        db_context_.control = &*db_control_;
+    }
+    startMetricsService();
+    tracer_.start();
+    slow_query_log_.open();
+    metrics_.gauge("nextapp_db_slow_queries_total", "Queries that were slower than the slow-query threshold",
+                   [this] { return static_cast<double>(slow_query_log_.count()); });
+    recorder_.open();
 }
 
 void Server::run()
 {
     asio::co_spawn(ctx_, [&]() -> asio::awaitable<void> {
-            co_await db().init();
-            if (!co_await checkDb()) {
+            using namespace asio::experimental::awaitable_operators;
+            const auto start = chrono::steady_clock::now();
+
+            // Listen right away. Until we are ready, the health-service reports
+            // NOT_SERVING and requests fail with UNAVAILABLE.
+            co_await timed("gRPC service", startGrpcService());
+
+            // The shard pools (with --thread-per-core) connect while the main pool is
+            // initialized and the schema is checked.
+            const bool db_ok = co_await (prepareDb() && timed("shard database pools", initShardDbs()));
+            if (!db_ok) {
                 LOG_ERROR << "The database version is wrong. Please upgrade before starting the server.";
                 stop();
+                co_return;
             }
 
-            co_await startGrpcService();
+            ready_ = true;
+            grpc_service_->setServing(true);
+            LOG_INFO << "Ready to serve requests. The startup took " << format("{:.1f}", msSince(start)) << " ms";
         },
         [](std::exception_ptr ptr) {
             if (ptr) {
@@ -70,9 +182,48 @@ void Server::run()
 void Server::stop()
 {
     done_ = true;
+    if (metrics_service_) {
+        metrics_service_->stop();
+    }
+    if (io_lag_) {
+        io_lag_->stop();
+    }
+    for(auto& shard : shards_) {
+        shard->ctx.stop();
+    }
+    if (db_pool_) {
+        db_pool_->stop();
+    }
+    if (cpu_pool_) {
+        cpu_pool_->stop();
+    }
     ctx_.stop();
 }
 
+std::vector<const LagProbe *> Server::lagProbes() const
+{
+    std::vector<const LagProbe *> probes;
+    if (io_lag_) {
+        probes.push_back(&*io_lag_);
+    }
+    if (db_pool_) {
+        probes.push_back(&db_pool_->lag());
+    }
+    if (cpu_pool_) {
+        probes.push_back(&cpu_pool_->lag());
+    }
+    return probes;
+}
+
+boost::asio::io_context &Server::requestCtx() noexcept
+{
+    if (shards_.empty()) {
+        return ctx_;
+    }
+
+    return shards_[next_shard_++ % shards_.size()]->ctx;
+}
+
 void Server::bootstrap(const BootstrapOptions& opts)
 {
     LOG_INFO << "Bootstrapping the system...";
@@ -80,6 +231,14 @@ void Server::bootstrap(const BootstrapOptions& opts)
     asio::co_spawn(ctx_, [&]() -> asio::awaitable<void> {
         co_await createDb(opts);
         co_await upgradeDbTables(0);
+
+        if (opts.generate_data) {
+            db_.emplace(ctx_, config().db);
+            co_await db().init();
+            grpc::DataGenerator generator{*this, opts.data};
+            co_await generator.run();
+            co_await db().close();
+        }
     },
     [](std::exception_ptr ptr) {
         if (ptr) {
@@ -92,6 +251,103 @@ void Server::bootstrap(const BootstrapOptions& opts)
     LOG_INFO << "Bootstrapping is complete";
 }
 
+void Server::exportTenant(const std::string &tenant, const std::string &path)
+{
+    LOG_INFO << "Exporting tenant " << tenant << " to " << path;
+
+    ofstream out{path, ios::binary | ios::trunc};
+    if (!out) {
+        throw runtime_error{format("Failed to open {} for writing", path)};
+    }
+
+    db_.emplace(ctx_, config().db);
+    size_t count = 0;
+
+    asio::co_spawn(ctx_, [&]() -> asio::awaitable<void> {
+        co_await db().init();
+
+        grpc::TenantExporter exporter{*this, tenant};
+        vector<pb::ExportRecord> records;
+        while(co_await exporter.next(records)) {
+            for(const auto& record : records) {
+                if (!google::protobuf::util::SerializeDelimitedToOstream(record, &out)) {
+                    throw runtime_error{format("Failed to write to {}", path)};
+                }
+            }
+            count += records.size();
+        }
+
+        co_await db().close();
+    },
+    [](std::exception_ptr ptr) {
+        if (ptr) {
+            std::rethrow_exception(ptr);
+        }
+    });
+
+    ctx_.run();
+
+    LOG_INFO << "Exported " << count << " records";
+}
+
+void Server::importTenant(const std::string &path)
+{
+    LOG_INFO << "Importing tenant from " << path;
+
+    ifstream in{path, ios::binary};
+    if (!in) {
+        throw runtime_error{format("Failed to open {} for reading", path)};
+    }
+
+    db_.emplace(ctx_, config().db);
+
+    asio::co_spawn(ctx_, [&]() -> asio::awaitable<void> {
+        co_await db().init();
+        if (!co_await checkDb()) {
+            throw runtime_error{"The database version is wrong. Please upgrade before importing."};
+        }
+
+        grpc::TenantImporter importer{*this};
+        co_await importer.begin();
+
+        bool failed = false;
+        try {
+            google::protobuf::io::IstreamInputStream stream{&in};
+            pb::ExportRecord record;
+            while(true) {
+                bool clean_eof = false;
+                if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(&record, &stream, &clean_eof)) {
+                    if (clean_eof) {
+                        break;
+                    }
+                    throw runtime_error{format("Failed to read a record from {}", path)};
+                }
+                co_await importer.add(record);
+            }
+            co_await importer.commit();
+        } catch (const exception& ex) {
+            LOG_ERROR << "Import failed: " << ex.what();
+            failed = true;
+        }
+
+        if (failed) {
+            co_await importer.abort();
+        }
+
+        co_await db().close();
+        if (failed) {
+            throw runtime_error{"The import failed"};
+        }
+    },
+    [](std::exception_ptr ptr) {
+        if (ptr) {
+            std::rethrow_exception(ptr);
+        }
+    });
+
+    ctx_.run();
+}
+
 void Server::initCtx(size_t numThreads)
 {
     io_threads_.reserve(numThreads);
@@ -102,6 +358,109 @@ void Server::initCtx(size_t numThreads)
     }
 }
 
+void Server::initShards(size_t numShards)
+{
+    assert(shards_.empty());
+    numShards = max<size_t>(numShards, 1);
+
+    // The connections are divided between the shards
+    auto cfg = config().db;
+    cfg.max_connections = max<size_t>(1, cfg.max_connections / numShards);
+
+    LOG_INFO << "Starting " << numShards << " shards with up to "
+             << cfg.max_connections << " database connections each.";
+
+    shards_.reserve(numShards);
+    for(size_t i = 0; i < numShards; ++i) {
+        auto& shard = *shards_.emplace_back(make_unique<Shard>(i));
+        if (!memory_db_) {
+            shard.db.emplace(shard.ctx, cfg);
+        }
+        shard.thread = jthread{[this, &shard] {
+            runShard(shard);
+        }};
+    }
+}
+
+boost::asio::awaitable<void> Server::initShardDbs()
+{
+    if (shards_.empty() || memory_db_) {
+        co_return;
+    }
+
+    // Connect all the pools at the same time, each on its own shard
+    const auto init = [](Shard& shard) {
+        return asio::co_spawn(shard.ctx, shard.db->init(), asio::deferred);
+    };
+
+    std::vector<decltype(init(*shards_.front()))> ops;
+    ops.reserve(shards_.size());
+    for(auto& shard : shards_) {
+        ops.emplace_back(init(*shard));
+    }
+
+    auto [order, errors] = co_await asio::experimental::make_parallel_group(std::move(ops))
+        .async_wait(asio::experimental::wait_for_all(), asio::use_awaitable);
+
+    for(auto& err : errors) {
+        if (err) {
+            std::rethrow_exception(err);
+        }
+    }
+}
+
+boost::asio::awaitable<void> Server::initDbControl()
+{
+    if (db_control_) {
+        co_await db_control_->init();
+    }
+}
+
+boost::asio::awaitable<bool> Server::prepareDb()
+{
+    using namespace asio::experimental::awaitable_operators;
+    co_return co_await (timed("database pool", db().init())
+                        && initDbControl()
+                        && timed("database schema", checkDb()));
+}
+
+void Server::runShard(Shard& shard)
+{
+    current_shard_ = &shard;
+
+#ifdef __linux__
+    if (config().svr.pin_threads) {
+        const auto cores = max(1U, thread::hardware_concurrency());
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(shard.id % cores, &cpus);
+        if (auto err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)) {
+            LOG_WARN << "Failed to pin shard #" << shard.id << " to core " << (shard.id % cores)
+                     << ": " << strerror(err);
+        }
+    }
+#endif
+
+    // Keep the thread alive while the shard has no work
+    auto work = asio::make_work_guard(shard.ctx);
+
+    LOG_DEBUG_N << "starting shard " << shard.id;
+    while(!shard.ctx.stopped()) {
+        try {
+            ++running_io_threads_;
+            shard.ctx.run();
+            --running_io_threads_;
+        } catch (const std::exception& ex) {
+            --running_io_threads_;
+            LOG_ERROR << LogEvent::LE_IOTHREAD_THREW
+                      << "Caught exception from shard #" << shard.id
+                      << ": " << ex.what();
+        }
+    }
+
+    LOG_DEBUG_N << "Shard " << shard.id << " is done.";
+}
+
 void Server::runIoThread(const size_t id)
 {
     LOG_DEBUG_N << "starting io-thread " << id;
@@ -124,17 +483,36 @@ void Server::runIoThread(const size_t id)
 boost::asio::awaitable<bool> Server::checkDb()
 {
     LOG_TRACE_N << "Checking the database version...";
-    auto res = co_await db_->exec("SELECT version FROM nextapp");
-    if (res.has_value()) {
-        const auto version = res.rows().front().front().as_int64();
+
+    optional<int64_t> version;
+    if (memory_db_) {
+        auto res = co_await db().exec("SELECT version FROM nextapp");
+        if (!res.rows().empty()) {
+            version = res.rows().front().front().as_int64();
+        }
+    } else {
+        // On a connection of its own, so it doesn't wait for the pool to connect
+        auto cfg = config_.db;
+        cfg.max_connections = 1;
+
+        mysqlpool::Mysqlpool db{ctx_, cfg};
+        co_await db.init();
+        const auto res = co_await db.exec("SELECT version FROM nextapp");
+        co_await db.close();
+        if (!res.rows().empty()) {
+            version = res.rows().front().front().as_int64();
+        }
+    }
+
+    if (version) {
         LOG_DEBUG << "I need the database to be at version " << latest_version
-                  << ". The existing database is at version " << version << '.';
+                  << ". The existing database is at version " << *version << '.';
 
-        if (latest_version > version) {
-            co_await upgradeDbTables(version);
+        if (latest_version > *version) {
+            co_await upgradeDbTables(*version);
             co_return true;
         }
-        co_return version == latest_version;
+        co_return *version == latest_version;
     }
 
     co_return false;
@@ -352,10 +730,142 @@ boost::asio::awaitable<void> Server::upgradeDbTables(uint version)
          R"(CREATE INDEX action2location_ix2 ON action2location (location, action))",
     });
 
+    // Time spent is rolled up per user, node and period when rows in `work` are written,
+    // so that reports never have to scan the work table.
+    static constexpr auto v4_upgrade = to_array<string_view>({
+        R"(CREATE OR REPLACE TABLE time_spent (
+            user UUID NOT NULL,
+            period ENUM('day', 'week', 'month', 'quarter', 'year') NOT NULL,
+            start DATE NOT NULL,
+            node UUID NOT NULL,
+            used INTEGER NOT NULL DEFAULT 0,
+            paused INTEGER NOT NULL DEFAULT 0,
+            PRIMARY KEY (user, period, start, node),
+            FOREIGN KEY(user) REFERENCES user(id) ON DELETE CASCADE ON UPDATE RESTRICT,
+            FOREIGN KEY(node) REFERENCES node(id) ON DELETE CASCADE ON UPDATE RESTRICT))",
+
+        // Weeks start on Monday
+        R"(CREATE OR REPLACE FUNCTION period_start(p_period VARCHAR(8), p_day DATE) RETURNS DATE DETERMINISTIC
+            RETURN CASE p_period
+                WHEN 'day' THEN p_day
+                WHEN 'week' THEN p_day - INTERVAL WEEKDAY(p_day) DAY
+                WHEN 'month' THEN p_day - INTERVAL (DAYOFMONTH(p_day) - 1) DAY
+                WHEN 'quarter' THEN MAKEDATE(YEAR(p_day), 1) + INTERVAL (QUARTER(p_day) - 1) QUARTER
+                ELSE MAKEDATE(YEAR(p_day), 1)
+            END)",
+
+        // A work session is accounted for in the periods containing its start time
+        R"(CREATE OR REPLACE PROCEDURE add_time_spent(p_node UUID, p_when DATETIME, p_used INTEGER, p_paused INTEGER)
+            BEGIN
+                DECLARE v_user UUID;
+                DECLARE v_day DATE DEFAULT DATE(p_when);
+                SELECT user INTO v_user FROM node WHERE id = p_node;
+                INSERT INTO time_spent (user, period, start, node, used, paused) VALUES
+                    (v_user, 'day', period_start('day', v_day), p_node, p_used, p_paused),
+                    (v_user, 'week', period_start('week', v_day), p_node, p_used, p_paused),
+                    (v_user, 'month', period_start('month', v_day), p_node, p_used, p_paused),
+                    (v_user, 'quarter', period_start('quarter', v_day), p_node, p_used, p_paused),
+                    (v_user, 'year', period_start('year', v_day), p_node, p_used, p_paused)
+                ON DUPLICATE KEY UPDATE used = used + VALUES(used), paused = paused + VALUES(paused);
+            END)",
+
+        R"(CREATE OR REPLACE TRIGGER work_time_spent_ins AFTER INSERT ON work FOR EACH ROW
+            CALL add_time_spent(NEW.node, NEW.start, NEW.used, NEW.paused))",
+
+        R"(CREATE OR REPLACE TRIGGER work_time_spent_upd AFTER UPDATE ON work FOR EACH ROW
+            BEGIN
+                CALL add_time_spent(OLD.node, OLD.start, -OLD.used, -OLD.paused);
+                CALL add_time_spent(NEW.node, NEW.start, NEW.used, NEW.paused);
+            END)",
+
+        R"(CREATE OR REPLACE TRIGGER work_time_spent_del AFTER DELETE ON work FOR EACH ROW
+            CALL add_time_spent(OLD.node, OLD.start, -OLD.used, -OLD.paused))",
+
+        // Roll up any work that was registered before the triggers existed
+        R"(INSERT INTO time_spent (user, period, start, node, used, paused)
+            SELECT user, period, start, node, SUM(used), SUM(paused) FROM (
+                SELECT n.user, p.period, period_start(p.period, DATE(w.start)) AS start, w.node, w.used, w.paused
+                FROM work AS w
+                JOIN node AS n ON n.id = w.node
+                CROSS JOIN (SELECT 'day' AS period UNION ALL SELECT 'week' UNION ALL SELECT 'month'
+                            UNION ALL SELECT 'quarter' UNION ALL SELECT 'year') AS p
+            ) AS t GROUP BY user, period, start, node)",
+    });
+
+    // Day-score statistics are maintained by the server when days are written.
+    static constexpr auto v5_upgrade = to_array<string_view>({
+        R"(CREATE OR REPLACE TABLE day_stats (
+            user UUID NOT NULL,
+            year SMALLINT NOT NULL,
+            month TINYINT NOT NULL,
+            color UUID NOT NULL,
+            days INTEGER NOT NULL DEFAULT 0,
+            score INTEGER NOT NULL DEFAULT 0,
+            PRIMARY KEY (user, year, month, color),
+            FOREIGN KEY(user) REFERENCES user(id) ON DELETE CASCADE ON UPDATE RESTRICT,
+            FOREIGN KEY(color) REFERENCES day_colors(id) ON DELETE CASCADE ON UPDATE RESTRICT))",
+
+        // Consecutive days with a color that scores above zero
+        R"(CREATE OR REPLACE TABLE day_streak (
+            user UUID NOT NULL,
+            start DATE NOT NULL,
+            end DATE NOT NULL,
+            PRIMARY KEY (user, start),
+            UNIQUE INDEX day_streak_ix2 (user, end),
+            FOREIGN KEY(user) REFERENCES user(id) ON DELETE CASCADE ON UPDATE RESTRICT))",
+
+        R"(INSERT INTO day_stats (user, year, month, color, days, score)
+            SELECT d.user, YEAR(d.date), MONTH(d.date), d.color, COUNT(*), SUM(c.score)
+            FROM day AS d JOIN day_colors AS c ON c.id = d.color
+            GROUP BY d.user, YEAR(d.date), MONTH(d.date), d.color)",
+
+        R"(INSERT INTO day_streak (user, start, end)
+            SELECT user, MIN(date), MAX(date) FROM (
+                SELECT d.user, d.date, d.date - INTERVAL ROW_NUMBER() OVER (PARTITION BY d.user ORDER BY d.date) DAY AS grp
+                FROM day AS d JOIN day_colors AS c ON c.id = d.color
+                WHERE c.score > 0
+            ) AS t GROUP BY user, grp)",
+    });
+
+    // Bulk loads set @nextapp_bulk_load and roll up the time spent when the rows are loaded
+    static constexpr auto v6_upgrade = to_array<string_view>({
+        R"(CREATE OR REPLACE TRIGGER work_time_spent_ins AFTER INSERT ON work FOR EACH ROW
+            IF @nextapp_bulk_load IS NULL THEN
+                CALL add_time_spent(NEW.node, NEW.start, NEW.used, NEW.paused);
+            END IF)",
+    });
+
+    // The score applied to a day is kept with the day, so that the statistics can be
+    // updated correctly after the score for a color is changed.
+    static constexpr auto v7_upgrade = to_array<string_view>({
+        "ALTER TABLE day ADD COLUMN score INTEGER",
+
+        "UPDATE day AS d JOIN day_colors AS c ON c.id = d.color SET d.score = c.score",
+
+        "DELETE FROM day_stats",
+
+        R"(INSERT INTO day_stats (user, year, month, color, days, score)
+            SELECT user, YEAR(date), MONTH(date), color, COUNT(*), SUM(score)
+            FROM day WHERE color IS NOT NULL
+            GROUP BY user, YEAR(date), MONTH(date), color)",
+
+        "DELETE FROM day_streak",
+
+        R"(INSERT INTO day_streak (user, start, end)
+            SELECT user, MIN(date), MAX(date) FROM (
+                SELECT user, date, date - INTERVAL ROW_NUMBER() OVER (PARTITION BY user ORDER BY date) DAY AS grp
+                FROM day WHERE score > 0
+            ) AS t GROUP BY user, grp)",
+    });
+
     static constexpr auto versions = to_array<span<const string_view>>({
         v1_bootstrap,
         v2_upgrade,
         v3_upgrade,
+        v4_upgrade,
+        v5_upgrade,
+        v6_upgrade,
+        v7_upgrade,
     });
 
     LOG_INFO << "Will upgrade the database structure from version " << version
@@ -389,6 +899,17 @@ boost::asio::awaitable<void> Server::startGrpcService()
     co_return;
 }
 
+void Server::startMetricsService()
+{
+    if (config().svr.metrics_endpoint.empty()) {
+        LOG_DEBUG_N << "The metrics endpoint is disabled.";
+        return;
+    }
+
+    metrics_service_.emplace(ctx_, metrics_);
+    metrics_service_->start(config().svr.metrics_endpoint);
+}
+
 void Server::handleSignals()
 {
     if (is_done()) {
@@ -416,7 +937,7 @@ void Server::handleSignals()
 
         LOG_INFO << "Server::handleSignals: Received signal #" << signalNumber;
         if (signalNumber == SIGHUP) {
-            LOG_WARN << "Server::handleSignals: Ignoring SIGHUP. Note - config is not re-loaded.";
+            reloadConfig();
         } else if (signalNumber == SIGQUIT || signalNumber == SIGINT) {
             if (!is_done()) {
                 LOG_INFO_N << "Stopping the services.";
@@ -430,4 +951,130 @@ void Server::handleSignals()
     });
 }
 
+void Server::setupLogging(const LogConfig &config)
+{
+    auto& manager = logfault::LogManager::Instance();
+    manager.ClearHandlers();
+
+    if (auto level = toLogLevel(config.console_level)) {
+        manager.AddHandler(make_unique<logfault::StreamHandler>(clog, *level));
+    }
+
+    if (!config.file.empty()) {
+        if (auto level = toLogLevel(config.level)) {
+            manager.AddHandler(make_unique<logfault::StreamHandler>(config.file, *level, config.truncate));
+        }
+    }
+}
+
+void Server::reloadConfig()
+{
+    if (!config_loader_) {
+        LOG_WARN_N << "Ignoring SIGHUP. There is no configuration to reload.";
+        return;
+    }
+
+    // Nothing is changed unless all of the configuration is valid
+    Config next;
+    try {
+        next = config_loader_();
+    } catch (const exception& ex) {
+        LOG_ERROR << "Failed to reload the configuration. Keeping the current settings: " << ex.what();
+        return;
+    }
+
+    auto& cur = active_config_;
+    vector<string_view> applied;
+    vector<string_view> ignored;
+
+    const auto changed = [](vector<string_view>& changes, string_view name, const auto& from, const auto& to) {
+        if (from == to) {
+            return false;
+        }
+        changes.emplace_back(name);
+        return true;
+    };
+
+    // Settings that can be changed in a running server
+    if (changed(applied, "log", cur.log, next.log)) {
+        cur.log = next.log;
+        // Don't wipe the log we are already writing to
+        auto log = next.log;
+        log.truncate = false;
+        setupLogging(log);
+    }
+
+    bool limits = changed(applied, "grpc-max-in-flight", cur.grpc.max_in_flight, next.grpc.max_in_flight);
+    limits = changed(applied, "grpc-rate-limit", cur.grpc.rate_limit, next.grpc.rate_limit) || limits;
+    limits = changed(applied, "grpc-rate-limit-burst", cur.grpc.rate_limit_burst, next.grpc.rate_limit_burst) || limits;
+    if (limits) {
+        cur.grpc.max_in_flight = next.grpc.max_in_flight;
+        cur.grpc.rate_limit = next.grpc.rate_limit;
+        cur.grpc.rate_limit_burst = next.grpc.rate_limit_burst;
+        if (grpc_service_) {
+            grpc_service_->admission().setConfig({cur.grpc.rate_limit,
+                                                  cur.grpc.rate_limit_burst,
+                                                  cur.grpc.max_in_flight});
+        }
+    }
+
+    if (changed(applied, "trace-sample-rate", cur.trace.sample_rate, next.trace.sample_rate)) {
+        cur.trace.sample_rate = next.trace.sample_rate;
+        tracer_.setSampleRate(cur.trace.sample_rate);
+    }
+
+    if (changed(applied, "slow-query-ms", cur.slow_query.threshold_ms, next.slow_query.threshold_ms)) {
+        cur.slow_query.threshold_ms = next.slow_query.threshold_ms;
+        slow_query_log_.setThreshold(chrono::milliseconds{cur.slow_query.threshold_ms});
+    }
+
+    // Settings that are used when the server starts. They are reported on each
+    // reload until the server is restarted.
+    changed(ignored, "io-threads", cur.svr.io_threads, next.svr.io_threads);
+    changed(ignored, "thread-per-core", cur.svr.thread_per_core, next.svr.thread_per_core);
+    changed(ignored, "pin-threads", cur.svr.pin_threads, next.svr.pin_threads);
+    changed(ignored, "db-threads", cur.svr.db_threads, next.svr.db_threads);
+    changed(ignored, "cpu-threads", cur.svr.cpu_threads, next.svr.cpu_threads);
+    changed(ignored, "executor-lag-warn-ms", cur.svr.executor_lag_warn_ms, next.svr.executor_lag_warn_ms);
+    changed(ignored, "metrics-endpoint", cur.svr.metrics_endpoint, next.svr.metrics_endpoint);
+    changed(ignored, "grpc-address", cur.grpc.address, next.grpc.address);
+    changed(ignored, "trace-file", cur.trace.path, next.trace.path);
+    changed(ignored, "slow-query-log", cur.slow_query.path, next.slow_query.path);
+    changed(ignored, "slow-query-log-size-mb", cur.slow_query.max_size_mb, next.slow_query.max_size_mb);
+    changed(ignored, "slow-query-log-files", cur.slow_query.max_files, next.slow_query.max_files);
+    changed(ignored, "record-traffic", cur.record.path, next.record.path);
+    changed(ignored, "record-payloads", cur.record.payloads, next.record.payloads);
+    changed(ignored, "db-user", cur.db.username, next.db.username);
+    changed(ignored, "db-passwd", cur.db.password, next.db.password);
+    changed(ignored, "db-name", cur.db.database, next.db.database);
+    changed(ignored, "db-host", cur.db.host, next.db.host);
+    changed(ignored, "db-port", cur.db.port, next.db.port);
+    // The pool can not be resized after it is created
+    changed(ignored, "db-max-connections", cur.db.max_connections, next.db.max_connections);
+    changed(ignored, "db-retry-connect", cur.db.retry_connect, next.db.retry_connect);
+    changed(ignored, "db-retry-delay", cur.db.retry_connect_delay_ms, next.db.retry_connect_delay_ms);
+
+    const auto list = [](const vector<string_view>& names) {
+        string rval;
+        for(const auto name : names) {
+            if (!rval.empty()) {
+                rval += ", ";
+            }
+            rval += name;
+        }
+        return rval;
+    };
+
+    if (applied.empty()) {
+        LOG_INFO << "Reloaded the configuration. No changes to apply.";
+    } else {
+        LOG_INFO << "Reloaded the configuration. Applied: " << list(applied);
+    }
+
+    if (!ignored.empty()) {
+        LOG_WARN << "These changes require a restart of the server, and are ignored until then: "
+                 << list(ignored);
+    }
+}
+
 }
@@ -0,0 +1,152 @@
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <format>
+#include <functional>
+
+#include <boost/json.hpp>
+
+#include "nextapp/SlowQueryLog.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+namespace json = boost::json;
+
+namespace nextapp {
+
+namespace {
+
+double toMs(SlowQueryLog::duration_t duration) {
+    return chrono::duration<double, milli>(duration).count();
+}
+
+// Only these statements can be explained
+bool canExplain(string_view query) {
+    const auto start = query.find_first_not_of(" \t\r\n(");
+    if (start == string_view::npos) {
+        return false;
+    }
+    const auto word = query.substr(start, 6);
+    for(const auto *prefix : {"SELECT", "WITH", "UPDATE", "DELETE"}) {
+        const string_view p{prefix};
+        if (word.size() >= p.size() && ranges::equal(word.substr(0, p.size()), p, [](char a, char b) {
+                return toupper(static_cast<unsigned char>(a)) == b;
+            })) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // anon ns
+
+SlowQueryLog::SlowQueryLog(const SlowQueryConfig &config)
+    : config_{config}, threshold_ms_{static_cast<chrono::milliseconds::rep>(config.threshold_ms)}
+{
+}
+
+void SlowQueryLog::open()
+{
+    // The file is opened even if the log is disabled, so it can be enabled on SIGHUP
+    if (!threshold_ms_) {
+        LOG_DEBUG_N << "The slow-query log is disabled.";
+    }
+
+    if (config_.path.empty()) {
+        if (threshold_ms_) {
+            LOG_INFO << "Logging queries slower than " << threshold_ms_ << " ms to the application log";
+        }
+        return;
+    }
+
+    lock_guard lock{mutex_};
+    out_.open(config_.path, ios::out | ios::app);
+    if (!out_) {
+        throw runtime_error{format("Failed to open the slow-query log '{}'", config_.path)};
+    }
+    size_ = static_cast<size_t>(out_.tellp());
+    if (threshold_ms_) {
+        LOG_INFO << "Logging queries slower than " << threshold_ms_ << " ms to " << config_.path;
+    }
+}
+
+bool SlowQueryLog::shouldExplain(std::string_view query)
+{
+    if (!canExplain(query)) {
+        return false;
+    }
+
+    lock_guard lock{mutex_};
+    return explained_.insert(hash<string_view>{}(query)).second;
+}
+
+void SlowQueryLog::write(const Entry &entry)
+{
+    ++count_;
+
+    json::object o;
+    o["time"] = format("{:%FT%TZ}", chrono::floor<chrono::milliseconds>(chrono::system_clock::now()));
+    o["duration_ms"] = toMs(entry.duration);
+    o["pool_wait_ms"] = toMs(entry.pool_wait);
+    o["query"] = entry.query;
+
+    json::array params;
+    for(const auto& param : entry.params) {
+        params.emplace_back(param);
+    }
+    o["params"] = std::move(params);
+
+    if (!entry.trace_id.empty()) {
+        o["trace_id"] = entry.trace_id;
+    }
+
+    if (entry.explain) {
+        boost::system::error_code ec;
+        auto plan = json::parse(*entry.explain, ec);
+        if (ec) {
+            o["explain"] = *entry.explain;
+        } else {
+            o["explain"] = std::move(plan);
+        }
+    }
+
+    const auto line = json::serialize(o);
+
+    lock_guard lock{mutex_};
+    if (!out_.is_open()) {
+        LOG_WARN << "Slow query: " << line;
+        return;
+    }
+
+    if (size_ + line.size() + 1 > config_.max_size_mb * 1024 * 1024) {
+        rotate();
+    }
+
+    out_ << line << '\n';
+    out_.flush();
+    size_ += line.size() + 1;
+}
+
+void SlowQueryLog::rotate()
+{
+    // slow.log -> slow.log.1 -> slow.log.2 ... The oldest is overwritten.
+    out_.close();
+
+    std::error_code ec;
+    for(auto i = config_.max_files; i > 0; --i) {
+        const auto from = i == 1 ? config_.path : format("{}.{}", config_.path, i - 1);
+        filesystem::rename(from, format("{}.{}", config_.path, i), ec);
+    }
+    if (!config_.max_files) {
+        filesystem::remove(config_.path, ec);
+    }
+
+    out_.open(config_.path, ios::out | ios::trunc);
+    size_ = 0;
+    if (!out_) {
+        LOG_ERROR << "Failed to re-open the slow-query log " << config_.path;
+    }
+}
+
+} // ns
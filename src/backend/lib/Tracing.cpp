@@ -0,0 +1,304 @@
+
+#include <chrono>
+#include <format>
+#include <random>
+
+#include <boost/json.hpp>
+
+#include "nextapp/Tracing.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+namespace json = boost::json;
+
+namespace nextapp {
+
+namespace {
+
+// Keeps a single span from blowing up the size of a trace, like a huge INSERT statement
+constexpr size_t max_attr_len = 512;
+
+uint64_t thresholdFor(double rate) {
+    if (rate <= 0.0) {
+        return 0;
+    }
+    if (rate >= 1.0) {
+        return numeric_limits<uint64_t>::max();
+    }
+    return static_cast<uint64_t>(rate * static_cast<double>(numeric_limits<uint64_t>::max()));
+}
+
+json::object toJson(const array<uint64_t, 2>& traceId, const Trace::SpanData& span) {
+    json::object o;
+    o["traceId"] = format("{:016x}{:016x}", traceId[0], traceId[1]);
+    o["spanId"] = format("{:016x}", span.id);
+    if (span.parent_id) {
+        o["parentSpanId"] = format("{:016x}", span.parent_id);
+    }
+    o["name"] = span.name;
+    o["kind"] = static_cast<int>(span.kind);
+    o["startTimeUnixNano"] = to_string(span.start_ns);
+    o["endTimeUnixNano"] = to_string(span.end_ns);
+
+    if (!span.attributes.empty()) {
+        json::array attrs;
+        for(const auto& [key, value] : span.attributes) {
+            attrs.emplace_back(json::object{{"key", key}, {"value", json::object{{"stringValue", value}}}});
+        }
+        o["attributes"] = std::move(attrs);
+    }
+
+    // STATUS_CODE_ERROR is 2. Unset is the default for spans that did not fail.
+    if (span.failed) {
+        o["status"] = json::object{{"code", 2}, {"message", span.message}};
+    }
+    return o;
+}
+
+} // anon ns
+
+thread_local Trace *Trace::current_ = nullptr;
+
+Trace::Trace(Tracer &tracer, uint64_t idHigh, std::string_view name)
+    : tracer_{tracer}, id_{idHigh, Tracer::random()}, root_id_{Tracer::random()}
+{
+    spans_.reserve(8);
+    auto& root = spans_.emplace_back();
+    root.name = name;
+    root.id = root_id_;
+    root.kind = Kind::SERVER;
+    root.start_ns = Tracer::nowNs();
+}
+
+Trace::~Trace()
+{
+    if (!spans_.front().end_ns) {
+        spans_.front().end_ns = Tracer::nowNs();
+    }
+    tracer_.submit({id_, std::move(spans_)});
+}
+
+void Trace::finish(bool ok, std::string_view message)
+{
+    lock_guard lock{mutex_};
+    auto& root = spans_.front();
+    root.end_ns = Tracer::nowNs();
+    if (!ok) {
+        root.failed = true;
+        root.message = message;
+    }
+}
+
+void Trace::add(SpanData &&span)
+{
+    lock_guard lock{mutex_};
+    spans_.emplace_back(std::move(span));
+}
+
+string Trace::id() const
+{
+    return format("{:016x}{:016x}", id_[0], id_[1]);
+}
+
+Span::Span(std::string_view name, Trace::Kind kind)
+{
+    if (trace_) {
+        data_.name = name;
+        data_.id = Tracer::random();
+        data_.parent_id = trace_->rootSpanId();
+        data_.kind = kind;
+        data_.start_ns = Tracer::nowNs();
+    }
+}
+
+Span::~Span()
+{
+    if (trace_) {
+        data_.end_ns = Tracer::nowNs();
+        trace_->add(std::move(data_));
+    }
+}
+
+Span &Span::attr(std::string_view key, std::string_view value)
+{
+    if (trace_) {
+        data_.attributes.emplace_back(key, value.substr(0, max_attr_len));
+    }
+    return *this;
+}
+
+Span &Span::attr(std::string_view key, int64_t value)
+{
+    if (trace_) {
+        data_.attributes.emplace_back(key, to_string(value));
+    }
+    return *this;
+}
+
+void Span::fail(std::string_view message)
+{
+    if (trace_) {
+        data_.failed = true;
+        data_.message = message.substr(0, max_attr_len);
+    }
+}
+
+Tracer::Tracer(const TraceConfig &config)
+    : config_{config}, threshold_{thresholdFor(config.sample_rate)}
+{
+}
+
+Tracer::~Tracer()
+{
+    stop();
+}
+
+void Tracer::start()
+{
+    if (config_.path.empty()) {
+        LOG_DEBUG_N << "Tracing is disabled.";
+        return;
+    }
+
+    out_.open(config_.path, ios::out | ios::app);
+    if (!out_) {
+        throw runtime_error{format("Failed to open the trace file '{}'", config_.path)};
+    }
+
+    running_ = true;
+    writer_ = jthread{[this](stop_token token) {
+        run(token);
+    }};
+
+    LOG_INFO << "Tracing " << (config_.sample_rate * 100.0) << "% of the requests to " << config_.path;
+}
+
+void Tracer::stop()
+{
+    running_ = false;
+    if (writer_.joinable()) {
+        writer_.request_stop();
+        writer_.join();
+    }
+}
+
+void Tracer::setSampleRate(double rate) noexcept
+{
+    threshold_ = thresholdFor(rate);
+}
+
+std::shared_ptr<Trace> Tracer::startTrace(std::string_view name)
+{
+    if (!enabled()) {
+        return {};
+    }
+
+    // The first half of the trace-id decides if it's sampled, so unsampled
+    // requests cost one random number.
+    const auto high = random();
+    const auto threshold = threshold_.load(std::memory_order_relaxed);
+    if (!threshold || high > threshold) {
+        return {};
+    }
+
+    return make_shared<Trace>(*this, high, name);
+}
+
+uint64_t Tracer::random() noexcept
+{
+    thread_local std::mt19937_64 rnd{(uint64_t{std::random_device{}()} << 32) | std::random_device{}()};
+    uint64_t val;
+    do {
+        val = rnd();
+    } while (!val); // Zero is not a valid id in OTLP
+    return val;
+}
+
+uint64_t Tracer::nowNs() noexcept
+{
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::system_clock::now().time_since_epoch()).count());
+}
+
+void Tracer::submit(Pending &&trace)
+{
+    // Tracing must never slow down or block the requests
+    static constexpr size_t max_pending = 10000;
+
+    {
+        lock_guard lock{mutex_};
+        if (!running_ || pending_.size() >= max_pending) {
+            ++dropped_;
+            return;
+        }
+        pending_.emplace_back(std::move(trace));
+    }
+    cv_.notify_one();
+}
+
+void Tracer::write(std::deque<Pending> &batch)
+{
+    json::array spans;
+    for(const auto& trace : batch) {
+        for(const auto& span : trace.spans) {
+            spans.emplace_back(toJson(trace.id, span));
+        }
+    }
+
+    json::object resource{{"attributes", json::array{
+        json::object{{"key", "service.name"}, {"value", json::object{{"stringValue", "nextappd"}}}},
+        json::object{{"key", "service.version"}, {"value", json::object{{"stringValue", NEXTAPP_VERSION}}}}
+    }}};
+
+    json::object scope_spans{{"scope", json::object{{"name", "nextapp"}}},
+                             {"spans", std::move(spans)}};
+
+    json::object request{{"resourceSpans", json::array{
+        json::object{{"resource", std::move(resource)},
+                     {"scopeSpans", json::array{std::move(scope_spans)}}}
+    }}};
+
+    out_ << json::serialize(request) << '\n';
+    out_.flush();
+    if (!out_) {
+        LOG_WARN_N << "Failed to write to the trace file " << config_.path;
+        out_.clear();
+    }
+
+    exported_ += batch.size();
+    batch.clear();
+}
+
+void Tracer::run(std::stop_token token)
+{
+    // Collect the traces for a while, so each line in the file has a batch of them
+    static constexpr auto flush_interval = 1s;
+    static constexpr size_t batch_size = 256;
+
+    std::deque<Pending> batch;
+    while(true) {
+        {
+            unique_lock lock{mutex_};
+            cv_.wait_for(lock, token, flush_interval, [this] {
+                return pending_.size() >= batch_size;
+            });
+            batch.swap(pending_);
+        }
+
+        if (!batch.empty()) {
+            try {
+                write(batch);
+            } catch (const exception& ex) {
+                LOG_WARN_N << "Failed to export traces: " << ex.what();
+                dropped_ += batch.size();
+                batch.clear();
+            }
+        }
+
+        if (token.stop_requested()) {
+            break;
+        }
+    }
+}
+
+} // ns
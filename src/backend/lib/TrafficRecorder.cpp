@@ -0,0 +1,168 @@
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <boost/uuid/name_generator_sha1.hpp>
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include "nextapp/TrafficRecorder.h"
+#include "nextapp/logging.h"
+#include "nextapp.pb.h"
+
+using namespace std;
+using google::protobuf::FieldDescriptor;
+using google::protobuf::Message;
+
+namespace nextapp {
+
+namespace {
+
+TrafficRecorder::Payloads toPayloads(const string& name) {
+    if (name.empty() || name == "none") {
+        return TrafficRecorder::Payloads::NONE;
+    }
+    if (name == "anonymized") {
+        return TrafficRecorder::Payloads::ANONYMIZED;
+    }
+    if (name == "raw") {
+        return TrafficRecorder::Payloads::RAW;
+    }
+    throw runtime_error{format("Invalid value for --record-payloads: '{}'", name)};
+}
+
+bool isUuid(string_view value) {
+    if (value.size() != 36) {
+        return false;
+    }
+    for(size_t i = 0; i < value.size(); ++i) {
+        if (i == 8 || i == 13 || i == 18 || i == 23) {
+            if (value[i] != '-') {
+                return false;
+            }
+        } else if (!isxdigit(static_cast<unsigned char>(value[i]))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A new random namespace for each run, so the anonymized uuid's can not be
+// looked up from a list of known uuid's.
+const boost::uuids::uuid& anonymousNs() {
+    static const auto ns = boost::uuids::random_generator{}();
+    return ns;
+}
+
+string anonymized(const string& value) {
+    if (isUuid(value)) {
+        return boost::uuids::to_string(boost::uuids::name_generator_sha1{anonymousNs()}(value));
+    }
+    return string(value.size(), 'x');
+}
+
+uint32_t toUs(TrafficRecorder::clock_t::duration duration) {
+    const auto us = chrono::duration_cast<chrono::microseconds>(duration).count();
+    return static_cast<uint32_t>(clamp<decltype(us)>(us, 0, numeric_limits<uint32_t>::max()));
+}
+
+} // anon ns
+
+TrafficRecorder::TrafficRecorder(const RecordConfig &config)
+    : config_{config}, payloads_{toPayloads(config.payloads)}
+{
+}
+
+void TrafficRecorder::open()
+{
+    if (config_.path.empty()) {
+        LOG_DEBUG_N << "Traffic recording is disabled.";
+        return;
+    }
+
+    lock_guard lock{mutex_};
+    out_.open(config_.path, ios::out | ios::app | ios::binary);
+    if (!out_) {
+        throw runtime_error{format("Failed to open the traffic recording '{}'", config_.path)};
+    }
+    enabled_ = true;
+    LOG_INFO << "Recording the requests to " << config_.path << " with payloads: " << config_.payloads;
+}
+
+void TrafficRecorder::record(std::string_view method, std::string_view user, clock_t::time_point arrived,
+                             clock_t::duration duration, int status, const google::protobuf::Message &request,
+                             size_t replySize)
+{
+    pb::TrafficRecord rec;
+    rec.set_offsetus(static_cast<uint64_t>(
+        chrono::duration_cast<chrono::microseconds>(max(arrived - start_, clock_t::duration::zero())).count()));
+    rec.set_method(string{method});
+    rec.set_user(payloads_ == Payloads::RAW ? string{user} : anonymized(string{user}));
+    rec.set_requestsize(static_cast<uint32_t>(request.ByteSizeLong()));
+    rec.set_replysize(static_cast<uint32_t>(replySize));
+    rec.set_durationus(toUs(duration));
+    rec.set_status(status);
+
+    switch(payloads_) {
+    case Payloads::NONE:
+        break;
+    case Payloads::RAW:
+        request.SerializeToString(rec.mutable_payload());
+        break;
+    case Payloads::ANONYMIZED: {
+        unique_ptr<Message> copy{request.New()};
+        copy->CopyFrom(request);
+        anonymize(*copy);
+        copy->SerializeToString(rec.mutable_payload());
+    } break;
+    }
+
+    lock_guard lock{mutex_};
+    if (!google::protobuf::util::SerializeDelimitedToOstream(rec, &out_)) {
+        LOG_WARN_N << "Failed to write to the traffic recording " << config_.path << ". Recording stopped.";
+        enabled_ = false;
+        return;
+    }
+    ++count_;
+}
+
+void TrafficRecorder::anonymize(google::protobuf::Message &message)
+{
+    const auto *refl = message.GetReflection();
+    vector<const FieldDescriptor *> fields;
+    refl->ListFields(message, &fields);
+
+    for(const auto *field : fields) {
+        switch(field->cpp_type()) {
+        case FieldDescriptor::CPPTYPE_MESSAGE:
+            if (field->is_repeated()) {
+                for(int i = 0; i < refl->FieldSize(message, field); ++i) {
+                    anonymize(*refl->MutableRepeatedMessage(&message, field, i));
+                }
+            } else {
+                anonymize(*refl->MutableMessage(&message, field));
+            }
+            break;
+        case FieldDescriptor::CPPTYPE_STRING:
+            if (field->is_repeated()) {
+                for(int i = 0; i < refl->FieldSize(message, field); ++i) {
+                    refl->SetRepeatedString(&message, field, i, anonymized(refl->GetRepeatedString(message, field, i)));
+                }
+            } else {
+                refl->SetString(&message, field, anonymized(refl->GetString(message, field)));
+            }
+            break;
+        default:
+            // Numbers, enums and flags are kept. They are needed to replay the
+            // request, and say little about the user.
+            break;
+        }
+    }
+}
+
+} // ns
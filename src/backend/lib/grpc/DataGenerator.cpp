@@ -0,0 +1,364 @@
+
+#include <array>
+#include <cstdio>
+#include <format>
+
+#include <boost/uuid/uuid_io.hpp>
+
+#include "nextapp/DataGenerator.h"
+#include "nextapp/GrpcServer.h"
+#include "nextapp/TenantIo.h"
+#include "nextapp/logging.h"
+#include "nextapp.pb.h"
+
+using namespace std;
+
+namespace nextapp::grpc {
+
+namespace {
+
+struct Index {
+    string_view name;
+    string_view columns;
+};
+
+// The secondary indexes on `action`, as they are created in the schema
+constexpr auto action_indexes = to_array<Index>({
+    {"action_ix2", "user, status, due_by_time"},
+    {"action_ix3", "origin"},
+    {"action_ix4", "node, status, due_by_time"},
+});
+
+constexpr auto difficulties = to_array<string_view>({"trivial", "easy", "normal", "hard", "veryhard", "inspired"});
+
+chrono::sys_days toEndDate(const string& date) {
+    if (date.empty()) {
+        return chrono::floor<chrono::days>(chrono::system_clock::now());
+    }
+
+    int y = 0;
+    unsigned m = 0, d = 0;
+    if (sscanf(date.c_str(), "%d-%u-%u", &y, &m, &d) != 3) {
+        throw runtime_error{format("Invalid end date '{}'. Use YYYY-MM-DD", date)};
+    }
+    const chrono::year_month_day ymd{chrono::year{y}, chrono::month{m}, chrono::day{d}};
+    if (!ymd.ok()) {
+        throw runtime_error{format("Invalid end date '{}'. Use YYYY-MM-DD", date)};
+    }
+    return ymd;
+}
+
+string toDateTime(chrono::sys_seconds when) {
+    return format("{:%F %T}", when);
+}
+
+double secondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+} // anon ns
+
+DataGenerator::DataGenerator(Server &server, const DataGenConfig &config)
+    : server_{server}, config_{config}
+    , end_date_{toEndDate(config.end_date)}
+    , first_date_{end_date_ - chrono::days(config.years * 365 - 1)}
+    , rng_{config.seed}
+    , tenants_{"INSERT INTO tenant (id, name, kind, descr, active, properties) VALUES ", config.batch_size}
+    , users_{"INSERT INTO user (id, tenant, name, email, kind, active, descr, properties) VALUES ", config.batch_size}
+    , nodes_{"INSERT INTO node (id, user, name, kind, descr, active, parent, version) VALUES ", config.batch_size}
+    , actions_{R"(INSERT INTO action (id, node, user, priority, status, name, created_date,
+        due_type, due_by_time, completed_time, completed, time_estimate, difficulty) VALUES )", config.batch_size}
+    , days_{"INSERT INTO day (date, user, color, notes, report) VALUES ", config.batch_size}
+    , work_{"INSERT INTO work (id, node, start, end, used, paused, name) VALUES ", config.batch_size}
+{
+    if (config.uuid_version == "v4") {
+        time_ordered_ = false;
+    } else if (config.uuid_version != "v7") {
+        throw runtime_error{format("Invalid uuid version '{}'. Use v4 or v7", config.uuid_version)};
+    }
+}
+
+boost::asio::awaitable<void> DataGenerator::run()
+{
+    const auto start = chrono::steady_clock::now();
+    LOG_INFO << "Generating " << config_.tenants << " tenants with " << config_.users
+             << " users each, with seed " << config_.seed << " and " << config_.uuid_version << " ids.";
+
+    co_await prepare();
+
+    // The checks and indexes are restored, also if the load fails
+    string error;
+    try {
+        for(size_t t = 0; t < config_.tenants; ++t) {
+            co_await generateTenant(t);
+        }
+    } catch (const exception& ex) {
+        error = ex.what();
+        LOG_ERROR << "Failed to generate the data: " << error;
+    }
+
+    LOG_INFO << "Building the indexes...";
+    try {
+        co_await restore();
+    } catch (const exception& ex) {
+        LOG_ERROR << "Failed to restore the indexes on `action`: " << ex.what()
+                  << ". Run --bootstrap --generate-data again to create them.";
+        throw;
+    }
+    handle_.reset();
+
+    if (!error.empty()) {
+        throw runtime_error{format("Failed to generate the data after {}: {}", summary(), error)};
+    }
+
+    const auto elapsed = secondsSince(start);
+    LOG_INFO << "Generated " << summary() << " with " << config_.uuid_version << " ids in "
+             << format("{:.1f} seconds ({:.0f} rows/sec).", elapsed,
+                       static_cast<double>(counts_.total()) / std::max(elapsed, 0.001));
+}
+
+std::string DataGenerator::summary() const
+{
+    return format("{} rows; {} tenants, {} users, {} nodes, {} actions, {} days and {} work sessions",
+                  counts_.total(), counts_.tenants, counts_.users, counts_.nodes,
+                  counts_.actions, counts_.days, counts_.work);
+}
+
+boost::asio::awaitable<void> DataGenerator::prepare()
+{
+    handle_.emplace(co_await server_.db().getConnection());
+
+    co_await handle_->exec("SET SESSION foreign_key_checks=0");
+    co_await handle_->exec("SET SESSION unique_checks=0");
+    co_await handle_->exec("SET @nextapp_bulk_load=1");
+
+    // InnoDB builds an index much faster from all the rows than one row at the time
+    for(const auto& index : action_indexes) {
+        co_await handle_->exec(format("DROP INDEX IF EXISTS {} ON action", index.name));
+    }
+
+    const auto res = co_await handle_->exec("SELECT id FROM day_colors WHERE tenant IS NULL ORDER BY id");
+    for(const auto& row : res.rows()) {
+        colors_.emplace_back(row.at(0).as_string());
+    }
+    if (colors_.empty()) {
+        throw runtime_error{"There are no day colors in the database"};
+    }
+}
+
+boost::asio::awaitable<void> DataGenerator::restore()
+{
+    for(const auto& index : action_indexes) {
+        co_await handle_->exec(format("CREATE INDEX IF NOT EXISTS {} ON action ({})", index.name, index.columns));
+    }
+
+    co_await handle_->exec("SET @nextapp_bulk_load=NULL");
+    co_await handle_->exec("SET SESSION unique_checks=1");
+    co_await handle_->exec("SET SESSION foreign_key_checks=1");
+}
+
+boost::asio::awaitable<void> DataGenerator::generateTenant(size_t tenantIx)
+{
+    const auto start = chrono::steady_clock::now();
+    const auto rows_before = counts_.total();
+
+    const auto tenant = uuid(first_date_);
+    tenants_.add(tenant,
+                 format("generated-{}", tenantIx),
+                 "regular",
+                 "Generated data for performance tests",
+                 true,
+                 "{}");
+    ++counts_.tenants;
+
+    for(size_t u = 0; u < config_.users; ++u) {
+        co_await generateUser(tenant, tenantIx, u);
+    }
+    co_await flush();
+
+    co_await rebuildDayStats(*handle_, tenant);
+    co_await rebuildTimeSpent(*handle_, tenant);
+
+    const auto elapsed = secondsSince(start);
+    const auto rows = counts_.total() - rows_before;
+    LOG_INFO << format("Tenant {}/{}: {} rows in {:.1f} seconds ({:.0f} rows/sec)",
+                       tenantIx + 1, config_.tenants, rows, elapsed,
+                       static_cast<double>(rows) / std::max(elapsed, 0.001));
+}
+
+boost::asio::awaitable<void> DataGenerator::generateUser(const std::string &tenant, size_t tenantIx, size_t userIx)
+{
+    const auto user = uuid(first_date_);
+    users_.add(user,
+               tenant,
+               format("User {}-{}", tenantIx, userIx),
+               format("user-{}-{}@example.com", tenantIx, userIx),
+               "regular",
+               true,
+               nullopt,
+               "{}");
+    ++counts_.users;
+
+    // The tree, one level at the time. The parents are inserted before their children.
+    vector<string> parents{""};
+    for(size_t level = 0; level < config_.depth; ++level) {
+        const bool leaf = level + 1 == config_.depth;
+        vector<string> children;
+        children.reserve(parents.size() * config_.fanout);
+        for(const auto& parent : parents) {
+            for(size_t i = 0; i < config_.fanout; ++i) {
+                const auto& node = children.emplace_back(uuid(first_date_));
+                const auto kind = leaf ? pb::Node::TASK : static_cast<pb::Node::Kind>(random(pb::Node::FOLDER, pb::Node::PROJECT));
+                nodes_.add(node,
+                           user,
+                           format("Node {}.{}", level, children.size()),
+                           static_cast<int>(kind),
+                           nullopt,
+                           true,
+                           parent.empty() ? nullopt : optional<string>{parent},
+                           1);
+                ++counts_.nodes;
+                addActions(node, user);
+                co_await flushIfFull();
+            }
+        }
+        parents = std::move(children);
+    }
+
+    addDays(user);
+    co_await flushIfFull();
+
+    // The work is done on the leaf nodes
+    if (config_.depth) {
+        addWork(parents);
+    }
+    co_await flushIfFull();
+}
+
+void DataGenerator::addActions(const std::string &node, const std::string &user)
+{
+    const auto days = static_cast<int>(config_.years * 365);
+    for(size_t i = 0; i < config_.actions; ++i) {
+        const auto created = end_date_ - chrono::days(random(0, days));
+        const auto due = created + chrono::days(random(0, 60));
+
+        // Most of the old actions are done
+        const auto r = random(0, 99);
+        const string_view status = r < 60 ? "done" : r < 95 ? "active" : "onhold";
+        const bool done = status == "done";
+        const auto completed = chrono::sys_seconds{created + chrono::days(random(0, 30))} + chrono::hours(random(8, 20));
+
+        actions_.add(uuid(created),
+                     node,
+                     user,
+                     static_cast<int>(random(1, 9)),
+                     status,
+                     format("Action {}", i + 1),
+                     format("{:%F}", created),
+                     "date",
+                     toDateTime(chrono::sys_seconds{due} + chrono::hours{23} + chrono::minutes{59}),
+                     done ? SqlExpr{"?", {boost::mysql::field{toDateTime(completed)}}} : SqlExpr{"DEFAULT"},
+                     done,
+                     chance(0.7) ? optional{static_cast<int>(random(1, 16) * 15)} : nullopt,
+                     difficulties[random(0, difficulties.size() - 1)]);
+        ++counts_.actions;
+    }
+}
+
+void DataGenerator::addDays(const std::string &user)
+{
+    for(auto day = first_date_; day <= end_date_; day += chrono::days{1}) {
+        if (!chance(0.85)) {
+            continue;
+        }
+
+        days_.add(format("{:%F}", day),
+                  user,
+                  colors_[random(0, colors_.size() - 1)],
+                  chance(0.1) ? optional<string>{"Some notes for the day"} : nullopt,
+                  nullopt);
+        ++counts_.days;
+    }
+}
+
+void DataGenerator::addWork(const std::vector<std::string> &nodes)
+{
+    if (!config_.work_sessions || nodes.empty()) {
+        return;
+    }
+
+    for(auto day = first_date_; day <= end_date_; day += chrono::days{1}) {
+        const chrono::weekday wd{day};
+        if (wd == chrono::Saturday || wd == chrono::Sunday) {
+            continue;
+        }
+
+        // Sessions of up to 2 hours, one after the other from 08:00
+        auto start = chrono::sys_seconds{day} + chrono::hours{8};
+        for(size_t i = 0; i < config_.work_sessions; ++i) {
+            start += chrono::minutes(random(0, 20));
+            const chrono::seconds used{random(20, 100) * 60};
+            const chrono::seconds paused{random(0, 3) * 5 * 60};
+            const auto end = start + used + paused;
+
+            work_.add(uuid(start),
+                      nodes[random(0, nodes.size() - 1)],
+                      toDateTime(start),
+                      toDateTime(end),
+                      used.count(),
+                      paused.count(),
+                      format("Work session {}", i + 1));
+            ++counts_.work;
+            start = end;
+        }
+    }
+}
+
+boost::asio::awaitable<void> DataGenerator::flushIfFull()
+{
+    for(const auto *batch : {&tenants_, &users_, &nodes_, &actions_, &days_, &work_}) {
+        if (batch->full()) {
+            co_await flush();
+            co_return;
+        }
+    }
+}
+
+boost::asio::awaitable<void> DataGenerator::flush()
+{
+    for(auto *batch : {&tenants_, &users_, &nodes_, &actions_, &days_, &work_}) {
+        if (!batch->empty()) {
+            const auto rows = batch->take();
+            co_await handle_->exec(rows.query, rows.args());
+        }
+    }
+}
+
+string DataGenerator::uuid(chrono::sys_time<chrono::milliseconds> when)
+{
+    if (!time_ordered_) {
+        return boost::uuids::to_string(random_uuid_());
+    }
+
+    // Ids for the same millisecond follow each other, as from newUuid()
+    const auto ms = static_cast<uint64_t>(when.time_since_epoch().count());
+    if (ms == last_ms_ && seq_ < 0x0fff) {
+        ++seq_;
+    } else {
+        last_ms_ = ms;
+        seq_ = rng_() & 0x07ff;
+    }
+    return boost::uuids::to_string(toUuidV7(ms, seq_, rng_()));
+}
+
+size_t DataGenerator::random(size_t min, size_t max)
+{
+    return uniform_int_distribution<size_t>{min, max}(rng_);
+}
+
+bool DataGenerator::chance(double probability)
+{
+    return bernoulli_distribution{probability}(rng_);
+}
+
+} // ns
@@ -1,13 +1,21 @@
 
 #include <map>
+#include <array>
 #include <chrono>
+#include <ranges>
+#include <random>
 
-#include <boost/uuid/random_generator.hpp>
 #include <boost/uuid/uuid_io.hpp>
 #include <boost/json.hpp>
+#include <google/protobuf/arena.h>
+#include <google/protobuf/descriptor.h>
+#include <grpcpp/health_check_service_interface.h>
+#include <grpcpp/support/message_allocator.h>
 
 #include "nextapp/GrpcServer.h"
 #include "nextapp/Server.h"
+#include "nextapp/TenantIo.h"
+#include "shared_grpc_server.h"
 
 using namespace std;
 using namespace std::literals;
@@ -20,8 +28,49 @@ namespace nextapp::grpc {
 
 boost::uuids::uuid newUuid()
 {
-    static boost::uuids::random_generator uuid_gen_;
-    return uuid_gen_();
+    // UUIDv7 (RFC 9562): 48 bits unix time in milliseconds, followed by a 12 bit
+    // sequence and 62 random bits. Ids minted close in time are close in the
+    // primary key indexes. Each thread has its own state, so there is no locking.
+    struct State {
+        std::mt19937_64 rnd{(uint64_t{std::random_device{}()} << 32) | std::random_device{}()};
+        uint64_t last_ms = 0;
+        uint16_t seq = 0;
+    };
+    thread_local State state;
+
+    auto ms = static_cast<uint64_t>(chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count());
+
+    if (ms <= state.last_ms) {
+        // Same millisecond (or the clock went backwards). Keep the ids ordered for this thread.
+        ms = state.last_ms;
+        if (++state.seq > 0x0fff) {
+            ++ms;
+            state.seq = state.rnd() & 0x07ff;
+        }
+    } else {
+        // Leave room for the sequence to grow within the millisecond
+        state.seq = state.rnd() & 0x07ff;
+    }
+    state.last_ms = ms;
+
+    return toUuidV7(ms, state.seq, state.rnd());
+}
+
+boost::uuids::uuid toUuidV7(uint64_t unixMs, uint16_t seq, uint64_t random) noexcept
+{
+    boost::uuids::uuid uuid;
+    for(auto i = 0; i < 6; ++i) {
+        uuid.data[i] = static_cast<uint8_t>(unixMs >> (40 - (i * 8)));
+    }
+    uuid.data[6] = static_cast<uint8_t>(0x70 | ((seq >> 8) & 0x0f));
+    uuid.data[7] = static_cast<uint8_t>(seq);
+    for(auto i = 8; i < 16; ++i) {
+        uuid.data[i] = static_cast<uint8_t>(random >> ((i - 8) * 8));
+    }
+    uuid.data[8] = (uuid.data[8] & 0x3f) | 0x80; // RFC variant
+
+    return uuid;
 }
 
 string newUuidStr()
@@ -29,53 +78,81 @@ string newUuidStr()
     return boost::uuids::to_string(newUuid());
 }
 
+std::string_view methodName(const std::source_location& location) noexcept
+{
+    // Like "grpc::ServerUnaryReactor* nextapp::grpc::GrpcServer::NextappImpl::GetDay(grpc::CallbackServerContext*, ...)"
+    string_view name = location.function_name();
+    if (const auto end = name.find('('); end != string_view::npos) {
+        name = name.substr(0, end);
+    }
+    if (const auto start = name.rfind("::"); start != string_view::npos) {
+        name = name.substr(start + 2);
+    }
+    return name;
+}
+
 
 namespace {
 
-template <typename T>
-concept ProtoMessage = std::is_base_of_v<google::protobuf::Message, T>;
-
-template <ProtoMessage T>
-std::string toJson(const T& obj) {
-    std::string str;
-    auto res = google::protobuf::util::MessageToJsonString(obj, &str);
-    if (!res.ok()) {
-        LOG_DEBUG << "Failed to convert object to json: "
-                  << typeid(T).name() << ": "
-                  << res.ToString();
-        throw std::runtime_error{"Failed to convert object to json"};
-    }
-    return str;
-}
+/*! Allocates the request and reply for a call, and all their sub-messages, on one arena.
+ *
+ *  The first block of the arena is part of the holder, so a call with small
+ *  messages costs one heap allocation. The arena is released in one go when
+ *  gRPC is done with the call.
+ */
+template <typename ReqT, typename ReplyT>
+class ArenaAllocator : public ::grpc::MessageAllocator<ReqT, ReplyT> {
+public:
+    static constexpr size_t initial_block_size = 4096;
+
+    class Holder : public ::grpc::MessageHolder<ReqT, ReplyT> {
+    public:
+        Holder()
+            : arena_{initial_block_.data(), initial_block_.size()} {
+            this->set_request(google::protobuf::Arena::CreateMessage<ReqT>(&arena_));
+            this->set_response(google::protobuf::Arena::CreateMessage<ReplyT>(&arena_));
+        }
 
-template <typename T>
-concept ProtoStringStringMap = std::is_same_v<std::remove_cv<T>, std::remove_cv<::google::protobuf::Map<std::string, std::string>>>;
+        void Release() override {
+            delete this;
+        }
 
+        // The request lives in the arena until the call is done
+        void FreeRequest() override {}
 
-template <ProtoStringStringMap T>
-string toJson(const T& map) {
-    json::object o;
+    private:
+        alignas(std::max_align_t) std::array<char, initial_block_size> initial_block_;
+        google::protobuf::Arena arena_;
+    };
 
-    for(const auto [key, value] : map) {
-        o[key] = value;
+    ::grpc::MessageHolder<ReqT, ReplyT> *AllocateMessages() override {
+        return new Holder;
     }
+};
 
-    return json::serialize(o);
-}
-
-std::string toAnsiDate(const nextapp::pb::Date& date) {
-    return format("{:0>4d}-{:0>2d}-{:0>2d}", date.year(), date.month() + 1, date.mday());
+template <typename ReqT, typename ReplyT>
+auto *arenaAllocator() {
+    static ArenaAllocator<ReqT, ReplyT> allocator;
+    return &allocator;
 }
 
-::nextapp::pb::Date toDate(const boost::mysql::date& from) {
-    assert(from.valid());
-    assert(from.month() > 0);
-    ::nextapp::pb::Date date;
-    date.set_year(from.year());
-    date.set_month(from.month() -1); // Our range is 0 - 11, the db's range is 1 - 12
-    date.set_mday(from.day());
-
-    return date;
+// The first day in each of the time-spent periods containing `date`,
+// indexed by pb::TimeSpentPeriod. Must match `period_start()` in the database.
+std::array<std::chrono::year_month_day, 5> periodStarts(const nextapp::pb::Date& date) {
+    using namespace std::chrono;
+
+    const auto ymd = toYearMonthDay(date);
+    const sys_days when{ymd};
+    const auto days_since_monday = (weekday{when}.c_encoding() + 6) % 7;
+    const auto first_month_in_quarter = (static_cast<unsigned>(ymd.month()) - 1) / 3 * 3 + 1;
+
+    return {
+        ymd,
+        year_month_day{when - days{days_since_monday}},
+        ymd.year() / ymd.month() / 1,
+        ymd.year() / month{first_month_in_quarter} / 1,
+        ymd.year() / January / 1
+    };
 }
 
 void setError(pb::Status& status, pb::Error err, const std::string& message = {}) {
@@ -91,31 +168,20 @@ void setError(pb::Status& status, pb::Error err, const std::string& message = {}
     LOG_DEBUG << "Setting error " << status.message() << " on request.";
 }
 
-struct ToNode {
-    enum Cols {
-        ID, USER, NAME, KIND, DESCR, ACTIVE, PARENT, VERSION
-    };
-
-    static constexpr string_view selectCols = "id, user, name, kind, descr, active, parent, version";
-
-    static void assign(const boost::mysql::row_view& row, pb::Node& node) {
-        node.set_uuid(row.at(ID).as_string());
-        node.set_user(row.at(USER).as_string());
-        node.set_name(row.at(NAME).as_string());
-        node.set_version(row.at(VERSION).as_int64());
-        const auto kind = row.at(KIND).as_int64();
-        if (pb::Node::Kind_IsValid(kind)) {
-            node.set_kind(static_cast<pb::Node::Kind>(kind));
+bool validateUsers(const google::protobuf::RepeatedPtrField<pb::User>& users, pb::Status& status) {
+    for(const auto& user : users) {
+        if (user.email().empty()) {
+            setError(status, pb::Error::MISSING_USER_EMAIL);
+            return false;
         }
-        if (!row.at(DESCR).is_null()) {
-            node.set_descr(row.at(DESCR).as_string());
-        }
-        node.set_active(row.at(ACTIVE).as_int64() != 0);
-        if (!row.at(PARENT).is_null()) {
-            node.set_parent(row.at(PARENT).as_string());
+        if (user.name().empty()) {
+            setError(status, pb::Error::MISSING_USER_NAME);
+            return false;
         }
     }
-};
+
+    return true;
+}
 
 } // anon ns
 
@@ -135,6 +201,7 @@ GrpcServer::NextappImpl::GetServerInfo(::grpc::CallbackServerContext *ctx,
 
     add("version", NEXTAPP_VERSION);
 
+    owner_.rpcMetrics("GetServerInfo").requests.inc();
     auto* reactor = ctx->DefaultReactor();
     reactor->Finish(::grpc::Status::OK);
     return reactor;
@@ -232,26 +299,9 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
             "SELECT date, user, color, ISNULL(notes), ISNULL(report) FROM day WHERE user=? AND YEAR(date)=? AND MONTH(date)=? ORDER BY date",
             owner_.currentUser(ctx), req->year(), req->month() + 1);
 
-        enum Cols {
-            DATE, USER, COLOR, NOTES, REPORT
-        };
-
         reply->set_year(req->year());
         reply->set_month(req->month());
-
-        for(const auto& row : res.rows()) {
-            const auto date_val = row.at(DATE).as_date();
-            if (date_val.valid()) {
-                auto current_day = reply->add_days();
-                *current_day->mutable_date() = toDate(date_val);
-                current_day->set_user(row.at(USER).as_string());
-                if (row.at(COLOR).is_string()) {
-                    current_day->set_color(row.at(COLOR).as_string());
-                }
-                current_day->set_hasnotes(row.at(NOTES).as_int64() != 1);
-                current_day->set_hasreport(row.at(REPORT).as_int64() != 1);
-            }
-        }
+        buildMonth(res.rows(), *reply);
 
         LOG_TRACE_N << "Finish month lookup.";
         LOG_TRACE << "Reply is: " << toJson(*reply);
@@ -269,17 +319,23 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
             color = req->color();
         }
 
+        const auto cuser = owner_.currentUser(ctx);
+        auto handle = co_await owner_.server().db().getConnection();
+        auto trx = co_await handle.transaction();
+        const auto previous = co_await owner_.fetchDayColorForUpdate(handle, cuser, req->date());
 
-        co_await owner_.server().db().exec(
+        co_await handle.exec(
             R"(INSERT INTO day (date, user, color) VALUES (?, ?, ?)
                 ON DUPLICATE KEY UPDATE color=?)",
-            toAnsiDate(req->date()), owner_.currentUser(ctx),
+            toAnsiDate(req->date()), cuser,
             // insert
             color,
             // update
             color
             );
 
+        co_await owner_.updateDayStats(handle, cuser, req->date(), previous, color);
+        co_await trx.commit();
 
         LOG_TRACE_N << "Finish updating color for " << toAnsiDate(req->date());
 
@@ -316,10 +372,15 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
             report = req->report();
         }
 
-        co_await owner_.server().db().exec(
+        const auto cuser = owner_.currentUser(ctx);
+        auto handle = co_await owner_.server().db().getConnection();
+        auto trx = co_await handle.transaction();
+        const auto previous = co_await owner_.fetchDayColorForUpdate(handle, cuser, req->day().date());
+
+        co_await handle.exec(
             R"(INSERT INTO day (date, user, color, notes, report) VALUES (?, ?, ?, ?, ?)
                 ON DUPLICATE KEY UPDATE color=?, notes=?, report=?)",
-            toAnsiDate(req->day().date()), owner_.currentUser(ctx),
+            toAnsiDate(req->day().date()), cuser,
             // insert
             color,
             notes,
@@ -330,6 +391,9 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
             report
             );
 
+        co_await owner_.updateDayStats(handle, cuser, req->day().date(), previous, color);
+        co_await trx.commit();
+
         auto update = make_shared<pb::Update>();
         *update->mutable_day() = *req;
 
@@ -448,14 +512,7 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
     if (!req->has_tenant() || req->tenant().name().empty()) {
         setError(*reply, pb::Error::MISSING_TENANT_NAME);
     } else {
-
-        for(const auto& user : req->users()) {
-            if (user.email().empty()) {
-                setError(*reply, pb::Error::MISSING_USER_EMAIL);
-            } else if (user.name().empty()) {
-                setError(*reply, pb::Error::MISSING_USER_NAME);
-            }
-        }
+        validateUsers(req->users(), *reply);
     }
 
     if (reply->error() != pb::Error::OK) {
@@ -482,7 +539,11 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
             tenant.set_kind(pb::Tenant::Tenant::Kind::Tenant_Kind_Guest);
         }
 
-        co_await owner_.server().db().exec(
+        // Either the tenant and all the users are created, or nothing is.
+        auto handle = co_await owner_.server().db().getConnection();
+        auto trx = co_await handle.transaction();
+
+        co_await handle.exec(
             "INSERT INTO tenant (id, name, kind, descr, active, properties) VALUES (?, ?, ?, ?, ?, ?)",
                 tenant.uuid(),
                 tenant.name(),
@@ -491,50 +552,57 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
                 tenant.active(),
                 properties);
 
+        const auto users = co_await owner_.insertUsers(handle, tenant.uuid(), req->users());
+        co_await trx.commit();
+
         LOG_INFO << "User " << owner_.currentUser(ctx)
                  << " has created tenant name=" << tenant.name() << ", id=" << tenant.uuid()
-                 << ", kind=" << pb::Tenant::Kind_Name(tenant.kind());
+                 << ", kind=" << pb::Tenant::Kind_Name(tenant.kind())
+                 << " with " << users << " users";
 
-        // create users
-        for(const auto& user_template : req->users()) {
-            pb::User user{user_template};
+        // TODO: Publish the new tenant and users
 
-            if (user.uuid().empty()) {
-                user.set_uuid(newUuidStr());
-            }
+        *reply->mutable_tenant() = tenant;
+        reply->set_message(format("Created tenant {} with {} users", tenant.name(), users));
 
-            user.set_tenant(tenant.uuid());
-            auto kind = user.kind();
-            if (!user.has_kind()) {
-                user.set_kind(pb::User::Kind::User_Kind_Regular);
-            }
+        co_return;
+    });
+}
 
-            if (!user.has_active()) {
-                user.set_active(true);
-            }
+::grpc::ServerUnaryReactor *GrpcServer::NextappImpl::CreateUsers(::grpc::CallbackServerContext *ctx, const pb::CreateUsersReq *req, pb::Status *reply)
+{
+    if (req->users().empty()) {
+        setError(*reply, pb::Error::INVALID_REQUEST, "No users in the request");
+    } else {
+        validateUsers(req->users(), *reply);
+    }
 
-            auto user_props = toJson(*user.mutable_properties());
-            co_await owner_.server().db().exec(
-                "INSERT INTO user (id, tenant, name, email, kind, active, descr, properties) VALUES (?,?,?,?,?,?,?,?)",
-                    user.uuid(),
-                    user.tenant(),
-                    user.name(),
-                    user.email(),
-                    pb::User::Kind_Name(user.kind()),
-                    user.active(),
-                    user.descr(),
-                    user_props);
+    if (reply->error() != pb::Error::OK) {
+        auto* reactor = ctx->DefaultReactor();
+        reactor->Finish(::grpc::Status::OK);
+        return reactor;
+    }
+
+    return unaryHandler(ctx, req, reply,
+                        [this, req, ctx] (pb::Status *reply) -> boost::asio::awaitable<void> {
+
+        const auto tenant = req->tenant().empty() ? owner_.currentTenant(ctx) : req->tenant();
 
-            LOG_INFO << "User " << owner_.currentUser(ctx)
-                     << " has created user name=" << user.name() << ", id=" << user.uuid()
-                     << ", kind=" << pb::User::Kind_Name(user.kind())
-                     << ", tenant=" << user.tenant();
+        auto handle = co_await owner_.server().db().getConnection();
+        auto trx = co_await handle.transaction();
+
+        const auto res = co_await handle.exec("SELECT id FROM tenant WHERE id=?", tenant);
+        if (res.rows().empty()) {
+            throw db_err{pb::Error::NOT_FOUND, format("Tenant {} not found", tenant)};
         }
 
-        // TODO: Publish the new tenant and users
+        const auto users = co_await owner_.insertUsers(handle, tenant, req->users());
+        co_await trx.commit();
 
-        *reply->mutable_tenant() = tenant;
+        LOG_INFO << "User " << owner_.currentUser(ctx)
+                 << " has created " << users << " users in tenant " << tenant;
 
+        reply->set_message(format("Created {} users", users));
         co_return;
     });
 }
@@ -648,7 +716,9 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
                 throw db_err(pb::Error::DATABASE_UPDATE_FAILED, "I failed to update, despite retrying");
             }
 
-            boost::asio::steady_timer timer{owner_.server().ctx()};
+            Span span{"retry.sleep"};
+            span.attr("retry", int64_t{retry});
+            boost::asio::steady_timer timer{co_await boost::asio::this_coro::executor};
             timer.expires_from_now(100ms);
             co_await timer.async_wait(boost::asio::use_awaitable);
         }
@@ -722,7 +792,9 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
                 throw db_err(pb::Error::DATABASE_UPDATE_FAILED, "I failed to update, despite retrying");
             }
 
-            boost::asio::steady_timer timer{owner_.server().ctx()};
+            Span span{"retry.sleep"};
+            span.attr("retry", int64_t{retry});
+            boost::asio::steady_timer timer{co_await boost::asio::this_coro::executor};
             timer.expires_from_now(100ms);
             co_await timer.async_wait(boost::asio::use_awaitable);
         }
@@ -793,55 +865,421 @@ GrpcServer::NextappImpl::GetDay(::grpc::CallbackServerContext *ctx,
         )
         SELECT {} from tree ORDER BY parent, name)", ToNode::selectCols), cuser);
 
-        std::deque<pb::NodeTreeItem> pending;
-        map<string, pb::NodeTreeItem *> known;
-
-        // Root level
-        known[""] = reply->mutable_root();
-
-        if (res.has_value()) {
-            for(const auto& row : res.rows()) {
-                pb::Node n;
-                ToNode::assign(row, n);
-                const auto parent = n.parent();
-
-                if (auto it = known.find(parent); it != known.end()) {
-                    auto child = it->second->add_children();
-                    child->mutable_node()->Swap(&n);
-                    known[child->node().uuid()] = child;
-                } else {
-                    // Track it for later
-                    const auto id = n.uuid();
-                    pending.push_back({});
-                    auto child = &pending.back();
-                    child->mutable_node()->Swap(&n);
-                    known[child->node().uuid()] = child;
-                }
+        // Building the tree is CPU bound, and can be slow for large trees
+        co_await owner_.server().onCpu([&] {
+            if (res.has_value()) {
+                buildNodeTree(res.rows(), *reply);
+            } else {
+                reply->mutable_root();
             }
+        });
+
+        co_return;
+    });
+}
+
+::grpc::ServerUnaryReactor *GrpcServer::NextappImpl::GetChildren(::grpc::CallbackServerContext *ctx,
+                                                                 const pb::GetChildrenReq *req,
+                                                                 pb::NodeTree *reply)
+{
+    return unaryHandler(ctx, req, reply,
+    [this, req, ctx] (pb::NodeTree *reply) -> boost::asio::awaitable<void> {
+        const auto cuser = owner_.currentUser(ctx);
+        // Deeper trees are loaded with more calls, as the user expands the nodes
+        constexpr int max_depth = 8;
+        const auto depth = clamp(req->depth(), 1, max_depth);
+
+        optional<string> parent;
+        if (!req->parent().empty()) {
+            parent = req->parent();
         }
 
-        // By now, all the parents are in the known list.
-        // We can safely move all the pending items to the child lists of the parents
-        for(auto& v : pending) {
-            if (auto it = known.find(v.node().parent()); it != known.end()) {
-                auto id = v.node().uuid();
-                auto& parent = *it->second;
-                parent.add_children()->Swap(&v);
-                // known lookup must point to the node's new memory location
-                assert(parent.children().size() > 0);
-                known[id] = &parent.mutable_children()->at(parent.children().size()-1);
+        // Only `depth` levels below the parent. The child count lets the client
+        // show the nodes that have children, without loading them.
+        const auto res = co_await owner_.server().db().exec(format(R"(
+        WITH RECURSIVE tree AS (
+          SELECT *, 1 AS level FROM node WHERE user=? AND parent <=> ?
+          UNION ALL
+          SELECT n.*, p.level + 1 FROM node AS n JOIN tree AS p ON n.parent = p.id
+          WHERE p.level < ?
+        )
+        SELECT {}, (SELECT COUNT(*) FROM node AS c WHERE c.parent = tree.id)
+        FROM tree ORDER BY parent, name)", ToNode::selectCols), cuser, parent, depth);
+
+        co_await owner_.server().onCpu([&] {
+            if (res.has_value()) {
+                buildNodeTree(res.rows(), *reply, req->parent(), true);
             } else {
-                assert(false);
+                reply->mutable_root();
+            }
+        });
+
+        co_return;
+    });
+}
+
+::grpc::ServerUnaryReactor *GrpcServer::NextappImpl::GetTimeSpent(::grpc::CallbackServerContext *ctx,
+                                                                  const pb::TimeSpentReq *req,
+                                                                  pb::TimeSpentSummary *reply)
+{
+    return unaryHandler(ctx, req, reply,
+    [this, req, ctx] (pb::TimeSpentSummary *reply) -> boost::asio::awaitable<void> {
+        const auto cuser = owner_.currentUser(ctx);
+        const auto starts = periodStarts(req->date());
+
+        optional<string> node;
+        if (!req->node().empty()) {
+            node = req->node();
+        }
+
+        // Only the pre-aggregated rollups are read. Each period is a range-lookup in the primary key.
+        const auto res = co_await owner_.server().db().exec(R"(
+            SELECT period, CAST(SUM(used) AS SIGNED), CAST(SUM(paused) AS SIGNED) FROM time_spent
+            WHERE user=? AND (? IS NULL OR node=?) AND (
+                (period='day' AND start=?)
+                OR (period='week' AND start=?)
+                OR (period='month' AND start=?)
+                OR (period='quarter' AND start=?)
+                OR (period='year' AND start=?))
+            GROUP BY period)",
+            cuser, node, node,
+            toAnsiDate(starts[pb::TS_DAY]),
+            toAnsiDate(starts[pb::TS_WEEK]),
+            toAnsiDate(starts[pb::TS_MONTH]),
+            toAnsiDate(starts[pb::TS_QUARTER]),
+            toAnsiDate(starts[pb::TS_YEAR]));
+
+        enum Cols {
+            PERIOD, USED, PAUSED
+        };
+
+        // Report all the periods, also those without any registered work
+        for(auto period = 0; period < static_cast<int>(starts.size()); ++period) {
+            auto *ts = reply->add_periods();
+            ts->set_period(static_cast<pb::TimeSpentPeriod>(period));
+            *ts->mutable_start() = toDate(starts[period]);
+        }
+
+        static constexpr auto period_names = to_array<string_view>({"day", "week", "month", "quarter", "year"});
+
+        for(const auto& row : res.rows()) {
+            const auto name = row.at(PERIOD).as_string();
+            if (auto it = ranges::find(period_names, name); it != period_names.end()) {
+                auto& ts = *reply->mutable_periods(distance(period_names.begin(), it));
+                ts.set_used(row.at(USED).as_int64());
+                ts.set_paused(row.at(PAUSED).as_int64());
+            }
+        }
+
+        LOG_TRACE << "Time spent: " << toJson(*reply);
+        co_return;
+    });
+}
+
+::grpc::ServerUnaryReactor *GrpcServer::NextappImpl::GetDayStats(::grpc::CallbackServerContext *ctx,
+                                                                 const pb::DayStatsReq *req,
+                                                                 pb::DayStats *reply)
+{
+    return unaryHandler(ctx, req, reply,
+    [this, req, ctx] (pb::DayStats *reply) -> boost::asio::awaitable<void> {
+        const auto cuser = owner_.currentUser(ctx);
+        const auto first_day = format("{:0>4d}-01-01", req->year());
+        const auto last_day = format("{:0>4d}-12-31", req->year());
+
+        const auto res = co_await owner_.server().db().exec(
+            "SELECT month, color, days, score FROM day_stats WHERE user=? AND year=? AND days > 0 ORDER BY month",
+            cuser, req->year());
+
+        enum Cols {
+            MONTH, COLOR, DAYS, SCORE
+        };
+
+        auto average = [](int score, int days) {
+            return days ? static_cast<double>(score) / days : 0.0;
+        };
+
+        reply->set_year(req->year());
+        map<string, int> colors;
+        pb::MonthDayStats *month = {};
+        for(const auto& row : res.rows()) {
+            const auto month_ix = static_cast<int32_t>(row.at(MONTH).as_int64() - 1);
+            if (!month || month->month() != month_ix) {
+                month = reply->add_months();
+                month->set_month(month_ix);
             }
+
+            const auto days = static_cast<int32_t>(row.at(DAYS).as_int64());
+            const auto score = static_cast<int32_t>(row.at(SCORE).as_int64());
+            month->set_days(month->days() + days);
+            month->set_score(month->score() + score);
+            reply->set_days(reply->days() + days);
+            reply->set_score(reply->score() + score);
+            colors[string{row.at(COLOR).as_string()}] += days;
+        }
+
+        for(auto& m : *reply->mutable_months()) {
+            m.set_averagescore(average(m.score(), m.days()));
+        }
+        reply->set_averagescore(average(reply->score(), reply->days()));
+
+        for(const auto& [color, days] : colors) {
+            auto *cc = reply->add_colors();
+            cc->set_color(color);
+            cc->set_days(days);
+        }
+
+        // Streaks are stored as date ranges, clipped to the year here.
+        const auto longest = co_await owner_.server().db().exec(
+            R"(SELECT MAX(DATEDIFF(LEAST(end, ?), GREATEST(start, ?)) + 1) FROM day_streak
+                WHERE user=? AND start <= ? AND end >= ?)",
+            last_day, first_day, cuser, last_day, first_day);
+        if (!longest.rows().empty() && !longest.rows().front().at(0).is_null()) {
+            reply->set_longeststreak(static_cast<int32_t>(longest.rows().front().at(0).as_int64()));
+        }
+
+        const auto current = co_await owner_.server().db().exec(
+            R"(SELECT DATEDIFF(LEAST(end, CURDATE()), start) + 1 FROM day_streak
+                WHERE user=? AND start <= CURDATE() AND end >= CURDATE() - INTERVAL 1 DAY)",
+            cuser);
+        if (!current.rows().empty()) {
+            reply->set_currentstreak(static_cast<int32_t>(current.rows().front().at(0).as_int64()));
         }
 
+        LOG_TRACE << "Day stats: " << toJson(*reply);
         co_return;
     });
 }
 
+::grpc::ServerWriteReactor<pb::ExportRecord> *GrpcServer::NextappImpl::ExportTenant(::grpc::CallbackServerContext *ctx,
+                                                                                    const pb::ExportTenantReq *req)
+{
+    // Sends one batch of records at the time, so the memory use does not depend on the size of the tenant.
+    class ExportReactor : public ::grpc::ServerWriteReactor<pb::ExportRecord> {
+    public:
+        ExportReactor(GrpcServer& owner, std::string user, std::string tenant)
+            : owner_{owner}, io_ctx_{owner.server().requestCtx()}, rpc_{owner.rpcMetrics("ExportTenant")}
+            , user_{std::move(user)}, exporter_{owner.server(), std::move(tenant)} {
+            rpc_.requests.inc();
+        }
+
+        void start() {
+            fetch(true);
+        }
+
+        void OnDone() override {
+            LOG_TRACE_N << "Export is done.";
+            delete this;
+        }
+
+        void OnWriteDone(bool ok) override {
+            if (!ok) [[unlikely]] {
+                LOG_WARN_N << "The write-operation failed.";
+                Finish({::grpc::StatusCode::UNKNOWN, "stream write failed"});
+                return;
+            }
+
+            if (++current_ < records_.size()) {
+                StartWrite(&records_[current_]);
+                return;
+            }
+
+            fetch();
+        }
+
+    private:
+        void fetch(bool first = false) {
+            boost::asio::co_spawn(io_ctx_, [this, first]() -> boost::asio::awaitable<void> {
+                try {
+                    if (first) {
+                        // All the data for a tenant is only for the administrators
+                        co_await owner_.validateAdmin(user_);
+                    }
+
+                    current_ = 0;
+                    if (co_await exporter_.next(records_)) {
+                        StartWrite(&records_.front());
+                    } else {
+                        Finish(::grpc::Status::OK);
+                    }
+                } catch (const db_err& ex) {
+                    LOG_WARN_N << "Export failed: " << ex.what();
+                    rpc_.failed.inc();
+                    Finish({toStatusCode(ex.error()), ex.what()});
+                } catch (const std::exception& ex) {
+                    LOG_WARN_N << "Export failed: " << ex.what();
+                    rpc_.failed.inc();
+                    Finish({::grpc::StatusCode::INTERNAL, ex.what()});
+                }
+            }, boost::asio::detached);
+        }
+
+        static ::grpc::StatusCode toStatusCode(pb::Error error) {
+            switch(error) {
+            case pb::Error::NOT_FOUND:
+                return ::grpc::StatusCode::NOT_FOUND;
+            case pb::Error::PERMISSION_DENIED:
+                return ::grpc::StatusCode::PERMISSION_DENIED;
+            default:
+                return ::grpc::StatusCode::INTERNAL;
+            }
+        }
+
+        GrpcServer& owner_;
+        // All the batches are fetched on the same shard
+        boost::asio::io_context& io_ctx_;
+        GrpcServer::RpcMetrics& rpc_;
+        Metrics::ScopedTimer timer_{rpc_.duration};
+        const std::string user_;
+        TenantExporter exporter_;
+        std::vector<pb::ExportRecord> records_;
+        size_t current_ = 0;
+    };
+
+    const auto tenant = req->tenant().empty() ? owner_.currentTenant(ctx) : req->tenant();
+    const auto cuser = owner_.currentUser(ctx);
+    LOG_INFO << "User " << cuser << " is exporting tenant " << tenant;
+
+    auto *reactor = new ExportReactor(owner_, cuser, tenant);
+    reactor->start();
+    return reactor; // The object deletes itself in OnDone()
+}
+
+::grpc::ServerReadReactor<pb::ExportRecord> *GrpcServer::NextappImpl::ImportTenant(::grpc::CallbackServerContext *ctx,
+                                                                                   pb::Status *reply)
+{
+    // All the records are imported in one transaction, that is committed when the client
+    // closes the stream, or rolled back if the import fails or is cancelled.
+    class ImportReactor : public ::grpc::ServerReadReactor<pb::ExportRecord> {
+    public:
+        ImportReactor(GrpcServer& owner, ::grpc::CallbackServerContext *ctx, pb::Status *reply)
+            : owner_{owner}, io_ctx_{owner.server().requestCtx()}, rpc_{owner.rpcMetrics("ImportTenant")}
+            , ctx_{ctx}, reply_{reply}, importer_{owner.server()} {
+            rpc_.requests.inc();
+        }
+
+        void start() {
+            run([this]() -> boost::asio::awaitable<void> {
+                // The import can write to any tenant
+                co_await owner_.validateAdmin(owner_.currentUser(ctx_));
+                co_await importer_.begin();
+                StartRead(&record_);
+            });
+        }
+
+        void OnDone() override {
+            LOG_TRACE_N << "Import is done.";
+            delete this;
+        }
+
+        void OnReadDone(bool ok) override {
+            if (ok) {
+                run([this]() -> boost::asio::awaitable<void> {
+                    co_await importer_.add(record_);
+                    StartRead(&record_);
+                });
+                return;
+            }
+
+            if (ctx_->IsCancelled()) {
+                LOG_WARN_N << "The import was cancelled by the client.";
+                run([this]() -> boost::asio::awaitable<void> {
+                    co_await importer_.abort();
+                    Finish(::grpc::Status::CANCELLED);
+                });
+                return;
+            }
+
+            // The client is done sending
+            run([this]() -> boost::asio::awaitable<void> {
+                co_await importer_.commit();
+                reply_->set_error(pb::Error::OK);
+                reply_->set_message(importer_.summary());
+                Finish(::grpc::Status::OK);
+            });
+        }
+
+    private:
+        void run(auto fn) {
+            boost::asio::co_spawn(io_ctx_, [this, fn]() -> boost::asio::awaitable<void> {
+                std::optional<pb::Status> failed;
+                try {
+                    co_await fn();
+                } catch (const db_err& ex) {
+                    failed.emplace();
+                    failed->set_error(ex.error());
+                    failed->set_message(ex.what());
+                } catch (const std::exception& ex) {
+                    failed.emplace();
+                    failed->set_error(pb::Error::DATABASE_UPDATE_FAILED);
+                    failed->set_message(ex.what());
+                }
+
+                if (failed) {
+                    LOG_WARN_N << "Import failed: " << failed->message();
+                    rpc_.failed.inc();
+                    try {
+                        co_await importer_.abort();
+                    } catch (const std::exception& ex) {
+                        LOG_WARN_N << "Failed to roll back the import: " << ex.what();
+                    }
+                    *reply_ = *failed;
+                    Finish(::grpc::Status::OK);
+                }
+            }, boost::asio::detached);
+        }
+
+        GrpcServer& owner_;
+        // The transaction's connection belongs to this shard
+        boost::asio::io_context& io_ctx_;
+        GrpcServer::RpcMetrics& rpc_;
+        Metrics::ScopedTimer timer_{rpc_.duration};
+        ::grpc::CallbackServerContext *ctx_;
+        pb::Status *reply_;
+        TenantImporter importer_;
+        pb::ExportRecord record_;
+    };
+
+    LOG_INFO << "User " << owner_.currentUser(ctx) << " is importing a tenant";
+
+    auto *reactor = new ImportReactor(owner_, ctx, reply);
+    reactor->start();
+    return reactor; // The object deletes itself in OnDone()
+}
+
 GrpcServer::GrpcServer(Server &server)
     : server_{server}
+    , admission_{{server.config().grpc.rate_limit,
+                  server.config().grpc.rate_limit_burst,
+                  server.config().grpc.max_in_flight}}
+    , publish_time_{server.metrics().histogram("nextapp_publish_fanout_seconds",
+                                               "Time to queue an update for all the subscribers")}
 {
+    auto& metrics = server.metrics();
+
+    auto add = [&](const string& method) {
+        const auto labels = format("method=\"{}\"", method);
+        rpc_metrics_.try_emplace(method, RpcMetrics{
+            metrics.counter("nextapp_grpc_requests_total", "RPC requests received", labels),
+            metrics.counter("nextapp_grpc_requests_failed_total", "RPC requests that failed", labels),
+            metrics.counter("nextapp_grpc_rejected_total", "RPC requests rejected by the admission control", labels),
+            metrics.histogram("nextapp_grpc_request_duration_seconds", "Time from an RPC is accepted until it is done", labels)});
+    };
+
+    const auto *service = google::protobuf::DescriptorPool::generated_pool()->FindServiceByName(
+        pb::Nextapp::service_full_name());
+    assert(service);
+    for(auto i = 0; i < service->method_count(); ++i) {
+        add(string{service->method(i)->name()});
+    }
+    add("other");
+
+    metrics.gauge("nextapp_grpc_requests_in_flight", "Unary RPC requests that are admitted and not yet done",
+                  [this] { return static_cast<double>(admission_.inFlight()); });
+    metrics.gauge("nextapp_grpc_subscribers", "Clients that are subscribed to updates",
+                  [this] {
+                      scoped_lock lock{mutex_};
+                      return static_cast<double>(publishers_.size());
+                  });
 }
 
 void GrpcServer::start() {
@@ -853,10 +1291,36 @@ void GrpcServer::start() {
 
     // Feed gRPC our implementation of the RPC's
     service_ = std::make_unique<NextappImpl>(*this);
+
+    // Let the unary RPC's build their replies on a per-call arena
+    service_->SetMessageAllocatorFor_GetServerInfo(arenaAllocator<pb::Empty, pb::ServerInfo>());
+    service_->SetMessageAllocatorFor_GetNodes(arenaAllocator<pb::GetNodesReq, pb::NodeTree>());
+    service_->SetMessageAllocatorFor_GetChildren(arenaAllocator<pb::GetChildrenReq, pb::NodeTree>());
+    service_->SetMessageAllocatorFor_GetDayColorDefinitions(arenaAllocator<pb::Empty, pb::DayColorDefinitions>());
+    service_->SetMessageAllocatorFor_GetDay(arenaAllocator<pb::Date, pb::CompleteDay>());
+    service_->SetMessageAllocatorFor_GetMonth(arenaAllocator<pb::MonthReq, pb::Month>());
+    service_->SetMessageAllocatorFor_SetColorOnDay(arenaAllocator<pb::SetColorReq, pb::Status>());
+    service_->SetMessageAllocatorFor_SetDay(arenaAllocator<pb::CompleteDay, pb::Status>());
+    service_->SetMessageAllocatorFor_GetTimeSpent(arenaAllocator<pb::TimeSpentReq, pb::TimeSpentSummary>());
+    service_->SetMessageAllocatorFor_GetDayStats(arenaAllocator<pb::DayStatsReq, pb::DayStats>());
+    service_->SetMessageAllocatorFor_CreateTenant(arenaAllocator<pb::CreateTenantReq, pb::Status>());
+    service_->SetMessageAllocatorFor_CreateUsers(arenaAllocator<pb::CreateUsersReq, pb::Status>());
+    service_->SetMessageAllocatorFor_CreateNode(arenaAllocator<pb::CreateNodeReq, pb::Status>());
+    service_->SetMessageAllocatorFor_UpdateNode(arenaAllocator<pb::Node, pb::Status>());
+    service_->SetMessageAllocatorFor_DeleteNode(arenaAllocator<pb::DeleteNodeReq, pb::Status>());
+    service_->SetMessageAllocatorFor_MoveNode(arenaAllocator<pb::MoveNodeReq, pb::Status>());
+
     builder.RegisterService(service_.get());
 
+    // grpc.health.v1.Health, so load-balancers and orchestrators can see when we are ready
+    ::grpc::EnableDefaultHealthCheckService(true);
+
     // Finally assemble the server.
     grpc_server_ = builder.BuildAndStart();
+    if (!grpc_server_) {
+        throw runtime_error{format("Failed to start the gRPC service on {}", config().address)};
+    }
+    setServing(server_.ready());
     LOG_INFO
         // Fancy way to print the class-name.
         // Useful when I copy/paste this code around ;)
@@ -866,6 +1330,13 @@ void GrpcServer::start() {
         << " listening on " << config().address;
 }
 
+void GrpcServer::setServing(bool serving)
+{
+    if (auto *health = grpc_server_ ? grpc_server_->GetHealthCheckService() : nullptr) {
+        health->SetServingStatus(serving);
+    }
+}
+
 void GrpcServer::stop() {
     LOG_INFO << "Shutting down "
              << boost::typeindex::type_id_runtime(*this).pretty_name();
@@ -889,7 +1360,10 @@ void GrpcServer::removePublisher(const boost::uuids::uuid &uuid)
 
 void GrpcServer::publish(const std::shared_ptr<pb::Update>& update)
 {
+    Metrics::ScopedTimer timer{publish_time_};
+    Span span{"publish"};
     scoped_lock lock{mutex_};
+    span.attr("subscribers", static_cast<int64_t>(publishers_.size()));
 
     LOG_DEBUG_N << "Publishing update to " << publishers_.size() << " subscribers, Json: "
                 << toJson(*update);
@@ -906,18 +1380,30 @@ void GrpcServer::publish(const std::shared_ptr<pb::Update>& update)
 boost::asio::awaitable<void> GrpcServer::validateParent(const std::string &parentUuid, const std::string &userUuid)
 {
     auto res = co_await server().db().exec("SELECT id FROM node where id=? and user=?", parentUuid, userUuid);
-    if (!res.has_value()) {
+    if (res.rows().empty()) {
         throw db_err{pb::Error::INVALID_PARENT, "Parent id must exist and be owned by the user"};
     }
 
     co_return;
 }
 
+boost::asio::awaitable<void> GrpcServer::validateAdmin(const std::string &userUuid)
+{
+    auto res = co_await server().db().exec(
+        R"(SELECT u.id FROM user AS u JOIN tenant AS t ON t.id = u.tenant
+            WHERE u.id=? AND u.kind='super' AND u.active=1 AND t.kind='super')", userUuid);
+    if (res.rows().empty()) {
+        throw db_err{pb::Error::PERMISSION_DENIED, format("User {} is not an administrator", userUuid)};
+    }
+
+    co_return;
+}
+
 boost::asio::awaitable<pb::Node> GrpcServer::fetcNode(const std::string &uuid, const std::string &userUuid)
 {
     auto res = co_await server().db().exec(format("SELECT {} from node where id=? and user=?", ToNode::selectCols),
                                            uuid, userUuid);
-    if (!res.has_value()) {
+    if (res.rows().empty()) {
         throw db_err{pb::Error::NOT_FOUND, format("Node {} not found", uuid)};
     }
 
@@ -926,5 +1412,172 @@ boost::asio::awaitable<pb::Node> GrpcServer::fetcNode(const std::string &uuid, c
     co_return rval;
 }
 
+boost::asio::awaitable<size_t> GrpcServer::insertUsers(Server::Db::Handle& handle,
+                                                       const std::string& tenantUuid,
+                                                       const google::protobuf::RepeatedPtrField<pb::User>& templates)
+{
+    BulkInsert users{"INSERT INTO user (id, tenant, name, email, kind, active, descr, properties) VALUES "};
+
+    for(const auto& user_template : templates) {
+        pb::User user{user_template};
+
+        if (user.uuid().empty()) {
+            user.set_uuid(newUuidStr());
+        }
+
+        user.set_tenant(tenantUuid);
+        if (!user.has_kind()) {
+            user.set_kind(pb::User::Kind::User_Kind_Regular);
+        }
+
+        if (!user.has_active()) {
+            user.set_active(true);
+        }
+
+        users.add(user.uuid(),
+                  user.tenant(),
+                  user.name(),
+                  user.email(),
+                  pb::User::Kind_Name(user.kind()),
+                  user.active(),
+                  user.descr(),
+                  toJson(*user.mutable_properties()));
+
+        LOG_DEBUG_N << "Adding user name=" << user.name() << ", id=" << user.uuid()
+                    << ", kind=" << pb::User::Kind_Name(user.kind())
+                    << ", tenant=" << user.tenant();
+
+        if (users.full()) {
+            const auto batch = users.take();
+            co_await handle.exec(batch.query, batch.args());
+        }
+    }
+
+    if (!users.empty()) {
+        const auto batch = users.take();
+        co_await handle.exec(batch.query, batch.args());
+    }
+
+    co_return templates.size();
+}
+
+boost::asio::awaitable<std::optional<GrpcServer::DayColor>> GrpcServer::fetchDayColorForUpdate(Server::Db::Handle& handle,
+                                                                                              const std::string& userUuid,
+                                                                                              const pb::Date& date)
+{
+    // The streaks span days, so we serialize all updates of the statistics for the user.
+    co_await handle.exec("SELECT id FROM user WHERE id=? FOR UPDATE", userUuid);
+
+    // Days written before the score was stored with the day use the current score
+    auto res = co_await handle.exec(
+        R"(SELECT d.color, COALESCE(d.score, c.score, 0) FROM day AS d
+            LEFT JOIN day_colors AS c ON c.id = d.color
+            WHERE d.user=? AND d.date=?)",
+        userUuid, toAnsiDate(date));
+    if (!res.rows().empty() && res.rows().front().at(0).is_string()) {
+        const auto& row = res.rows().front();
+        co_return DayColor{string{row.at(0).as_string()}, row.at(1).as_int64()};
+    }
+
+    co_return nullopt;
+}
+
+boost::asio::awaitable<void> GrpcServer::updateDayStats(Server::Db::Handle& handle,
+                                                        const std::string& userUuid,
+                                                        const pb::Date& date,
+                                                        const std::optional<DayColor>& previous,
+                                                        const std::optional<std::string>& current)
+{
+    using std::chrono::year_month_day;
+
+    const auto previous_color = previous ? optional<string>{previous->color} : nullopt;
+    if (previous_color == current) {
+        co_return;
+    }
+
+    const auto ymd = toYearMonthDay(date);
+    const std::chrono::sys_days when{ymd};
+    const auto day = toAnsiDate(ymd);
+    const auto day_before = toAnsiDate(year_month_day{when - std::chrono::days{1}});
+    const auto day_after = toAnsiDate(year_month_day{when + std::chrono::days{1}});
+    const auto year = static_cast<int>(ymd.year());
+    const auto month = static_cast<unsigned>(ymd.month());
+
+    // Remove the score that was added when the previous color was set. The score
+    // for the color may have been changed since then.
+    if (previous) {
+        co_await handle.exec(
+            R"(UPDATE day_stats SET days = days - 1, score = score - ?
+                WHERE user=? AND year=? AND month=? AND color=?)",
+            previous->score, userUuid, year, month, previous->color);
+    }
+
+    if (current) {
+        co_await handle.exec(
+            R"(INSERT INTO day_stats (user, year, month, color, days, score)
+                SELECT ?, ?, ?, id, 1, score FROM day_colors WHERE id=?
+                ON DUPLICATE KEY UPDATE day_stats.days = day_stats.days + 1,
+                    day_stats.score = day_stats.score + VALUES(score))",
+            userUuid, year, month, *current);
+    }
+
+    // Keep the score we applied with the day
+    co_await handle.exec(
+        R"(UPDATE day SET score = (SELECT score FROM day_colors WHERE id = day.color)
+            WHERE user=? AND date=?)", userUuid, day);
+
+    // Is the day part of a streak before and after the change?
+    const bool was_good = previous && previous->score > 0;
+    bool is_good = false;
+    if (current) {
+        const auto score = co_await handle.exec("SELECT score FROM day_colors WHERE id=?", *current);
+        is_good = !score.rows().empty() && score.rows().front().at(0).as_int64() > 0;
+    }
+
+    if (was_good == is_good) {
+        co_return;
+    }
+
+    if (is_good) {
+        // Extend or merge the streaks on either side of the day
+        const auto before = co_await handle.exec("SELECT start FROM day_streak WHERE user=? AND end=?",
+                                                 userUuid, day_before);
+        const auto after = co_await handle.exec("SELECT end FROM day_streak WHERE user=? AND start=?",
+                                                userUuid, day_after);
+        const bool has_before = !before.rows().empty();
+        const bool has_after = !after.rows().empty();
+
+        if (has_before && has_after) {
+            const auto end = after.rows().front().at(0).as_date();
+            co_await handle.exec("DELETE FROM day_streak WHERE user=? AND start=?", userUuid, day_after);
+            co_await handle.exec("UPDATE day_streak SET end=? WHERE user=? AND end=?", end, userUuid, day_before);
+        } else if (has_before) {
+            co_await handle.exec("UPDATE day_streak SET end=? WHERE user=? AND end=?", day, userUuid, day_before);
+        } else if (has_after) {
+            co_await handle.exec("UPDATE day_streak SET start=? WHERE user=? AND start=?", day, userUuid, day_after);
+        } else {
+            co_await handle.exec("INSERT INTO day_streak (user, start, end) VALUES (?, ?, ?)", userUuid, day, day);
+        }
+        co_return;
+    }
+
+    // Split the streak containing the day
+    const auto res = co_await handle.exec("SELECT start, end FROM day_streak WHERE user=? AND start <= ? AND end >= ?",
+                                          userUuid, day, day);
+    if (res.rows().empty()) {
+        LOG_WARN_N << "No streak found for " << day << " for user " << userUuid;
+        co_return;
+    }
+
+    const auto start = res.rows().front().at(0).as_date();
+    const auto end = res.rows().front().at(1).as_date();
+    co_await handle.exec("DELETE FROM day_streak WHERE user=? AND start=?", userUuid, start);
+    if (start.as_time_point() < when) {
+        co_await handle.exec("INSERT INTO day_streak (user, start, end) VALUES (?, ?, ?)", userUuid, start, day_before);
+    }
+    if (end.as_time_point() > when) {
+        co_await handle.exec("INSERT INTO day_streak (user, start, end) VALUES (?, ?, ?)", userUuid, day_after, end);
+    }
+}
 
 } // ns
@@ -0,0 +1,495 @@
+
+#include <format>
+
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+#include <boost/json.hpp>
+
+#include "nextapp/TenantIo.h"
+#include "shared_grpc_server.h"
+
+using namespace std;
+namespace json = boost::json;
+
+namespace nextapp::grpc {
+
+namespace {
+
+constexpr auto nil_uuid = "00000000-0000-0000-0000-000000000000";
+constexpr auto first_date = "0000-01-01";
+
+// Our database ENUM's use the lower-case names of the protobuf enums.
+// NULL is `def`. Other values must have a match, so the export don't change the data.
+template <typename E>
+E toEnum(const boost::mysql::field_view& value, E def) {
+    if (!value.is_string()) {
+        return def;
+    }
+
+    const auto *desc = google::protobuf::GetEnumDescriptor<E>();
+    for(int i = 0; i < desc->value_count(); ++i) {
+        const auto *v = desc->value(i);
+        if (boost::iequals(v->name(), value.as_string())) {
+            return static_cast<E>(v->number());
+        }
+    }
+
+    throw db_err{pb::Error::DATABASE_REQUEST_FAILED,
+                 format("The value '{}' has no match in {}", value.as_string(), desc->full_name())};
+}
+
+template <typename E>
+string toDbName(E value) {
+    const auto *v = google::protobuf::GetEnumDescriptor<E>()->FindValueByNumber(value);
+    assert(v);
+    return boost::to_lower_copy(v->name());
+}
+
+void fromJson(const boost::mysql::field_view& value, ::google::protobuf::Map<string, string>& map) {
+    if (!value.is_string()) {
+        return;
+    }
+
+    const auto obj = json::parse(value.as_string()).as_object();
+    for(const auto& [key, v] : obj) {
+        if (v.is_string()) {
+            map[string{key}] = v.as_string();
+        }
+    }
+}
+
+optional<string> emptyAsNull(const string& value) {
+    if (value.empty()) {
+        return {};
+    }
+    return value;
+}
+
+SqlExpr fromUnixTime(uint64_t when) {
+    if (!when) {
+        return {"DEFAULT"};
+    }
+    return {"FROM_UNIXTIME(?)", {boost::mysql::field{when}}};
+}
+
+} // anon ns
+
+TenantExporter::TenantExporter(Server &server, std::string tenant, size_t batchSize)
+    : server_{server}, tenant_{std::move(tenant)}, batch_size_{batchSize}
+    , last_id_{nil_uuid}, last_date_{first_date}
+{
+}
+
+boost::asio::awaitable<bool> TenantExporter::next(std::vector<pb::ExportRecord> &records)
+{
+    records.clear();
+
+    // A stage that returns less than a full batch is exhausted
+    while(records.empty() && stage_ != Stage::DONE) {
+        switch(stage_) {
+        case Stage::TENANT:
+            co_await fetchTenant(records);
+            break;
+        case Stage::USERS:
+            co_await fetchUsers(records);
+            break;
+        case Stage::NODES:
+            co_await fetchNodes(records);
+            break;
+        case Stage::DAYS:
+            co_await fetchDays(records);
+            break;
+        case Stage::ACTIONS:
+            co_await fetchActions(records);
+            break;
+        case Stage::DONE:
+            break;
+        }
+
+        if (stage_ == Stage::TENANT || records.size() < batch_size_) {
+            nextStage();
+        }
+    }
+
+    co_return !records.empty();
+}
+
+void TenantExporter::nextStage()
+{
+    if (stage_ != Stage::DONE) {
+        stage_ = static_cast<Stage>(static_cast<int>(stage_) + 1);
+    }
+    last_id_ = nil_uuid;
+    last_date_ = first_date;
+    last_level_ = 0;
+}
+
+boost::asio::awaitable<void> TenantExporter::fetchTenant(std::vector<pb::ExportRecord> &records)
+{
+    enum Cols {
+        ID, NAME, KIND, DESCR, ACTIVE, PROPERTIES
+    };
+
+    const auto res = co_await server_.db().exec(
+        "SELECT id, name, kind, descr, active, properties FROM tenant WHERE id=?", tenant_);
+
+    if (res.rows().empty()) {
+        throw db_err{pb::Error::NOT_FOUND, format("Tenant {} not found", tenant_)};
+    }
+
+    const auto& row = res.rows().front();
+    auto *tenant = records.emplace_back().mutable_tenant();
+    tenant->set_uuid(row.at(ID).as_string());
+    tenant->set_name(row.at(NAME).as_string());
+    tenant->set_kind(toEnum(row.at(KIND), pb::Tenant::Guest));
+    if (row.at(DESCR).is_string()) {
+        tenant->set_descr(row.at(DESCR).as_string());
+    }
+    tenant->set_active(row.at(ACTIVE).as_int64() != 0);
+    fromJson(row.at(PROPERTIES), *tenant->mutable_properties());
+}
+
+boost::asio::awaitable<void> TenantExporter::fetchUsers(std::vector<pb::ExportRecord> &records)
+{
+    enum Cols {
+        ID, TENANT, NAME, EMAIL, KIND, ACTIVE, DESCR, PROPERTIES
+    };
+
+    const auto res = co_await server_.db().exec(
+        R"(SELECT id, tenant, name, email, kind, active, descr, properties FROM user
+            WHERE tenant=? AND id > ? ORDER BY id LIMIT ?)",
+        tenant_, last_id_, batch_size_);
+
+    for(const auto& row : res.rows()) {
+        auto *user = records.emplace_back().mutable_user();
+        user->set_uuid(row.at(ID).as_string());
+        user->set_tenant(row.at(TENANT).as_string());
+        user->set_name(row.at(NAME).as_string());
+        user->set_email(row.at(EMAIL).as_string());
+        user->set_kind(toEnum(row.at(KIND), pb::User::Regular));
+        user->set_active(row.at(ACTIVE).as_int64() != 0);
+        if (row.at(DESCR).is_string()) {
+            user->set_descr(row.at(DESCR).as_string());
+        }
+        fromJson(row.at(PROPERTIES), *user->mutable_properties());
+        last_id_ = user->uuid();
+    }
+}
+
+boost::asio::awaitable<void> TenantExporter::fetchNodes(std::vector<pb::ExportRecord> &records)
+{
+    // Parent-first, so the importer can insert each node as it arrives
+    const auto res = co_await server_.db().exec(format(
+        R"(WITH RECURSIVE tree AS (
+              SELECT *, 1 AS level FROM node
+              WHERE user IN (SELECT id FROM user WHERE tenant=?) AND parent IS NULL
+              UNION ALL
+              SELECT n.*, p.level + 1 FROM node AS n JOIN tree AS p ON n.parent = p.id
+            )
+            SELECT {}, level FROM tree
+            WHERE level > ? OR (level = ? AND id > ?)
+            ORDER BY level, id LIMIT ?)", ToNode::selectCols),
+        tenant_, last_level_, last_level_, last_id_, batch_size_);
+
+    constexpr auto level_col = ToNode::VERSION + 1;
+    for(const auto& row : res.rows()) {
+        auto *node = records.emplace_back().mutable_node();
+        ToNode::assign(row, *node);
+        last_id_ = node->uuid();
+        last_level_ = row.at(level_col).as_int64();
+    }
+}
+
+boost::asio::awaitable<void> TenantExporter::fetchDays(std::vector<pb::ExportRecord> &records)
+{
+    enum Cols {
+        DATE, USER, COLOR, NOTES, REPORT
+    };
+
+    const auto res = co_await server_.db().exec(
+        R"(SELECT date, user, color, notes, report FROM day
+            WHERE user IN (SELECT id FROM user WHERE tenant=?)
+            AND (user > ? OR (user = ? AND date > ?))
+            ORDER BY user, date LIMIT ?)",
+        tenant_, last_id_, last_id_, last_date_, batch_size_);
+
+    for(const auto& row : res.rows()) {
+        auto *cday = records.emplace_back().mutable_day();
+        auto *day = cday->mutable_day();
+        *day->mutable_date() = toDate(row.at(DATE).as_date());
+        day->set_user(row.at(USER).as_string());
+        if (row.at(COLOR).is_string()) {
+            day->set_color(row.at(COLOR).as_string());
+        }
+        if (row.at(NOTES).is_string()) {
+            day->set_hasnotes(true);
+            cday->set_notes(row.at(NOTES).as_string());
+        }
+        if (row.at(REPORT).is_string()) {
+            day->set_hasreport(true);
+            cday->set_report(row.at(REPORT).as_string());
+        }
+        last_id_ = day->user();
+        last_date_ = toAnsiDate(day->date());
+    }
+}
+
+boost::asio::awaitable<void> TenantExporter::fetchActions(std::vector<pb::ExportRecord> &records)
+{
+    enum Cols {
+        ID, NODE, PRIORITY, STATUS, NAME, DESCR, CREATED_DATE, DUE_TYPE, DUE_BY_TIME,
+        COMPLETED_TIME, TIME_ESTIMATE, DIFFICULTY, REPEAT_KIND, REPEAT_UNIT, REPEAT_AFTER
+    };
+
+    const auto res = co_await server_.db().exec(
+        R"(SELECT id, node, priority, status, name, descr, DATE(created_date), due_type,
+                CAST(UNIX_TIMESTAMP(due_by_time) AS SIGNED), CAST(UNIX_TIMESTAMP(completed_time) AS SIGNED),
+                time_estimate, difficulty, repeat_kind, repeat_unit, repeat_after
+            FROM action WHERE user IN (SELECT id FROM user WHERE tenant=?)
+            AND id > ? ORDER BY id LIMIT ?)",
+        tenant_, last_id_, batch_size_);
+
+    const auto asInt = [](const boost::mysql::field_view& value) -> int64_t {
+        return value.is_null() ? 0 : value.as_int64();
+    };
+
+    for(const auto& row : res.rows()) {
+        auto *action = records.emplace_back().mutable_action();
+        action->set_id(row.at(ID).as_string());
+        action->set_node(row.at(NODE).as_string());
+        action->set_priority(static_cast<int32_t>(row.at(PRIORITY).as_int64()));
+        action->set_status(toEnum(row.at(STATUS), pb::ActionStatus::ACTIVE));
+        action->set_name(row.at(NAME).as_string());
+        if (row.at(DESCR).is_string()) {
+            action->set_descr(row.at(DESCR).as_string());
+        }
+        if (!row.at(CREATED_DATE).is_null() && row.at(CREATED_DATE).as_date().valid()) {
+            *action->mutable_createddate() = toDate(row.at(CREATED_DATE).as_date());
+        }
+        action->set_duetype(toEnum(row.at(DUE_TYPE), pb::ActionDueType::DATETIME));
+        action->set_duebytime(asInt(row.at(DUE_BY_TIME)));
+        action->set_completedtime(asInt(row.at(COMPLETED_TIME)));
+        action->set_timeestimate(asInt(row.at(TIME_ESTIMATE)));
+        action->set_difficulty(toEnum(row.at(DIFFICULTY), pb::ActionDifficulty::NORMAL));
+        if (!row.at(REPEAT_KIND).is_null()) {
+            action->set_repeatkind(toEnum(row.at(REPEAT_KIND), pb::Action::NEVER));
+        }
+        action->set_repeatunits(toEnum(row.at(REPEAT_UNIT), pb::Action::DAYS));
+        action->set_repeatafter(static_cast<int32_t>(asInt(row.at(REPEAT_AFTER))));
+        last_id_ = action->id();
+    }
+}
+
+TenantImporter::TenantImporter(Server &server, size_t batchSize)
+    : server_{server}
+    , tenants_{"INSERT INTO tenant (id, name, kind, descr, active, properties) VALUES ", batchSize}
+    , users_{"INSERT INTO user (id, tenant, name, email, kind, active, descr, properties) VALUES ", batchSize}
+    , nodes_{"INSERT INTO node (id, user, name, kind, descr, active, parent, version) VALUES ", batchSize}
+    , days_{"INSERT INTO day (date, user, color, notes, report) VALUES ", batchSize}
+    , actions_{R"(INSERT INTO action (id, node, user, priority, status, name, descr, created_date,
+        due_type, due_by_time, completed_time, completed, time_estimate, difficulty,
+        repeat_kind, repeat_unit, repeat_after) VALUES )", batchSize}
+{
+}
+
+TenantImporter::~TenantImporter()
+{
+    if (trx_) {
+        LOG_WARN_N << "The import was not committed. Rolling back after " << summary();
+    }
+}
+
+boost::asio::awaitable<void> TenantImporter::begin()
+{
+    assert(!handle_);
+    handle_.emplace(co_await server_.db().getConnection());
+    trx_.emplace(co_await handle_->transaction());
+}
+
+void TenantImporter::addNode(const pb::Node &node)
+{
+    // The nodes are exported parent-first, so the parent is already added
+    nodes_.add(node.uuid(),
+               node.user(),
+               node.name(),
+               static_cast<int>(node.kind()),
+               node.descr(),
+               !node.has_active() || node.active(),
+               emptyAsNull(node.parent()),
+               std::max<int64_t>(node.version(), 1));
+    ++counts_.nodes;
+}
+
+boost::asio::awaitable<void> TenantImporter::add(const pb::ExportRecord &record)
+{
+    assert(handle_);
+
+    switch(record.what_case()) {
+    case pb::ExportRecord::kTenant: {
+        const auto& tenant = record.tenant();
+        tenants_.add(tenant.uuid(),
+                     tenant.name(),
+                     toDbName(tenant.has_kind() ? tenant.kind() : pb::Tenant::Guest),
+                     tenant.descr(),
+                     tenant.active(),
+                     toJson(tenant.properties()));
+        imported_tenants_.insert(tenant.uuid());
+        ++counts_.tenants;
+    } break;
+    case pb::ExportRecord::kUser: {
+        const auto& user = record.user();
+        users_.add(user.uuid(),
+                   user.tenant(),
+                   user.name(),
+                   user.email(),
+                   toDbName(user.has_kind() ? user.kind() : pb::User::Regular),
+                   !user.has_active() || user.active(),
+                   user.descr(),
+                   toJson(user.properties()));
+        imported_tenants_.insert(user.tenant());
+        ++counts_.users;
+    } break;
+    case pb::ExportRecord::kNode:
+        addNode(record.node());
+        break;
+    case pb::ExportRecord::kDay: {
+        const auto& cday = record.day();
+        days_.add(toAnsiDate(cday.day().date()),
+                  cday.day().user(),
+                  emptyAsNull(cday.day().color()),
+                  cday.has_notes() ? optional<string>{cday.notes()} : nullopt,
+                  cday.has_report() ? optional<string>{cday.report()} : nullopt);
+        ++counts_.days;
+    } break;
+    case pb::ExportRecord::kAction: {
+        const auto& action = record.action();
+        const bool repeats = action.has_repeatkind() && action.repeatkind() != pb::Action::NEVER;
+
+        optional<string> repeat_kind;
+        if (action.has_repeatkind()) {
+            if (action.repeatkind() == pb::Action::DONE) {
+                throw db_err{pb::Error::INVALID_REQUEST,
+                             format("Action {} has the repeat kind DONE, that can not be stored", action.id())};
+            }
+            repeat_kind = toDbName(action.repeatkind());
+        }
+
+        actions_.add(action.id(),
+                     action.node(),
+                     SqlExpr{"(SELECT user FROM node WHERE id=?)", {boost::mysql::field{action.node()}}},
+                     action.priority(),
+                     toDbName(action.status()),
+                     action.name(),
+                     action.descr(),
+                     action.has_createddate() ? SqlExpr{"?", {boost::mysql::field{toAnsiDate(action.createddate())}}}
+                                              : SqlExpr{"DEFAULT"},
+                     toDbName(action.duetype()),
+                     action.duebytime() ? optional{fromUnixTime(action.duebytime())} : nullopt,
+                     fromUnixTime(action.completedtime()),
+                     action.status() == pb::ActionStatus::DONE,
+                     action.timeestimate() ? optional{action.timeestimate()} : nullopt,
+                     toDbName(action.difficulty()),
+                     repeat_kind,
+                     repeats ? optional{toDbName(action.repeatunits())} : nullopt,
+                     repeats ? optional{action.repeatafter()} : nullopt);
+        ++counts_.actions;
+    } break;
+    case pb::ExportRecord::WHAT_NOT_SET:
+        LOG_WARN_N << "Ignoring empty export record";
+        break;
+    }
+
+    if (tenants_.full() || users_.full() || nodes_.full() || days_.full() || actions_.full()) {
+        co_await flush();
+    }
+}
+
+boost::asio::awaitable<void> TenantImporter::commit()
+{
+    assert(handle_);
+
+    co_await flush();
+
+    // The day statistics are normally maintained when a day is changed.
+    for(const auto& tenant : imported_tenants_) {
+        co_await rebuildDayStats(*handle_, tenant);
+    }
+
+    co_await trx_->commit();
+    trx_.reset();
+    handle_.reset();
+
+    LOG_INFO << "Imported " << summary();
+}
+
+boost::asio::awaitable<void> TenantImporter::abort()
+{
+    if (!handle_) {
+        co_return;
+    }
+
+    LOG_WARN_N << "Rolling back the import after " << summary();
+    trx_.reset();
+    handle_.reset();
+}
+
+string TenantImporter::summary() const
+{
+    return format("{} tenants, {} users, {} nodes, {} days and {} actions",
+                  counts_.tenants, counts_.users, counts_.nodes, counts_.days, counts_.actions);
+}
+
+boost::asio::awaitable<void> TenantImporter::flush()
+{
+    // In the same order as the export, so that the references are resolved
+    for(auto *batch : {&tenants_, &users_, &nodes_, &days_, &actions_}) {
+        if (!batch->empty()) {
+            LOG_TRACE_N << "Inserting " << batch->size() << " rows";
+            const auto rows = batch->take();
+            co_await handle_->exec(rows.query, rows.args());
+        }
+    }
+}
+
+boost::asio::awaitable<void> rebuildDayStats(Server::Db::Handle& handle, const std::string& tenant)
+{
+    // The statistics are built from the score applied to each day
+    co_await handle.exec(
+        R"(UPDATE day AS d LEFT JOIN day_colors AS c ON c.id = d.color SET d.score = c.score
+            WHERE d.user IN (SELECT id FROM user WHERE tenant=?))", tenant);
+    co_await handle.exec(
+        "DELETE FROM day_stats WHERE user IN (SELECT id FROM user WHERE tenant=?)", tenant);
+    co_await handle.exec(
+        R"(INSERT INTO day_stats (user, year, month, color, days, score)
+            SELECT d.user, YEAR(d.date), MONTH(d.date), d.color, COUNT(*), SUM(d.score)
+            FROM day AS d
+            WHERE d.color IS NOT NULL AND d.user IN (SELECT id FROM user WHERE tenant=?)
+            GROUP BY d.user, YEAR(d.date), MONTH(d.date), d.color)", tenant);
+    co_await handle.exec(
+        "DELETE FROM day_streak WHERE user IN (SELECT id FROM user WHERE tenant=?)", tenant);
+    co_await handle.exec(
+        R"(INSERT INTO day_streak (user, start, end)
+            SELECT user, MIN(date), MAX(date) FROM (
+                SELECT d.user, d.date, d.date - INTERVAL ROW_NUMBER() OVER (PARTITION BY d.user ORDER BY d.date) DAY AS grp
+                FROM day AS d
+                WHERE d.score > 0 AND d.user IN (SELECT id FROM user WHERE tenant=?)
+            ) AS t GROUP BY user, grp)", tenant);
+}
+
+boost::asio::awaitable<void> rebuildTimeSpent(Server::Db::Handle& handle, const std::string& tenant)
+{
+    co_await handle.exec(
+        "DELETE FROM time_spent WHERE user IN (SELECT id FROM user WHERE tenant=?)", tenant);
+    co_await handle.exec(
+        R"(INSERT INTO time_spent (user, period, start, node, used, paused)
+            SELECT user, period, start, node, SUM(used), SUM(paused) FROM (
+                SELECT n.user, p.period, period_start(p.period, DATE(w.start)) AS start, w.node, w.used, w.paused
+                FROM work AS w
+                JOIN node AS n ON n.id = w.node
+                CROSS JOIN (SELECT 'day' AS period UNION ALL SELECT 'week' UNION ALL SELECT 'month'
+                            UNION ALL SELECT 'quarter' UNION ALL SELECT 'year') AS p
+                WHERE n.user IN (SELECT id FROM user WHERE tenant=?)
+            ) AS t GROUP BY user, period, start, node)", tenant);
+}
+
+} // ns
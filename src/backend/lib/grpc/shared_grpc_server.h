@@ -0,0 +1,208 @@
+#pragma once
+
+// Helpers shared by the gRPC handlers and the other code that
+// converts between the database and our protobuf messages.
+
+#include <chrono>
+#include <format>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/json.hpp>
+#include <boost/mysql/date.hpp>
+#include <boost/mysql/row_view.hpp>
+#include <google/protobuf/util/json_util.h>
+
+#include "nextapp.pb.h"
+#include "nextapp/logging.h"
+#include "nextapp/errors.h"
+
+namespace nextapp::grpc {
+
+template <typename T>
+concept ProtoMessage = std::is_base_of_v<google::protobuf::Message, T>;
+
+template <ProtoMessage T>
+std::string toJson(const T& obj) {
+    std::string str;
+    auto res = google::protobuf::util::MessageToJsonString(obj, &str);
+    if (!res.ok()) {
+        LOG_DEBUG << "Failed to convert object to json: "
+                  << typeid(T).name() << ": "
+                  << res.ToString();
+        throw std::runtime_error{"Failed to convert object to json"};
+    }
+    return str;
+}
+
+template <typename T>
+concept ProtoStringStringMap = std::is_same_v<std::remove_cv<T>, std::remove_cv<::google::protobuf::Map<std::string, std::string>>>;
+
+
+template <ProtoStringStringMap T>
+std::string toJson(const T& map) {
+    boost::json::object o;
+
+    for(const auto [key, value] : map) {
+        o[key] = value;
+    }
+
+    return boost::json::serialize(o);
+}
+
+inline std::string toAnsiDate(const nextapp::pb::Date& date) {
+    return std::format("{:0>4d}-{:0>2d}-{:0>2d}", date.year(), date.month() + 1, date.mday());
+}
+
+inline void toDate(const boost::mysql::date& from, ::nextapp::pb::Date& date) {
+    assert(from.valid());
+    assert(from.month() > 0);
+    date.set_year(from.year());
+    date.set_month(from.month() -1); // Our range is 0 - 11, the db's range is 1 - 12
+    date.set_mday(from.day());
+}
+
+inline ::nextapp::pb::Date toDate(const boost::mysql::date& from) {
+    ::nextapp::pb::Date date;
+    toDate(from, date);
+    return date;
+}
+
+inline std::string toAnsiDate(const std::chrono::year_month_day& date) {
+    return std::format("{:0>4d}-{:0>2d}-{:0>2d}", static_cast<int>(date.year()),
+                       static_cast<unsigned>(date.month()), static_cast<unsigned>(date.day()));
+}
+
+inline ::nextapp::pb::Date toDate(const std::chrono::year_month_day& from) {
+    ::nextapp::pb::Date date;
+    date.set_year(static_cast<int>(from.year()));
+    date.set_month(static_cast<unsigned>(from.month()) - 1);
+    date.set_mday(static_cast<unsigned>(from.day()));
+    return date;
+}
+
+inline std::chrono::year_month_day toYearMonthDay(const nextapp::pb::Date& date) {
+    using namespace std::chrono;
+
+    const year_month_day ymd{year{date.year()},
+                             month{static_cast<unsigned>(date.month() + 1)},
+                             day{static_cast<unsigned>(date.mday())}};
+    if (!ymd.ok()) {
+        throw db_err{pb::Error::INVALID_REQUEST, std::format("Invalid date: {}", toAnsiDate(date))};
+    }
+
+    return ymd;
+}
+
+struct ToNode {
+    enum Cols {
+        ID, USER, NAME, KIND, DESCR, ACTIVE, PARENT, VERSION
+    };
+
+    static constexpr std::string_view selectCols = "id, user, name, kind, descr, active, parent, version";
+
+    // `RowT` is normally a boost::mysql::row_view
+    template <typename RowT>
+    static void assign(const RowT& row, pb::Node& node) {
+        node.set_uuid(row.at(ID).as_string());
+        node.set_user(row.at(USER).as_string());
+        node.set_name(row.at(NAME).as_string());
+        node.set_version(row.at(VERSION).as_int64());
+        const auto kind = row.at(KIND).as_int64();
+        if (pb::Node::Kind_IsValid(kind)) {
+            node.set_kind(static_cast<pb::Node::Kind>(kind));
+        }
+        if (!row.at(DESCR).is_null()) {
+            node.set_descr(row.at(DESCR).as_string());
+        }
+        node.set_active(row.at(ACTIVE).as_int64() != 0);
+        if (!row.at(PARENT).is_null()) {
+            node.set_parent(row.at(PARENT).as_string());
+        }
+    }
+};
+
+/*! Builds the tree from rows with ToNode::selectCols, ordered by parent.
+ *
+ *  If the reply is on an arena, all the items are allocated there, and
+ *  items that come before their parent are moved to it without a copy.
+ *
+ *  The rows with `rootParent` as their parent go into the root. If `withChildCount`
+ *  is set, the rows have one more column with the number of children for the node.
+ */
+template <typename RowsT>
+void buildNodeTree(const RowsT& rows, pb::NodeTree& reply,
+                   std::string_view rootParent = {}, bool withChildCount = false) {
+    constexpr auto child_count_col = ToNode::VERSION + 1;
+    auto *arena = reply.GetArena();
+    std::vector<pb::NodeTreeItem *> pending;
+    std::unordered_map<std::string_view, pb::NodeTreeItem *> known;
+    known.reserve(rows.size() + 1);
+
+    // Root level
+    known[rootParent] = reply.mutable_root();
+
+    for(const auto& row : rows) {
+        std::string_view parent;
+        if (!row.at(ToNode::PARENT).is_null()) {
+            parent = row.at(ToNode::PARENT).as_string();
+        }
+
+        pb::NodeTreeItem *item = {};
+        if (auto it = known.find(parent); it != known.end()) {
+            item = it->second->add_children();
+        } else {
+            // Track it for later
+            item = google::protobuf::Arena::CreateMessage<pb::NodeTreeItem>(arena);
+            pending.push_back(item);
+        }
+
+        ToNode::assign(row, *item->mutable_node());
+        if (withChildCount) {
+            item->set_childcount(static_cast<int32_t>(row.at(child_count_col).as_int64()));
+        }
+
+        // The items never move, so the pointers and the uuid's stay valid
+        known[item->node().uuid()] = item;
+    }
+
+    // By now, all the parents are in the known list. If one is not, the item is
+    // added to the root. It can't be deleted, as it may be the parent of other items.
+    for(auto *item : pending) {
+        if (auto it = known.find(item->node().parent()); it != known.end()) {
+            it->second->mutable_children()->AddAllocated(item);
+        } else {
+            LOG_WARN << "Node " << item->node().uuid() << " has an unknown parent "
+                     << item->node().parent() << ". Adding it to the root.";
+            reply.mutable_root()->mutable_children()->AddAllocated(item);
+        }
+    }
+}
+
+// Adds the days from rows with "date, user, color, ISNULL(notes), ISNULL(report)"
+template <typename RowsT>
+void buildMonth(const RowsT& rows, pb::Month& reply) {
+    enum Cols {
+        DATE, USER, COLOR, NOTES, REPORT
+    };
+
+    reply.mutable_days()->Reserve(static_cast<int>(rows.size()));
+
+    for(const auto& row : rows) {
+        const auto& date_val = row.at(DATE).as_date();
+        if (date_val.valid()) {
+            auto *current_day = reply.add_days();
+            toDate(date_val, *current_day->mutable_date());
+            current_day->set_user(row.at(USER).as_string());
+            if (row.at(COLOR).is_string()) {
+                current_day->set_color(row.at(COLOR).as_string());
+            }
+            current_day->set_hasnotes(row.at(NOTES).as_int64() != 1);
+            current_day->set_hasreport(row.at(REPORT).as_int64() != 1);
+        }
+    }
+}
+
+} // ns
@@ -12,5 +12,24 @@ std::string getEnv(const char *name, std::string def) {
     return def;
 }
 
+BulkInsert::BulkInsert(std::string prefix, size_t maxRows, std::string suffix)
+    : prefix_{std::move(prefix)}, suffix_{std::move(suffix)}, max_rows_{maxRows}
+{
+    query_ = prefix_;
+}
+
+BulkInsert::Batch BulkInsert::take()
+{
+    Batch rval{std::move(query_), std::move(values_)};
+    if (!suffix_.empty()) {
+        rval.query += ' ';
+        rval.query += suffix_;
+    }
+
+    query_ = prefix_;
+    values_.clear();
+    rows_ = 0;
+    return rval;
+}
 
 } // ns
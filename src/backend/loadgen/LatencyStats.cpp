@@ -0,0 +1,46 @@
+
+#include <algorithm>
+#include <limits>
+
+#include "LatencyStats.h"
+
+using namespace std;
+
+namespace nextapp::loadgen {
+
+void LatencyStats::add(duration_t duration)
+{
+    const auto us = chrono::duration_cast<chrono::microseconds>(duration).count();
+    lock_guard lock{mutex_};
+    micros_.push_back(static_cast<uint32_t>(min<int64_t>(us, numeric_limits<uint32_t>::max())));
+    ++count_;
+}
+
+LatencyStats::Summary LatencyStats::summary() const
+{
+    vector<uint32_t> samples;
+    {
+        lock_guard lock{mutex_};
+        samples = micros_;
+    }
+
+    Summary s;
+    s.count = samples.size();
+    s.failed = failed_;
+    if (samples.empty()) {
+        return s;
+    }
+
+    ranges::sort(samples);
+    const auto at = [&](double p) {
+        const auto ix = min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())));
+        return samples[ix] / 1000.0;
+    };
+    s.p50_ms = at(0.50);
+    s.p99_ms = at(0.99);
+    s.p999_ms = at(0.999);
+    s.max_ms = samples.back() / 1000.0;
+    return s;
+}
+
+} // ns
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace nextapp::loadgen {
+
+/*! Latencies for one kind of operation.
+ *
+ *  All the samples are kept, so the percentiles are exact.
+ */
+class LatencyStats {
+public:
+    using duration_t = std::chrono::steady_clock::duration;
+
+    struct Summary {
+        uint64_t count = 0;
+        uint64_t failed = 0;
+        double p50_ms = 0;
+        double p99_ms = 0;
+        double p999_ms = 0;
+        double max_ms = 0;
+    };
+
+    void add(duration_t duration);
+
+    void fail() noexcept {
+        ++failed_;
+    }
+
+    uint64_t count() const noexcept {
+        return count_;
+    }
+
+    uint64_t failed() const noexcept {
+        return failed_;
+    }
+
+    Summary summary() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<uint32_t> micros_;
+    std::atomic_uint64_t count_{0};
+    std::atomic_uint64_t failed_{0};
+};
+
+} // ns
@@ -0,0 +1,527 @@
+
+#include <algorithm>
+#include <condition_variable>
+#include <format>
+#include <iostream>
+#include <random>
+#include <thread>
+
+#include <boost/uuid/random_generator.hpp>
+#include <boost/uuid/uuid_io.hpp>
+
+#include "LoadGen.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace nextapp::loadgen {
+
+namespace {
+
+using Clock = chrono::steady_clock;
+
+template <typename T>
+bool replyOk(const T& reply) {
+    if constexpr (requires { reply.error(); }) {
+        return reply.error() == pb::Error::OK;
+    }
+    return true;
+}
+
+// Reads the updates for a device until it is cancelled
+class Subscription : public ::grpc::ClientReadReactor<pb::Update> {
+public:
+    Subscription(LoadGen& loadgen, pb::Nextapp::Stub& stub)
+        : loadgen_{loadgen} {
+        stub.async()->SubscribeToUpdates(&ctx_, &req_, this);
+        StartRead(&update_);
+        StartCall();
+    }
+
+    void OnReadDone(bool ok) override {
+        if (!ok) {
+            return; // OnDone() is next
+        }
+
+        if (update_.has_node() && update_.op() == pb::Update::ADDED) {
+            loadgen_.gotUpdate(update_.node().uuid());
+        }
+        StartRead(&update_);
+    }
+
+    void OnDone(const ::grpc::Status& status) override {
+        {
+            lock_guard lock{mutex_};
+            status_ = status;
+            done_ = true;
+        }
+        cv_.notify_all();
+    }
+
+    void cancel() {
+        ctx_.TryCancel();
+    }
+
+    // Waits until gRPC is done with the stream
+    ::grpc::Status wait() {
+        unique_lock lock{mutex_};
+        cv_.wait(lock, [this] { return done_; });
+        return status_;
+    }
+
+private:
+    LoadGen& loadgen_;
+    ::grpc::ClientContext ctx_;
+    pb::UpdatesReq req_;
+    pb::Update update_;
+    mutex mutex_;
+    condition_variable cv_;
+    ::grpc::Status status_;
+    bool done_ = false;
+};
+
+} // anon ns
+
+class Device : public enable_shared_from_this<Device> {
+public:
+    Device(LoadGen& loadgen, size_t id)
+        : loadgen_{loadgen}, id_{id}, stub_{loadgen.stub(id)}
+        , timer_{asio::make_strand(loadgen.ctx())}
+        , rnd_{random_device{}()} {
+
+        vector<double> weights;
+        for(const auto op : operations) {
+            const auto it = loadgen.config().mix.find(op);
+            weights.push_back(it == loadgen.config().mix.end() ? 0.0 : it->second);
+        }
+        pick_op_ = discrete_distribution<size_t>{weights.begin(), weights.end()};
+    }
+
+    void start() {
+        subscription_ = make_unique<Subscription>(loadgen_, stub_);
+        schedule();
+    }
+
+    void stop() {
+        stopped_ = true;
+        asio::post(timer_.get_executor(), [self=shared_from_this()] {
+            self->timer_.cancel();
+        });
+
+        if (subscription_) {
+            subscription_->cancel();
+            subscription_->wait();
+        }
+    }
+
+private:
+    // Open loop. The next request is scheduled regardless of when the replies arrive.
+    void schedule() {
+        exponential_distribution<double> interval{loadgen_.config().rate};
+        timer_.expires_after(chrono::duration_cast<Clock::duration>(
+            chrono::duration<double>{interval(rnd_)}));
+        timer_.async_wait([self=shared_from_this()](const boost::system::error_code& ec) {
+            if (ec || self->stopped_) {
+                return;
+            }
+            self->next();
+            self->schedule();
+        });
+    }
+
+    void next() {
+        if (in_flight_ >= loadgen_.config().max_in_flight) {
+            ++loadgen_.skipped();
+            return;
+        }
+
+        switch(pick_op_(rnd_)) {
+        case 0:
+            getNodes();
+            break;
+        case 1:
+            getMonth();
+            break;
+        case 2:
+            setColorOnDay();
+            break;
+        case 3:
+            createNode();
+            break;
+        case 4:
+            moveNode();
+            break;
+        case 5:
+            setDay();
+            break;
+        }
+    }
+
+    void getNodes() {
+        call<pb::GetNodesReq, pb::NodeTree>("GetNodes", {}, [](auto *async, auto *ctx, auto *req, auto *reply, auto done) {
+            async->GetNodes(ctx, req, reply, std::move(done));
+        });
+    }
+
+    void getMonth() {
+        pb::MonthReq req;
+        req.set_year(year());
+        req.set_month(static_cast<int32_t>(random(0, 11)));
+        call<pb::MonthReq, pb::Month>("GetMonth", std::move(req), [](auto *async, auto *ctx, auto *req, auto *reply, auto done) {
+            async->GetMonth(ctx, req, reply, std::move(done));
+        });
+    }
+
+    void setColorOnDay() {
+        pb::SetColorReq req;
+        *req.mutable_date() = randomDate();
+        req.set_color(randomColor());
+        call<pb::SetColorReq, pb::Status>("SetColorOnDay", std::move(req), [](auto *async, auto *ctx, auto *req, auto *reply, auto done) {
+            async->SetColorOnDay(ctx, req, reply, std::move(done));
+        });
+    }
+
+    void setDay() {
+        pb::CompleteDay req;
+        auto *day = req.mutable_day();
+        *day->mutable_date() = randomDate();
+        day->set_color(randomColor());
+        req.set_notes(format("Notes from device #{}", id_));
+        call<pb::CompleteDay, pb::Status>("SetDay", std::move(req), [](auto *async, auto *ctx, auto *req, auto *reply, auto done) {
+            async->SetDay(ctx, req, reply, std::move(done));
+        });
+    }
+
+    void createNode() {
+        pb::CreateNodeReq req;
+        {
+            unique_lock lock{mutex_};
+            if (nodes_.size() + pending_nodes_ >= loadgen_.config().max_nodes) {
+                moveNodeLocked(lock);
+                return;
+            }
+
+            // The first node is the root for the device
+            if (!nodes_.empty()) {
+                req.mutable_node()->set_parent(nodes_[random(0, nodes_.size() - 1)]);
+            }
+            ++pending_nodes_;
+        }
+
+        auto *node = req.mutable_node();
+        node->set_uuid(boost::uuids::to_string(uuid_gen_()));
+        node->set_name(format("Device #{} node", id_));
+        node->set_kind(pb::Node::FOLDER);
+
+        const auto uuid = node->uuid();
+        loadgen_.expectUpdate(uuid);
+
+        call<pb::CreateNodeReq, pb::Status>("CreateNode", std::move(req), [](auto *async, auto *ctx, auto *req, auto *reply, auto done) {
+            async->CreateNode(ctx, req, reply, std::move(done));
+        }, [this, uuid](bool ok) {
+            lock_guard lock{mutex_};
+            --pending_nodes_;
+            if (ok) {
+                nodes_.push_back(uuid);
+            } else {
+                loadgen_.forgetUpdate(uuid);
+            }
+        });
+    }
+
+    void moveNode() {
+        unique_lock lock{mutex_};
+        if (nodes_.size() < 3) {
+            lock.unlock();
+            createNode();
+            return;
+        }
+        moveNodeLocked(lock);
+    }
+
+    // A node is only moved to a node that was created before it, so there are no cycles
+    void moveNodeLocked(unique_lock<mutex>& lock) {
+        if (nodes_.size() < 3) {
+            return;
+        }
+
+        const auto node = random(1, nodes_.size() - 1);
+        pb::MoveNodeReq req;
+        req.set_uuid(nodes_[node]);
+        req.set_parentuuid(nodes_[random(0, node - 1)]);
+        lock.unlock();
+
+        call<pb::MoveNodeReq, pb::Status>("MoveNode", std::move(req), [](auto *async, auto *ctx, auto *req, auto *reply, auto done) {
+            async->MoveNode(ctx, req, reply, std::move(done));
+        });
+    }
+
+    template <typename ReqT, typename ReplyT, typename StartT>
+    void call(string_view name, ReqT req, StartT start) {
+        call<ReqT, ReplyT>(name, std::move(req), std::move(start), [](bool) {});
+    }
+
+    // Sends an unary request with the callback API
+    template <typename ReqT, typename ReplyT, typename StartT, typename DoneT>
+    void call(string_view name, ReqT req, StartT start, DoneT onDone) {
+        struct Call {
+            ::grpc::ClientContext ctx;
+            ReqT req;
+            ReplyT reply;
+            Clock::time_point started = Clock::now();
+        };
+
+        auto c = make_shared<Call>();
+        c->req = std::move(req);
+        c->ctx.set_deadline(chrono::system_clock::now() + 30s);
+
+        ++in_flight_;
+        ++loadgen_.inFlight();
+        auto& stats = loadgen_.stats(name);
+        start(stub_.async(), &c->ctx, &c->req, &c->reply,
+              [self=shared_from_this(), c, &stats, onDone=std::move(onDone)](const ::grpc::Status& status) mutable {
+            const auto elapsed = Clock::now() - c->started;
+            const bool ok = status.ok() && replyOk(c->reply);
+            if (ok) {
+                stats.add(elapsed);
+            } else {
+                stats.fail();
+                LOG_DEBUG << "Request failed: " << status.error_message();
+            }
+            onDone(ok);
+            --self->in_flight_;
+            --self->loadgen_.inFlight();
+        });
+    }
+
+    size_t random(size_t from, size_t to) {
+        return uniform_int_distribution<size_t>{from, to}(rnd_);
+    }
+
+    static int32_t year() {
+        static const auto year = static_cast<int>(chrono::year_month_day{
+            chrono::floor<chrono::days>(chrono::system_clock::now())}.year());
+        return year;
+    }
+
+    pb::Date randomDate() {
+        pb::Date date;
+        date.set_year(year());
+        date.set_month(static_cast<int32_t>(random(0, 11)));
+        date.set_mday(static_cast<int32_t>(random(1, 28)));
+        return date;
+    }
+
+    string randomColor() {
+        const auto& colors = loadgen_.colors();
+        if (colors.empty()) {
+            return {};
+        }
+        // Sometimes clear the color
+        const auto ix = random(0, colors.size());
+        return ix < colors.size() ? colors[ix] : string{};
+    }
+
+    LoadGen& loadgen_;
+    const size_t id_;
+    pb::Nextapp::Stub& stub_;
+    asio::steady_timer timer_;
+    // Only used from the timer's strand
+    mt19937 rnd_;
+    discrete_distribution<size_t> pick_op_;
+    boost::uuids::random_generator uuid_gen_;
+    unique_ptr<Subscription> subscription_;
+    atomic_bool stopped_{false};
+    atomic_size_t in_flight_{0};
+    mutex mutex_;
+    vector<string> nodes_;
+    size_t pending_nodes_ = 0;
+};
+
+LoadGen::LoadGen(const LoadConfig &config)
+    : config_{config}
+{
+    for(const auto op : operations) {
+        stats_.try_emplace(string{op});
+    }
+}
+
+LoadGen::~LoadGen()
+{
+    ctx_.stop();
+}
+
+bool LoadGen::run()
+{
+    if (!connect() || !fetchColors()) {
+        return false;
+    }
+
+    auto work = asio::make_work_guard(ctx_);
+    vector<jthread> threads;
+    for(size_t i = 0; i < max<size_t>(config_.threads, 1); ++i) {
+        threads.emplace_back([this] {
+            ctx_.run();
+        });
+    }
+
+    const auto num_devices = config_.numDevices();
+    cout << format("Simulating {} devices ({} tenants x {} users x {} devices) at {} requests/sec each, for {} seconds\n",
+                   num_devices, config_.tenants, config_.users, config_.devices,
+                   config_.rate, config_.duration_sec);
+
+    const auto start = Clock::now();
+    devices_.reserve(num_devices);
+    for(size_t i = 0; i < num_devices; ++i) {
+        devices_.emplace_back(make_shared<Device>(*this, i));
+        devices_.back()->start();
+    }
+
+    const auto end = start + chrono::seconds{config_.duration_sec};
+    const chrono::seconds interval{max<size_t>(config_.report_interval_sec, 1)};
+    for(auto now = Clock::now(); now < end; now = Clock::now()) {
+        this_thread::sleep_for(min<Clock::duration>(interval, end - now));
+        report(Clock::now() - start);
+    }
+
+    const auto elapsed = Clock::now() - start;
+
+    LOG_INFO << "Stopping the devices...";
+    for(auto& device : devices_) {
+        device->stop();
+    }
+
+    // Let the requests in progress finish, so they are counted
+    for(auto i = 0; i < 300 && in_flight_; ++i) {
+        this_thread::sleep_for(100ms);
+    }
+
+    finalReport(elapsed);
+
+    work.reset();
+    ctx_.stop();
+    return true;
+}
+
+bool LoadGen::connect()
+{
+    for(size_t i = 0; i < max<size_t>(config_.channels, 1); ++i) {
+        // Without a local pool, the channels would share one connection
+        ::grpc::ChannelArguments args;
+        args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+        auto channel = ::grpc::CreateCustomChannel(config_.server, ::grpc::InsecureChannelCredentials(), args);
+        if (!channel->WaitForConnected(chrono::system_clock::now() + 10s)) {
+            cerr << "Failed to connect to " << config_.server << endl;
+            return false;
+        }
+        stubs_.emplace_back(pb::Nextapp::NewStub(channel));
+        channels_.emplace_back(std::move(channel));
+    }
+    return true;
+}
+
+bool LoadGen::fetchColors()
+{
+    pb::Empty req;
+    pb::DayColorDefinitions reply;
+
+    // The server replies with UNAVAILABLE until it's done starting up
+    for(auto retries = 60;; --retries) {
+        ::grpc::ClientContext ctx;
+        ctx.set_deadline(chrono::system_clock::now() + 10s);
+        const auto status = stubs_.front()->GetDayColorDefinitions(&ctx, req, &reply);
+        if (status.ok()) {
+            break;
+        }
+        if (status.error_code() != ::grpc::StatusCode::UNAVAILABLE || retries <= 0) {
+            cerr << "Failed to get the day colors: " << status.error_message() << endl;
+            return false;
+        }
+        this_thread::sleep_for(500ms);
+    }
+
+    for(const auto& color : reply.daycolors()) {
+        colors_.emplace_back(color.id());
+    }
+    return true;
+}
+
+void LoadGen::expectUpdate(const std::string &key)
+{
+    lock_guard lock{pending_mutex_};
+    pending_[key] = {Clock::now()};
+}
+
+void LoadGen::forgetUpdate(const std::string &key)
+{
+    lock_guard lock{pending_mutex_};
+    pending_.erase(key);
+}
+
+void LoadGen::gotUpdate(const std::string &key)
+{
+    const auto now = Clock::now();
+    lock_guard lock{pending_mutex_};
+    if (auto it = pending_.find(key); it != pending_.end()) {
+        propagation_.add(now - it->second.sent);
+        if (++it->second.received >= config_.numDevices()) {
+            pending_.erase(it);
+        }
+    }
+}
+
+void LoadGen::report(std::chrono::steady_clock::duration elapsed)
+{
+    uint64_t count = 0;
+    uint64_t failed = 0;
+    for(const auto& [_, stats] : stats_) {
+        count += stats.count();
+        failed += stats.failed();
+    }
+
+    const auto seconds = max<size_t>(config_.report_interval_sec, 1);
+    const auto propagation = propagation_.summary();
+    cout << format("[{:>5}s] {:>9.1f} req/s, {} failed, {} skipped, {} in flight, propagation p99 {:.1f} ms\n",
+                   chrono::duration_cast<chrono::seconds>(elapsed).count(),
+                   static_cast<double>(count - last_count_) / static_cast<double>(seconds),
+                   failed, skipped_.load(), in_flight_.load(), propagation.p99_ms);
+    last_count_ = count;
+}
+
+void LoadGen::finalReport(std::chrono::steady_clock::duration elapsed)
+{
+    const auto seconds = chrono::duration<double>(elapsed).count();
+
+    const auto line = [&](string_view name, const LatencyStats::Summary& s) {
+        cout << format("{:<18} {:>10} {:>8} {:>10.1f} {:>9.2f} {:>9.2f} {:>9.2f} {:>9.2f}\n",
+                       name, s.count, s.failed, static_cast<double>(s.count) / seconds,
+                       s.p50_ms, s.p99_ms, s.p999_ms, s.max_ms);
+    };
+
+    cout << format("\n{:<18} {:>10} {:>8} {:>10} {:>9} {:>9} {:>9} {:>9}\n",
+                   "Operation", "OK", "Failed", "Per sec", "p50 ms", "p99 ms", "p99.9 ms", "Max ms");
+
+    LatencyStats::Summary total;
+    for(const auto& [name, stats] : stats_) {
+        const auto s = stats.summary();
+        total.count += s.count;
+        total.failed += s.failed;
+        line(name, s);
+    }
+    cout << format("{:<18} {:>10} {:>8} {:>10.1f}\n", "Total", total.count, total.failed,
+                   static_cast<double>(total.count) / seconds);
+
+    // Publish to each device that received it
+    line("Update propagation", propagation_.summary());
+
+    size_t incomplete = 0;
+    {
+        lock_guard lock{pending_mutex_};
+        incomplete = pending_.size();
+    }
+    cout << format("\nSkipped requests (device over --max-in-flight): {}\n", skipped_.load())
+         << format("Updates that did not reach all {} devices: {}\n", config_.numDevices(), incomplete);
+}
+
+} // ns
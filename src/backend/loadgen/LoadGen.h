@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <grpcpp/grpcpp.h>
+
+#include "nextapp.grpc.pb.h"
+#include "LatencyStats.h"
+
+namespace nextapp::loadgen {
+
+// The RPC's the simulated devices use, in addition to SubscribeToUpdates
+constexpr std::array<std::string_view, 6> operations = {
+    "GetNodes", "GetMonth", "SetColorOnDay", "CreateNode", "MoveNode", "SetDay"
+};
+
+struct LoadConfig {
+    std::string server = "127.0.0.1:10321";
+
+    // The number of simulated devices is tenants * users * devices
+    size_t tenants = 1;
+    size_t users = 1;
+    size_t devices = 2;
+
+    // Requests per second from each device. The requests are sent at random
+    // intervals, regardless of how fast the server replies.
+    double rate = 1.0;
+
+    size_t duration_sec = 60;
+    size_t report_interval_sec = 10;
+
+    // Threads for the timers that schedule the requests
+    size_t threads = 2;
+
+    // gRPC channels (TCP connections) shared by the devices
+    size_t channels = 4;
+
+    // Nodes each device creates before CreateNode is replaced by MoveNode
+    size_t max_nodes = 50;
+
+    // Requests a device can have in progress. Requests over the limit are skipped and counted.
+    size_t max_in_flight = 16;
+
+    // Relative weight for each operation
+    std::map<std::string, unsigned, std::less<>> mix = {
+        {"GetNodes", 20}, {"GetMonth", 30}, {"SetColorOnDay", 20},
+        {"CreateNode", 10}, {"MoveNode", 10}, {"SetDay", 10}
+    };
+
+    size_t numDevices() const noexcept {
+        return tenants * users * devices;
+    }
+};
+
+class Device;
+
+/*! Simulates many devices that use nextappd at the same time.
+ *
+ *  Each device holds a SubscribeToUpdates stream and sends a mix of
+ *  requests. The nodes a device creates are tracked until the update
+ *  reaches all the devices, to measure the propagation delay.
+ */
+class LoadGen {
+public:
+    explicit LoadGen(const LoadConfig& config);
+    ~LoadGen();
+
+    // Runs the load for the configured duration and prints the report.
+    // Returns false if the load could not be started.
+    bool run();
+
+    const LoadConfig& config() const noexcept {
+        return config_;
+    }
+
+    boost::asio::io_context& ctx() noexcept {
+        return ctx_;
+    }
+
+    pb::Nextapp::Stub& stub(size_t device) noexcept {
+        return *stubs_[device % stubs_.size()];
+    }
+
+    LatencyStats& stats(std::string_view operation) {
+        return stats_.find(operation)->second;
+    }
+
+    // Color-id's that can be set on days
+    const std::vector<std::string>& colors() const noexcept {
+        return colors_;
+    }
+
+    std::atomic_size_t& inFlight() noexcept {
+        return in_flight_;
+    }
+
+    std::atomic_uint64_t& skipped() noexcept {
+        return skipped_;
+    }
+
+    // Call before the request that causes the update is sent
+    void expectUpdate(const std::string& key);
+
+    // Call if the request that should cause the update failed
+    void forgetUpdate(const std::string& key);
+
+    // Called by each device that receives the update
+    void gotUpdate(const std::string& key);
+
+private:
+    bool connect();
+    bool fetchColors();
+    void report(std::chrono::steady_clock::duration elapsed);
+    void finalReport(std::chrono::steady_clock::duration elapsed);
+
+    struct Pending {
+        std::chrono::steady_clock::time_point sent;
+        size_t received = 0;
+    };
+
+    const LoadConfig config_;
+    boost::asio::io_context ctx_;
+    std::vector<std::shared_ptr<::grpc::Channel>> channels_;
+    std::vector<std::unique_ptr<pb::Nextapp::Stub>> stubs_;
+    std::map<std::string, LatencyStats, std::less<>> stats_;
+    LatencyStats propagation_;
+    std::mutex pending_mutex_;
+    std::unordered_map<std::string, Pending> pending_;
+    std::vector<std::string> colors_;
+    std::vector<std::shared_ptr<Device>> devices_;
+    std::atomic_size_t in_flight_{0};
+    std::atomic_uint64_t skipped_{0};
+    uint64_t last_count_ = 0;
+};
+
+} // ns
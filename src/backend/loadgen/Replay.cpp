@@ -0,0 +1,223 @@
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include "Replay.h"
+#include "nextapp/logging.h"
+
+using namespace std;
+namespace asio = boost::asio;
+
+namespace nextapp::loadgen {
+
+namespace {
+
+// State for one request, until gRPC is done with it
+struct Call {
+    ::grpc::ClientContext ctx;
+    ::grpc::ByteBuffer request;
+    ::grpc::ByteBuffer reply;
+};
+
+} // anon ns
+
+Replay::Replay(const ReplayConfig &config)
+    : config_{config}
+{
+}
+
+Replay::~Replay()
+{
+    ctx_.stop();
+}
+
+void Replay::load()
+{
+    ifstream in{config_.path, ios::in | ios::binary};
+    if (!in) {
+        throw runtime_error{format("Failed to open the recording '{}'", config_.path)};
+    }
+
+    google::protobuf::io::IstreamInputStream stream{&in};
+    while(true) {
+        pb::TrafficRecord rec;
+        bool clean_eof = false;
+        if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(&rec, &stream, &clean_eof)) {
+            if (clean_eof) {
+                break;
+            }
+            throw runtime_error{format("Failed to read record #{} from {}", records_.size() + 1, config_.path)};
+        }
+        records_.emplace_back(std::move(rec));
+    }
+
+    // The records are written when the requests are done. Replay them in the order they arrived.
+    ranges::stable_sort(records_, {}, &pb::TrafficRecord::offsetus);
+
+    map<string, User *, less<>> users;
+    for(const auto& rec : records_) {
+        auto& user = users[rec.user()];
+        if (!user) {
+            const auto id = users_.size();
+            user = users_.emplace_back(make_unique<User>(ctx_, id)).get();
+        }
+        user->records.push_back(&rec);
+
+        auto& stats = stats_[rec.method()];
+        if (rec.status() == static_cast<int32_t>(::grpc::StatusCode::OK)) {
+            stats.recorded.add(chrono::microseconds{rec.durationus()});
+        } else {
+            stats.recorded.fail();
+        }
+    }
+
+    LOG_INFO << format("Read {} requests from {} users from {}", records_.size(), users_.size(), config_.path);
+}
+
+bool Replay::run()
+{
+    if (records_.empty()) {
+        LOG_WARN << "There are no requests to replay.";
+        return true;
+    }
+
+    if (!connect()) {
+        return false;
+    }
+
+    const auto recorded_us = records_.back().offsetus() - records_.front().offsetus();
+    LOG_INFO << format("Replaying {:.1f} seconds of traffic at {}x speed.",
+                       static_cast<double>(recorded_us) / 1'000'000.0, config_.speed);
+
+    done_.emplace(static_cast<ptrdiff_t>(users_.size()));
+
+    auto work = asio::make_work_guard(ctx_);
+    vector<jthread> threads;
+    for(size_t i = 0; i < max<size_t>(config_.threads, 1); ++i) {
+        threads.emplace_back([this] {
+            ctx_.run();
+        });
+    }
+
+    start_ = clock_t::now();
+    for(auto& user : users_) {
+        asio::post(ctx_, [this, user=user.get()] {
+            schedule(*user);
+        });
+    }
+
+    done_->wait();
+    const auto elapsed = clock_t::now() - start_;
+
+    work.reset();
+    ctx_.stop();
+    threads.clear();
+
+    report(elapsed);
+    return true;
+}
+
+bool Replay::connect()
+{
+    for(size_t i = 0; i < max<size_t>(config_.channels, 1); ++i) {
+        // Without a local pool, the channels would share one connection
+        ::grpc::ChannelArguments args;
+        args.SetInt(GRPC_ARG_USE_LOCAL_SUBCHANNEL_POOL, 1);
+        auto channel = ::grpc::CreateCustomChannel(config_.server, ::grpc::InsecureChannelCredentials(), args);
+        if (!channel->WaitForConnected(chrono::system_clock::now() + 10s)) {
+            cerr << "Failed to connect to " << config_.server << endl;
+            return false;
+        }
+        stubs_.emplace_back(make_unique<::grpc::GenericStub>(channel));
+        channels_.emplace_back(std::move(channel));
+    }
+    return true;
+}
+
+void Replay::schedule(User &user)
+{
+    if (user.next >= user.records.size()) {
+        done_->count_down();
+        return;
+    }
+
+    const auto& rec = *user.records[user.next];
+    const chrono::duration<double, micro> offset{
+        static_cast<double>(rec.offsetus() - records_.front().offsetus()) / config_.speed};
+    const auto due = start_ + chrono::duration_cast<clock_t::duration>(offset);
+
+    user.timer.expires_at(due);
+    user.timer.async_wait([this, &user, due](const boost::system::error_code& ec) {
+        if (ec) {
+            done_->count_down();
+            return;
+        }
+        lag_.add(clock_t::now() - due);
+        send(user);
+    });
+}
+
+void Replay::send(User &user)
+{
+    const auto& rec = *user.records[user.next];
+
+    auto call = make_shared<Call>();
+    call->ctx.set_deadline(chrono::system_clock::now() + chrono::seconds{config_.timeout_sec});
+    ::grpc::Slice payload{rec.payload()};
+    call->request = ::grpc::ByteBuffer{&payload, 1};
+
+    const auto sent = clock_t::now();
+    auto& stub = *stubs_[user.id % stubs_.size()];
+    stub.UnaryCall(&call->ctx, format("/nextapp.pb.Nextapp/{}", rec.method()), ::grpc::StubOptions{},
+                   &call->request, &call->reply,
+                   [this, &user, &rec, call, sent](::grpc::Status status) {
+        auto& stats = stats_.find(rec.method())->second;
+        if (status.ok()) {
+            stats.replayed.add(clock_t::now() - sent);
+        } else {
+            LOG_DEBUG_N << rec.method() << " failed: " << status.error_message();
+            stats.replayed.fail();
+        }
+        if (static_cast<int32_t>(status.error_code()) != rec.status()) {
+            ++status_changed_;
+        }
+
+        // The next request from this user can not be sent before this one is done
+        ++user.next;
+        schedule(user);
+    });
+}
+
+void Replay::report(clock_t::duration elapsed)
+{
+    const auto seconds = chrono::duration<double>(elapsed).count();
+    const auto recorded_sec = static_cast<double>(records_.back().offsetus() - records_.front().offsetus()) / 1'000'000.0;
+
+    cout << "\nLatencies in ms. The recorded ones are measured in the server, the replayed ones in the client.\n";
+    cout << format("{:<18} {:>8} {:>8} {:>8} {:>10} {:>10} {:>10} {:>10} {:>10} {:>10} {:>7}\n",
+                   "Operation", "Recorded", "Replayed", "Failed",
+                   "p50 rec", "p50 now", "p99 rec", "p99 now", "max rec", "max now", "p99 x");
+
+    for(const auto& [name, stats] : stats_) {
+        const auto rec = stats.recorded.summary();
+        const auto now = stats.replayed.summary();
+        cout << format("{:<18} {:>8} {:>8} {:>8} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>10.2f} {:>7.2f}\n",
+                       name, rec.count + rec.failed, now.count + now.failed, now.failed,
+                       rec.p50_ms, now.p50_ms, rec.p99_ms, now.p99_ms, rec.max_ms, now.max_ms,
+                       rec.p99_ms > 0 ? now.p99_ms / rec.p99_ms : 0.0);
+    }
+
+    const auto lag = lag_.summary();
+    cout << format("\nRecorded traffic: {:.1f} seconds. Replayed in {:.1f} seconds at {}x speed.\n",
+                   recorded_sec, seconds, config_.speed)
+         << format("Schedule lag (ms): p50 {:.2f}, p99 {:.2f}, max {:.2f}\n", lag.p50_ms, lag.p99_ms, lag.max_ms)
+         << format("Requests with another status than when recorded: {}\n", status_changed_.load());
+}
+
+} // ns
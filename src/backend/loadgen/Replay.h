@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <latch>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <grpcpp/grpcpp.h>
+#include <grpcpp/generic/generic_stub.h>
+
+#include "nextapp.pb.h"
+#include "LatencyStats.h"
+
+namespace nextapp::loadgen {
+
+struct ReplayConfig {
+    std::string server = "127.0.0.1:10321";
+
+    // Recording from nextappd --record-traffic
+    std::string path;
+
+    // 1.0 sends the requests with the recorded intervals, 2.0 twice as fast
+    double speed = 1.0;
+
+    // Threads for the timers that schedule the requests
+    size_t threads = 2;
+
+    // gRPC channels (TCP connections) shared by the users
+    size_t channels = 4;
+
+    size_t timeout_sec = 10;
+};
+
+/*! Sends the requests from a traffic recording to nextappd again.
+ *
+ *  The requests are sent at the recorded times from the start of the
+ *  recording, divided by the speed. The requests from one user are sent one
+ *  at the time in the recorded order, so a request that is due while the
+ *  previous one from the same user is in progress is sent when that one is
+ *  done. That delay is reported as the schedule lag.
+ *
+ *  The requests are sent with the payload from the recording, as raw bytes,
+ *  or as empty messages if the recording has no payloads.
+ */
+class Replay {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    explicit Replay(const ReplayConfig& config);
+    ~Replay();
+
+    // Reads the recording. Throws if it can not be read.
+    void load();
+
+    // Sends the requests and prints the report. Returns false if it could not connect.
+    bool run();
+
+private:
+    struct User {
+        User(boost::asio::io_context& ctx, size_t id)
+            : timer{ctx}, id{id} {}
+
+        boost::asio::steady_timer timer;
+        const size_t id;
+        std::vector<const pb::TrafficRecord *> records;
+        size_t next = 0;
+    };
+
+    // Latencies measured by the server when the traffic was recorded, and
+    // by the client when it is replayed.
+    struct MethodStats {
+        LatencyStats recorded;
+        LatencyStats replayed;
+    };
+
+    bool connect();
+    void schedule(User& user);
+    void send(User& user);
+    void report(clock_t::duration elapsed);
+
+    const ReplayConfig config_;
+    boost::asio::io_context ctx_;
+    std::vector<std::shared_ptr<::grpc::Channel>> channels_;
+    std::vector<std::unique_ptr<::grpc::GenericStub>> stubs_;
+    std::vector<pb::TrafficRecord> records_;
+    std::vector<std::unique_ptr<User>> users_;
+    std::map<std::string, MethodStats, std::less<>> stats_;
+    LatencyStats lag_;
+    std::optional<std::latch> done_;
+    clock_t::time_point start_;
+    std::atomic_uint64_t status_changed_{0};
+};
+
+} // ns
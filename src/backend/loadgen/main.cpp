@@ -0,0 +1,121 @@
+/* Load generator for nextappd.
+ *
+ * Simulates many devices that each hold a SubscribeToUpdates stream and
+ * send a mix of requests, and reports the throughput, the latencies and
+ * how long it takes before an update reaches all the devices.
+ *
+ * This file is free and open source code, released under the
+ * GNU GENERAL PUBLIC LICENSE version 3.
+ */
+
+#include <iostream>
+#include <filesystem>
+#include <format>
+#include <ranges>
+#include <boost/program_options.hpp>
+
+#include "nextapp/logging.h"
+#include "LoadGen.h"
+
+using namespace std;
+using namespace nextapp::loadgen;
+
+namespace {
+
+// "GetNodes=20,GetMonth=30" -> weights. Operations that are not listed are not used.
+map<string, unsigned, less<>> parseMix(string_view spec) {
+    map<string, unsigned, less<>> mix;
+    for(const auto part : views::split(spec, ',')) {
+        const string_view item{part.begin(), part.end()};
+        const auto eq = item.find('=');
+        const auto name = item.substr(0, eq);
+        if (eq == string_view::npos || ranges::find(operations, name) == operations.end()) {
+            throw runtime_error{format("Invalid item '{}' in --mix", item)};
+        }
+        mix[string{name}] = static_cast<unsigned>(stoul(string{item.substr(eq + 1)}));
+    }
+    return mix;
+}
+
+} // anon ns
+
+int main(int argc, char* argv[]) {
+    LoadConfig config;
+    string log_level = "info";
+    string mix;
+
+    const auto appname = filesystem::path(argv[0]).stem().string();
+
+    namespace po = boost::program_options;
+    po::options_description general("Options");
+    general.add_options()
+        ("help,h", "Print help and exit")
+        ("log-to-console,C", po::value(&log_level)->default_value(log_level),
+         "Log-level to the console; one of 'info', 'debug', 'trace'. Empty string to disable.")
+        ("server,s", po::value(&config.server)->default_value(config.server),
+         "Address and port for nextappd")
+        ("tenants", po::value(&config.tenants)->default_value(config.tenants),
+         "Number of simulated tenants")
+        ("users", po::value(&config.users)->default_value(config.users),
+         "Number of simulated users in each tenant")
+        ("devices", po::value(&config.devices)->default_value(config.devices),
+         "Number of simulated devices for each user")
+        ("rate,r", po::value(&config.rate)->default_value(config.rate),
+         "Requests per second from each device")
+        ("duration,d", po::value(&config.duration_sec)->default_value(config.duration_sec),
+         "Seconds to run the load")
+        ("report-interval", po::value(&config.report_interval_sec)->default_value(config.report_interval_sec),
+         "Seconds between the progress reports")
+        ("threads", po::value(&config.threads)->default_value(config.threads),
+         "Threads for scheduling the requests")
+        ("channels", po::value(&config.channels)->default_value(config.channels),
+         "gRPC connections shared by the devices")
+        ("max-nodes", po::value(&config.max_nodes)->default_value(config.max_nodes),
+         "Nodes each device creates. After that, CreateNode is replaced by MoveNode")
+        ("max-in-flight", po::value(&config.max_in_flight)->default_value(config.max_in_flight),
+         "Requests each device can have in progress. Requests over the limit are skipped")
+        ("mix", po::value(&mix),
+         "Relative weight for each operation, like 'GetNodes=20,GetMonth=30,SetColorOnDay=20,"
+         "CreateNode=10,MoveNode=10,SetDay=10' (the default)")
+        ;
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(general).run(), vm);
+        po::notify(vm);
+        if (!mix.empty()) {
+            config.mix = parseMix(mix);
+        }
+    } catch (const std::exception& ex) {
+        cerr << appname
+             << " Failed to parse command-line arguments: " << ex.what() << endl;
+        return -1;
+    }
+
+    if (vm.count("help")) {
+        std::cout << appname << " [options]";
+        std::cout << general << std::endl;
+        return -2;
+    }
+
+    if (!config.numDevices() || config.rate <= 0.0 || config.max_nodes < 3) {
+        cerr << appname << " Need at least one device, a positive rate and --max-nodes of 3 or more" << endl;
+        return -1;
+    }
+
+    if (!log_level.empty()) {
+        const auto level = log_level == "trace" ? logfault::LogLevel::TRACE
+                           : log_level == "debug" ? logfault::LogLevel::DEBUGGING
+                                                  : logfault::LogLevel::INFO;
+        logfault::LogManager::Instance().AddHandler(
+            make_unique<logfault::StreamHandler>(clog, level));
+    }
+
+    try {
+        LoadGen loadgen{config};
+        return loadgen.run() ? 0 : -3;
+    } catch (const exception& ex) {
+        LOG_ERROR << "Caught exception: " << ex.what();
+        return -5;
+    }
+}
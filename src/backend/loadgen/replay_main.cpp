@@ -0,0 +1,86 @@
+/* Replays traffic recorded by nextappd --record-traffic.
+ *
+ * Sends the recorded requests to nextappd with the same intervals, or
+ * faster, and compares the latencies with the ones that were recorded.
+ *
+ * This file is free and open source code, released under the
+ * GNU GENERAL PUBLIC LICENSE version 3.
+ */
+
+#include <iostream>
+#include <filesystem>
+#include <boost/program_options.hpp>
+
+#include "nextapp/logging.h"
+#include "Replay.h"
+
+using namespace std;
+using namespace nextapp::loadgen;
+
+int main(int argc, char* argv[]) {
+    ReplayConfig config;
+    string log_level = "info";
+
+    const auto appname = filesystem::path(argv[0]).stem().string();
+
+    namespace po = boost::program_options;
+    po::options_description general("Options");
+    general.add_options()
+        ("help,h", "Print help and exit")
+        ("log-to-console,C", po::value(&log_level)->default_value(log_level),
+         "Log-level to the console; one of 'info', 'debug', 'trace'. Empty string to disable.")
+        ("server,s", po::value(&config.server)->default_value(config.server),
+         "Address and port for nextappd")
+        ("recording,f", po::value(&config.path),
+         "File from nextappd --record-traffic")
+        ("speed", po::value(&config.speed)->default_value(config.speed),
+         "Replay speed. 1 keeps the recorded intervals between the requests, 2 sends them twice as fast")
+        ("threads", po::value(&config.threads)->default_value(config.threads),
+         "Threads for scheduling the requests")
+        ("channels", po::value(&config.channels)->default_value(config.channels),
+         "gRPC connections shared by the users")
+        ("timeout", po::value(&config.timeout_sec)->default_value(config.timeout_sec),
+         "Seconds before a request fails")
+        ;
+
+    po::positional_options_description positional;
+    positional.add("recording", 1);
+
+    po::variables_map vm;
+    try {
+        po::store(po::command_line_parser(argc, argv).options(general).positional(positional).run(), vm);
+        po::notify(vm);
+    } catch (const std::exception& ex) {
+        cerr << appname
+             << " Failed to parse command-line arguments: " << ex.what() << endl;
+        return -1;
+    }
+
+    if (vm.count("help")) {
+        std::cout << appname << " [options] recording";
+        std::cout << general << std::endl;
+        return -2;
+    }
+
+    if (config.path.empty() || config.speed <= 0.0) {
+        cerr << appname << " Need a recording and a positive speed" << endl;
+        return -1;
+    }
+
+    if (!log_level.empty()) {
+        const auto level = log_level == "trace" ? logfault::LogLevel::TRACE
+                           : log_level == "debug" ? logfault::LogLevel::DEBUGGING
+                                                  : logfault::LogLevel::INFO;
+        logfault::LogManager::Instance().AddHandler(
+            make_unique<logfault::StreamHandler>(clog, level));
+    }
+
+    try {
+        Replay replay{config};
+        replay.load();
+        return replay.run() ? 0 : -3;
+    } catch (const exception& ex) {
+        LOG_ERROR << "Caught exception: " << ex.what();
+        return -5;
+    }
+}
@@ -16,6 +16,7 @@
 
 #include <iostream>
 #include <filesystem>
+#include <format>
 #include <boost/program_options.hpp>
 #include <boost/asio.hpp>
 
@@ -27,23 +28,195 @@
 using namespace std;
 using namespace nextapp;
 using nextapp::logging::LogEvent;
+namespace po = boost::program_options;
 
 namespace {
 
-optional<logfault::LogLevel> toLogLevel(string_view name) {
-    if (name.empty() || name == "off" || name == "false") {
-        return {};
-    }
+// Options that are only used when the program starts
+struct StartupOptions {
+    bool bootstrap = false;
+    std::string export_file;
+    std::string import_file;
+    std::string export_tenant;
+    std::string config_file;
+};
 
-    if (name == "debug") {
-        return logfault::LogLevel::DEBUGGING;
-    }
+po::options_description makeOptions(Config& config, Server::BootstrapOptions& bootstrapOpts, StartupOptions& opts) {
+    po::options_description general("Options");
+    general.add_options()
+        ("help,h", "Print help and exit")
+        ("version,v", "Print version and exit")
+        ("config,c", po::value(&opts.config_file),
+         "Config-file with options as 'name = value', using the long names of the command-line options. "
+         "The command-line takes precedence. Re-read on SIGHUP.")
+        ("log-to-console,C",
+         po::value(&config.log.console_level)->default_value(config.log.console_level),
+         "Log-level to the console; one of 'info', 'debug', 'trace'. Empty string to disable.")
+        ("log-level,l",
+         po::value(&config.log.level)->default_value(config.log.level),
+         "Log-level; one of 'info', 'debug', 'trace'.")
+        ("log-file,L",
+         po::value(&config.log.file),
+         "Log-file to write a log to. Default is to use only the console.")
+        ("truncate-log-file,T",
+          po::bool_switch(&config.log.truncate),
+         "Truncate the log-file if it already exists.")
+        ;
 
-    if (name == "trace") {
-        return logfault::LogLevel::TRACE;
-    }
+    po::options_description bs("Bootstrap");
+    bs.add_options()
+        ("bootstrap", po::bool_switch(&opts.bootstrap),
+         "Bootstrap the system. Creates the database and system tenant. Exits when done. "
+         "The databse credentials must be for the system (root) user of the database.")
+        ("drop-database", po::bool_switch(&bootstrapOpts.drop_old_db),
+         "Tells the server to delete the existing database.")
+        ("root-db-user",
+          po::value(&bootstrapOpts.db_root_user)->default_value(bootstrapOpts.db_root_user),
+         "Mysql user to use when logging into the mysql server")
+        ("root-db-passwd",
+         po::value(&bootstrapOpts.db_root_passwd),
+         "Mysql password to use when logging into the mysql server")
+        ("generate-data", po::bool_switch(&bootstrapOpts.generate_data),
+         "Fill the new database with synthetic data for performance tests. "
+         "Use the --generate-* options to set the size.")
+        ;
+
+    auto& data = bootstrapOpts.data;
+    po::options_description gen("Generate data (with --bootstrap --generate-data)");
+    gen.add_options()
+        ("generate-tenants", po::value(&data.tenants)->default_value(data.tenants),
+         "Number of tenants")
+        ("generate-users", po::value(&data.users)->default_value(data.users),
+         "Users in each tenant")
+        ("generate-depth", po::value(&data.depth)->default_value(data.depth),
+         "Levels in each users tree of nodes")
+        ("generate-fanout", po::value(&data.fanout)->default_value(data.fanout),
+         "Children for each node in the tree")
+        ("generate-actions", po::value(&data.actions)->default_value(data.actions),
+         "Actions for each node")
+        ("generate-years", po::value(&data.years)->default_value(data.years),
+         "Years of days for each user")
+        ("generate-work-sessions", po::value(&data.work_sessions)->default_value(data.work_sessions),
+         "Work sessions for each user on each weekday")
+        ("generate-end-date", po::value(&data.end_date),
+         "Last day of the generated days, as YYYY-MM-DD. Default is today.")
+        ("generate-seed", po::value(&data.seed)->default_value(data.seed),
+         "Seed for the random data. The same seed and options give the same data.")
+        ("generate-uuids", po::value(&data.uuid_version)->default_value(data.uuid_version),
+         "Kind of ids: 'v7' (time-ordered, like the server creates) or 'v4' (random)")
+        ("generate-batch-size", po::value(&data.batch_size)->default_value(data.batch_size),
+         "Rows in each INSERT statement")
+        ;
+
+    po::options_description io("Export/Import");
+    io.add_options()
+        ("export", po::value(&opts.export_file),
+         "Export the tenant given by --tenant to a file, and exit.")
+        ("import", po::value(&opts.import_file),
+         "Import a tenant from a file created by --export, and exit. "
+         "The tenant must not already exist.")
+        ("tenant", po::value(&opts.export_tenant),
+         "Uuid of the tenant to export")
+        ;
+
+    po::options_description svr("Server");
+    svr.add_options()
+        ("io-threads", po::value(&config.svr.io_threads)->default_value(config.svr.io_threads),
+         "Number of worker-threads to start for IO")
+        ("thread-per-core", po::bool_switch(&config.svr.thread_per_core),
+         "Run one io_context, thread and database pool per io-thread, rather than "
+         "letting all the io-threads share one io_context")
+        ("pin-threads", po::value(&config.svr.pin_threads)->default_value(config.svr.pin_threads),
+         "Pin each shard thread to a CPU core. Only used with --thread-per-core")
+        ("db-threads", po::value(&config.svr.db_threads)->default_value(config.svr.db_threads),
+         "Number of threads for database I/O. 0 to use the io-threads")
+        ("cpu-threads", po::value(&config.svr.cpu_threads)->default_value(config.svr.cpu_threads),
+         "Number of threads for CPU bound work, like building large replies. 0 to use the io-threads")
+        ("executor-lag-warn-ms", po::value(&config.svr.executor_lag_warn_ms)->default_value(config.svr.executor_lag_warn_ms),
+         "Log a warning when work waits longer than this in the queue of an executor")
+        ("metrics-endpoint", po::value(&config.svr.metrics_endpoint)->default_value(config.svr.metrics_endpoint),
+         "Address and port for the Prometheus metrics (http://host:port/metrics). Empty to disable")
+        ("grpc-address,g", po::value(&config.grpc.address)->default_value(config.grpc.address),
+         "Address and port to use for gRPC")
+        ("grpc-max-in-flight", po::value(&config.grpc.max_in_flight)->default_value(config.grpc.max_in_flight),
+         "Max number of gRPC requests in progress. Requests over the limit are rejected. 0 for no limit")
+        ("grpc-rate-limit", po::value(&config.grpc.rate_limit)->default_value(config.grpc.rate_limit),
+         "Requests per second allowed for each user for each RPC method. 0 for no limit")
+        ("grpc-rate-limit-burst", po::value(&config.grpc.rate_limit_burst)->default_value(config.grpc.rate_limit_burst),
+         "Requests a user can make in a burst for each RPC method")
+        ("grpc-user-from-metadata", po::bool_switch(&config.grpc.user_from_metadata),
+         "Take the user from the 'nextapp-user' request metadata. Only for testing!")
+        ("trace-file", po::value(&config.trace.path),
+         "Append traces for the sampled requests to this file, in the OTLP/JSON format")
+        ("trace-sample-rate", po::value(&config.trace.sample_rate)->default_value(config.trace.sample_rate),
+         "Fraction of the requests to trace, from 0.0 to 1.0")
+        ;
 
-    return logfault::LogLevel::INFO;
+    po::options_description db("Database");
+    db.add_options()
+        ("db-user",
+          po::value(&config.db.username),
+          "Mysql user to use when logging into the mysql server")
+        ("db-passwd",
+         po::value(&config.db.password),
+         "Mysql password to use when logging into the mysql server")
+        ("db-name",
+          po::value(&config.db.database)->default_value(config.db.database),
+         "Database to use")
+        ("db-host",
+         po::value(&config.db.host)->default_value(config.db.host),
+         "Hostname or IP address for the database server")
+        ("db-port",
+         po::value(&config.db.port)->default_value(config.db.port),
+         "Port number for the database server")
+        ("db-max-connections",
+         po::value(&config.db.max_connections)->default_value(config.db.max_connections),
+         "Max concurrent connections to the database server")
+        ("db-retry-connect",
+         po::value(&config.db.retry_connect)->default_value(config.db.retry_connect),
+         "Retry connect to the database-server # times on startup. Useful when using containers, where nextappd may be running before the database is ready.")
+        ("db-retry-delay",
+         po::value(&config.db.retry_connect_delay_ms)->default_value(config.db.retry_connect_delay_ms),
+         "Milliseconds to wait between connection retries")
+        ("slow-query-ms",
+         po::value(&config.slow_query.threshold_ms)->default_value(config.slow_query.threshold_ms),
+         "Log queries that take longer than this, with their query-plan. 0 to disable")
+        ("slow-query-log",
+         po::value(&config.slow_query.path),
+         "File for the slow-query log. If unset, slow queries are logged to the application log")
+        ("slow-query-log-size-mb",
+         po::value(&config.slow_query.max_size_mb)->default_value(config.slow_query.max_size_mb),
+         "Rotate the slow-query log when it reach this size")
+        ("slow-query-log-files",
+         po::value(&config.slow_query.max_files)->default_value(config.slow_query.max_files),
+         "Number of rotated slow-query logs to keep")
+        ("record-traffic",
+         po::value(&config.record.path),
+         "Append a record of each unary request to this file, for replay with nextapp-replay")
+        ("record-payloads",
+         po::value(&config.record.payloads)->default_value(config.record.payloads),
+         "Payloads in the traffic records; one of 'none', 'anonymized' or 'raw'. "
+         "Anonymized payloads keep the sizes and the uuid references, but no text from the users.")
+        ;
+
+    po::options_description options;
+    options.add(general).add(bs).add(gen).add(io).add(svr).add(db);
+    return options;
+}
+
+// Options on the command-line takes precedence over the ones in the config-file
+po::variables_map parseOptions(int argc, char* argv[], const po::options_description& options) {
+    po::variables_map vm;
+    po::store(po::command_line_parser(argc, argv).options(options).run(), vm);
+    if (vm.count("config")) {
+        const auto path = vm["config"].as<string>();
+        if (!filesystem::is_regular_file(path)) {
+            throw runtime_error{format("The config-file '{}' does not exist", path)};
+        }
+        po::store(po::parse_config_file<char>(path.c_str(), options), vm);
+    }
+    po::notify(vm);
+    return vm;
 }
 
 template <typename T>
@@ -89,95 +262,18 @@ int main(int argc, char* argv[]) {
 
     Config config;
     Server::BootstrapOptions bootstrap_opts;
+    StartupOptions opts;
 
     const auto appname = filesystem::path(argv[0]).stem().string();
 
     {
-        namespace po = boost::program_options;
-        po::options_description general("Options");
-        std::string log_level_console = "info";
-        std::string log_level = "info";
-        std::string log_file;
-        bool trunc_log = false;
-        bool bootstrap = false;
-
-        general.add_options()
-            ("help,h", "Print help and exit")
-            ("version,v", "Print version and exit")
-            ("log-to-console,C",
-             po::value(&log_level_console)->default_value(log_level_console),
-             "Log-level to the console; one of 'info', 'debug', 'trace'. Empty string to disable.")
-            ("log-level,l",
-             po::value<string>(&log_level)->default_value(log_level),
-             "Log-level; one of 'info', 'debug', 'trace'.")
-            ("log-file,L",
-             po::value<string>(&log_file),
-             "Log-file to write a log to. Default is to use only the console.")
-            ("truncate-log-file,T",
-              po::bool_switch(&trunc_log),
-             "Truncate the log-file if it already exists.")
-            ;
-
-        po::options_description bs("Bootstrap");
-        bs.add_options()
-            ("bootstrap", po::bool_switch(&bootstrap),
-             "Bootstrap the system. Creates the database and system tenant. Exits when done. "
-             "The databse credentials must be for the system (root) user of the database.")
-            ("drop-database", po::bool_switch(&bootstrap_opts.drop_old_db),
-             "Tells the server to delete the existing database.")
-            ("root-db-user",
-              po::value(&bootstrap_opts.db_root_user)->default_value(bootstrap_opts.db_root_user),
-             "Mysql user to use when logging into the mysql server")
-            ("root-db-passwd",
-             po::value(&bootstrap_opts.db_root_passwd),
-             "Mysql password to use when logging into the mysql server")
-            ;
-
-        po::options_description svr("Server");
-        svr.add_options()
-            ("io-threads", po::value(&config.svr.io_threads)->default_value(config.svr.io_threads),
-             "Number of worker-threads to start for IO")
-            ("grpc-address,g", po::value(&config.grpc.address)->default_value(config.grpc.address),
-             "Address and port to use for gRPC")
-            ;
-
-        po::options_description db("Database");
-        db.add_options()
-            ("db-user",
-              po::value(&config.db.username),
-              "Mysql user to use when logging into the mysql server")
-            ("db-passwd",
-             po::value(&config.db.password),
-             "Mysql password to use when logging into the mysql server")
-            ("db-name",
-              po::value(&config.db.database)->default_value(config.db.database),
-             "Database to use")
-            ("db-host",
-             po::value(&config.db.host)->default_value(config.db.host),
-             "Hostname or IP address for the database server")
-            ("db-port",
-             po::value(&config.db.port)->default_value(config.db.port),
-             "Port number for the database server")
-            ("db-max-connections",
-             po::value(&config.db.max_connections)->default_value(config.db.max_connections),
-             "Max concurrent connections to the database server")
-            ("db-retry-connect",
-             po::value(&config.db.retry_connect)->default_value(config.db.retry_connect),
-             "Retry connect to the database-server # times on startup. Useful when using containers, where nextappd may be running before the database is ready.")
-            ("db-retry-delay",
-             po::value(&config.db.retry_connect_delay_ms)->default_value(config.db.retry_connect_delay_ms),
-             "Milliseconds to wait between connection retries")
-            ;
-
-        po::options_description cmdline_options;
-        cmdline_options.add(general).add(bs).add(svr).add(db);
+        const auto cmdline_options = makeOptions(config, bootstrap_opts, opts);
         po::variables_map vm;
         try {
-            po::store(po::command_line_parser(argc, argv).options(cmdline_options).run(), vm);
-            po::notify(vm);
+            vm = parseOptions(argc, argv, cmdline_options);
         } catch (const std::exception& ex) {
             cerr << appname
-                 << " Failed to parse command-line arguments: " << ex.what() << endl;
+                 << " Failed to parse the options: " << ex.what() << endl;
             return -1;
         }
 
@@ -197,21 +293,11 @@ int main(int argc, char* argv[]) {
             return -3;
         }
 
-        if (auto level = toLogLevel(log_level_console)) {
-            logfault::LogManager::Instance().AddHandler(
-                make_unique<logfault::StreamHandler>(clog, *level));
-        }
-
-        if (!log_file.empty()) {
-            if (auto level = toLogLevel(log_level)) {
-                logfault::LogManager::Instance().AddHandler(
-                    make_unique<logfault::StreamHandler>(log_file, *level, trunc_log));
-            }
-        }
+        Server::setupLogging(config.log);
 
         LOG_TRACE_N << LogEvent::LE_TEST << "Getting ready...";
 
-        if (bootstrap) {
+        if (opts.bootstrap) {
             LOG_INFO << appname << ' ' << APP_VERSION << ".";
             try {
                 Server server{config};
@@ -222,12 +308,39 @@ int main(int argc, char* argv[]) {
                 return -4;
             }
         }
+
+        if (!opts.export_file.empty() || !opts.import_file.empty()) {
+            LOG_INFO << appname << ' ' << APP_VERSION << ".";
+            try {
+                Server server{config};
+                if (!opts.export_file.empty()) {
+                    if (opts.export_tenant.empty()) {
+                        cerr << appname << " --export requires --tenant" << endl;
+                        return -1;
+                    }
+                    server.exportTenant(opts.export_tenant, opts.export_file);
+                } else {
+                    server.importTenant(opts.import_file);
+                }
+                return 0; // Done
+            } catch (const exception& ex) {
+                LOG_ERROR << "Caught exception during export/import: " << ex.what();
+                return -4;
+            }
+        }
     }
 
     LOG_INFO << appname << ' ' << APP_VERSION << " starting up.";
 
     try {
         Server server{config};
+        server.setConfigLoader([argc, argv] {
+            Config config;
+            Server::BootstrapOptions bootstrap_opts;
+            StartupOptions opts;
+            parseOptions(argc, argv, makeOptions(config, bootstrap_opts, opts));
+            return config;
+        });
         server.init();
         server.run();
     } catch (const nextapp::aborted& ex) {